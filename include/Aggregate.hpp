@@ -0,0 +1,113 @@
+#pragma once
+#include "Query.hpp"
+#include "ResultWriter.hpp"
+#include "TableScan.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Per-group state for one aggregate, stored column-wise (one slot per group id)
+// and updated a whole batch at a time.
+class Accumulator {
+public:
+    virtual ~Accumulator() = default;
+
+    // Makes room for group ids below total.
+    virtual void resize(size_t total) = 0;
+    // Folds values[i] into group groups[i]; empty or unparsable cells are skipped.
+    virtual void update(const uint32_t* groups, const std::string_view* values, size_t n) = 0;
+    // Folds group from[i] of other into group to[i] of this accumulator.
+    virtual void merge(const Accumulator& other, const uint32_t* from, const uint32_t* to, size_t n) = 0;
+    // Final value of a group; empty when the group saw no input.
+    virtual void format(uint32_t group, std::string& out) const = 0;
+};
+
+std::unique_ptr<Accumulator> makeAccumulator(const AggSpec& spec);
+
+// Open-addressing (linear probing) table mapping group keys to dense ids.
+// Slots only hold the hash and the id, so a probe touches one cache line in
+// the common case; key bytes live in a separate arena.
+class GroupTable {
+public:
+    GroupTable();
+
+    // Resolves a batch of keys to group ids, inserting unseen keys.
+    void findOrInsert(const uint64_t* hashes, const std::string_view* keys, size_t n, uint32_t* groupIds);
+
+    size_t size() const { return groupHashes.size(); }
+    uint64_t hash(uint32_t group) const { return groupHashes[group]; }
+    std::string_view key(uint32_t group) const;
+
+private:
+    struct Slot {
+        uint64_t hash;
+        uint32_t group;
+    };
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+
+    void rehash(size_t capacity);
+
+    std::vector<Slot> slots;
+    size_t mask = 0;
+    std::vector<uint64_t> groupHashes;
+    std::string keyData;
+    std::vector<size_t> keyEnds;
+};
+
+// GROUP BY / global aggregation over rows of one table. Rows are buffered into
+// batches; each batch is hashed, resolved to group ids and then fed to every
+// accumulator in one pass.
+class HashAggregator {
+public:
+    HashAggregator(const SelectQuery& q, const std::vector<Column>& columns);
+
+    void consume(RowView& row);
+    // Processes any buffered rows; call once the input is exhausted.
+    void finish();
+    // Folds another aggregator built from the same query into this one. With
+    // radixBits > 0 only the groups whose top hash bits equal partition are taken.
+    void merge(HashAggregator& other, uint32_t partition = 0, unsigned radixBits = 0);
+    // A fresh aggregator for the same query, with no groups.
+    std::unique_ptr<HashAggregator> emptyCopy() const;
+
+    size_t groupCount() const { return groups.size(); }
+
+    std::vector<ResultColumn> resultColumns() const;
+    void emit(ResultWriter& writer) const;
+
+private:
+    static constexpr size_t kBatchSize = 512;
+
+    HashAggregator() = default;
+
+    void processBatch();
+
+    std::vector<int> groupIdx;
+    std::vector<int> inputIdx;     // distinct table columns read by aggregates
+    std::vector<int> aggInput;     // per aggregate: position in inputIdx, -1 for count
+    std::vector<AggSpec> specs;
+    std::vector<ResultColumn> outColumns;
+    std::vector<std::unique_ptr<Accumulator>> accs;
+    GroupTable groups;
+
+    // Pending batch: group keys and aggregate inputs copied out of the rows.
+    size_t pending = 0;
+    std::string keyBuf;
+    std::vector<size_t> keyEnds;
+    std::vector<std::string> inputBufs;
+    std::vector<std::vector<size_t>> inputEnds;
+};
+
+// Aggregates the rows of a table file that fall in range. With threads > 1 the
+// range is split into morsels pulled by that many workers, each filling a
+// thread-local HashAggregator; the partial states are then merged,
+// radix-partitioned on the group hash when there are many groups so the merge
+// itself also runs in parallel. The result is one or more
+// aggregators holding disjoint groups, to be emitted in order. Rows read and
+// aggregated are tallied in counters when given.
+std::vector<std::unique_ptr<HashAggregator>> aggregateTable(
+    const SelectQuery& q, const std::vector<Column>& columns, const std::string& path, ByteRange range,
+    size_t threads, const std::function<void(const std::string&)>& onMalformed, ScanCounters* counters = nullptr);
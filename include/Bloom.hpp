@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Split-block Bloom filter over 64-bit hashes. The high half of a hash picks
+// one 32-byte block and the low half sets one bit in each of its eight words,
+// so a lookup touches a single cache line. About ten bits per key gives a
+// false positive rate near one percent.
+class BloomFilter {
+public:
+    explicit BloomFilter(size_t expectedKeys) {
+        size_t blocks = blockCount(expectedKeys);
+        words.assign(blocks * kWordsPerBlock, 0);
+        mask = blocks - 1;
+    }
+
+    void insert(uint64_t hash) {
+        uint32_t* block = &words[((hash >> 32) & mask) * kWordsPerBlock];
+        uint32_t key = static_cast<uint32_t>(hash);
+        for (size_t i = 0; i < kWordsPerBlock; ++i) block[i] |= uint32_t(1) << ((key * kSalt[i]) >> 27);
+    }
+
+    bool mayContain(uint64_t hash) const {
+        const uint32_t* block = &words[((hash >> 32) & mask) * kWordsPerBlock];
+        uint32_t key = static_cast<uint32_t>(hash);
+        for (size_t i = 0; i < kWordsPerBlock; ++i) {
+            if ((block[i] & (uint32_t(1) << ((key * kSalt[i]) >> 27))) == 0) return false;
+        }
+        return true;
+    }
+
+    // Memory a filter for this many keys takes, for budget accounting.
+    static size_t bytesFor(size_t expectedKeys) { return blockCount(expectedKeys) * kWordsPerBlock * sizeof(uint32_t); }
+
+private:
+    static constexpr size_t kWordsPerBlock = 8;
+    static constexpr size_t kBitsPerBlock = kWordsPerBlock * 32;
+    static constexpr size_t kBitsPerKey = 10;
+    static constexpr uint32_t kSalt[kWordsPerBlock] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                       0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+    static size_t blockCount(size_t expectedKeys) {
+        size_t blocks = 1;
+        while (blocks * kBitsPerBlock < expectedKeys * kBitsPerKey) blocks *= 2;
+        return blocks;
+    }
+
+    std::vector<uint32_t> words;
+    size_t mask = 0;
+};
@@ -1,7 +1,23 @@
 #pragma once
 #include <iostream>
+#include <string>
+#include <utility>
 
 class CommandHandler {
 public:
-    void execute(int argc, char** argv);
+    // Runs commands on the database in directory root; "" is the working directory.
+    explicit CommandHandler(std::string root = "") : root(std::move(root)) {}
+
+    // Runs one command line; argv[1] is the command. What it prints goes to
+    // out, warnings about the data to err; confirmations are read from in.
+    // False when the command failed or was cancelled.
+    bool execute(int argc, char** argv, std::ostream& out = std::cout, std::ostream& err = std::cerr,
+                 std::istream& in = std::cin);
+
+    // Commands that only read tables and the catalog, and so may run side by
+    // side with each other.
+    static bool readOnly(const std::string& command);
+
+private:
+    std::string root;
 };
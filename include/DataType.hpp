@@ -1,7 +1,13 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 enum class DataType { INT, STRING, FLOAT };
 
 DataType getDataType(const std::string& typeStr);
 std::string toString(DataType type);
+
+// Strict parsers for stored cell text: the whole value must be consumed.
+bool parseInt(std::string_view text, int64_t& out);
+bool parseFloat(std::string_view text, double& out);
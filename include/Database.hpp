@@ -0,0 +1,171 @@
+#pragma once
+#include "DataType.hpp"
+#include "ResultWriter.hpp"
+#include "Utility.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct PreparedQuery;
+class Database;
+
+// One column of a RowBatch. Every cell keeps its stored text; INT and FLOAT
+// columns have the parsed values as well.
+struct BatchColumn {
+    std::string name;
+    DataType type = DataType::STRING;
+    std::vector<uint8_t> valid;         // bit r set when row r has a value
+    std::vector<int64_t> ints;          // INT, 0 where null
+    std::vector<double> floats;         // FLOAT, 0 where null
+    std::vector<uint32_t> ends;         // end offset of every row's text in bytes
+    std::string bytes;
+};
+
+// Up to kBatchRows result rows, column by column. As in format columns, empty
+// cells and numeric cells that do not parse are null.
+struct RowBatch {
+    static constexpr size_t kBatchRows = 4096;
+
+    size_t rows = 0;
+    std::vector<BatchColumn> columns;
+
+    bool isNull(size_t row, size_t col) const;
+    int64_t getInt(size_t row, size_t col) const;               // FLOAT truncated; 0 for STRING and null
+    double getDouble(size_t row, size_t col) const;             // 0 for STRING and null
+    std::string_view getString(size_t row, size_t col) const;   // the stored text, any type
+};
+
+// The result of a query. The query runs on a thread of its own while the
+// rows are read, a few batches ahead of the reader; a reader that stops
+// holds it up rather than letting batches pile up in memory.
+class Rows {
+public:
+    ~Rows();
+
+    Rows(const Rows&) = delete;
+    Rows& operator=(const Rows&) = delete;
+
+    // Waits for the query to start; empty if it failed before producing any.
+    const std::vector<ResultColumn>& columns();
+
+    // Moves to the next row; false after the last one or when the query failed.
+    bool next();
+    bool isNull(size_t col) const { return current->isNull(row, col); }
+    int64_t getInt(size_t col) const { return current->getInt(row, col); }
+    double getDouble(size_t col) const { return current->getDouble(row, col); }
+    std::string_view getString(size_t col) const { return current->getString(row, col); }
+
+    // The next batch whole; next() carries on after it. nullptr at the end.
+    const RowBatch* nextBatch();
+
+    // The batch holding the current row, or the one nextBatch() returned.
+    const RowBatch* batch() const { return current.get(); }
+    size_t position() const { return row; }
+
+    // Stops reading early. The query runs to its end with its rows dropped.
+    void close();
+
+    // Set once the end is reached.
+    const std::string& error() const;
+    const std::string& warnings() const;   // skipped malformed rows
+
+    struct Channel;                     // between the query thread and the reader
+
+private:
+    friend class Statement;
+
+    Rows() = default;
+    bool fetch();
+
+    std::shared_ptr<Channel> channel;
+    std::thread producer;
+    std::unique_ptr<RowBatch> current;
+    size_t row = 0;
+    bool started = false;               // row points at a row of current
+};
+
+// A command parsed once and run any number of times. dikhao and jodo take
+// their resolved query and plan from the PlanCache, so they are planned again
+// only when the catalog or the schemas of their tables change. Arguments that
+// are ? are parameters, given by bind() before each run. One thread at a time
+// may use a statement; results it returned stay valid after it runs again or
+// is destroyed.
+class Statement {
+public:
+    ~Statement();
+
+    // Runs a dikhao or jodo and returns its rows; the format clause is
+    // ignored. nullptr with error for other commands or when it cannot run.
+    std::unique_ptr<Rows> query(std::string& error);
+
+    // Runs the command, writing what the CLI would print to out and its
+    // warnings to err. False if it failed.
+    bool execute(std::ostream& out, std::ostream& err);
+
+    // The number of ? arguments. Of a dikhao or jodo only the where value may be one.
+    size_t parameterCount() const { return values.size(); }
+
+    // Sets parameter index (from 0) for the following runs; false if there is none.
+    bool bind(size_t index, std::string value);
+    bool bind(size_t index, int64_t value) { return bind(index, std::to_string(value)); }
+
+    const std::vector<std::string>& arguments() const { return args; }
+
+private:
+    friend class Database;
+
+    Statement(Database& db, std::vector<std::string> args);
+    bool isQuery() const;
+    bool resolve(PreparedQuery& prepared, std::string& error);   // caller holds the database's shared lock
+    bool boundArguments(std::vector<std::string>& bound, std::string& error) const;
+
+    Database& db;
+    std::vector<std::string> args;
+    std::vector<std::optional<std::string>> values;   // of the ? arguments, in order
+};
+
+// In-process access to a database directory, for programs that link cdb_core
+// instead of running cdb for every command. Commands take the same arguments
+// as on the command line; those that change tables wait for running queries
+// through the same Database and run alone, so a thread must read to the end
+// or close its own results before it changes a table. Each Database has its
+// own lock: threads share one handle per directory, as two handles on the
+// same directory coordinate no more than two cdb processes do. A process may
+// have any number of databases open. Results and statements must not outlive
+// their database.
+class Database {
+public:
+    ~Database();
+
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+
+    // Opens directory, creating it if needed. nullptr with error if that fails.
+    static std::unique_ptr<Database> open(const std::string& directory, std::string& error);
+
+    // Runs one command (args[0] is its name) as the CLI would; false if it
+    // failed. Confirmations are answered no.
+    bool execute(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+
+    // commandLine is split on blanks, with quotes grouping an argument.
+    std::unique_ptr<Statement> prepare(const std::string& commandLine, std::string& error);
+    std::unique_ptr<Statement> prepare(std::vector<std::string> args, std::string& error);
+
+    // prepare and query in one step.
+    std::unique_ptr<Rows> query(const std::string& commandLine, std::string& error);
+
+private:
+    friend class Statement;
+
+    explicit Database(std::string directory) : directory(std::move(directory)) {}
+
+    std::string directory;        // absolute, the root of every path of the database
+    std::shared_mutex tables;     // held shared by queries and exclusively by changes
+};
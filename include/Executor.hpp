@@ -0,0 +1,76 @@
+#pragma once
+#include "Join.hpp"
+#include "Planner.hpp"
+#include "Query.hpp"
+#include "ResultWriter.hpp"
+#include "catalog.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What explain analyze measured for one plan operator. Times are the
+// operator's own, without its children; cpuSeconds adds up every worker
+// thread. A scan feeding an aggregate or a join runs inside that operator and
+// has its time counted there.
+struct OperatorStats {
+    bool timed = true;
+    double wallSeconds = 0;
+    double cpuSeconds = 0;
+    uint64_t rowsIn = 0;
+    uint64_t rowsOut = 0;
+    uint64_t bytesRead = 0;
+    std::optional<size_t> memoryPeak;   // operators that reserve from the query's memory budget
+};
+
+struct PlanProfile {
+    std::unordered_map<const PlanNode*, OperatorStats> operators;
+    double wallSeconds = 0;             // the whole execution
+    double cpuSeconds = 0;
+    double outputSeconds = 0;           // formatting result rows
+    size_t memoryPeak = 0;              // the whole query
+};
+
+// Runs a plan from planSelect. Result rows are written to out in q.format,
+// or handed to sink. With a profile every operator is measured as it runs.
+// Operators that spill write under data/tmp of the database in root.
+void executeSelect(const PlanNode& plan, const SelectQuery& q, const std::vector<Column>& columns,
+                   const std::string& root, std::ostream& out, const MalformedFn& onMalformed,
+                   PlanProfile* profile = nullptr);
+void executeSelect(const PlanNode& plan, const SelectQuery& q, const std::vector<Column>& columns,
+                   const std::string& root, std::unique_ptr<ResultWriter> sink, const MalformedFn& onMalformed,
+                   PlanProfile* profile = nullptr);
+
+// Runs a plan from planJoin. Result rows are written to out in the format of
+// q.select, or handed to sink.
+void executeJoin(const PlanNode& plan, const JoinQuery& q, const std::vector<Column>& leftColumns,
+                 const std::vector<Column>& rightColumns, const std::string& root, std::ostream& out,
+                 const MalformedFn& onMalformed, PlanProfile* profile = nullptr);
+void executeJoin(const PlanNode& plan, const JoinQuery& q, const std::vector<Column>& leftColumns,
+                 const std::vector<Column>& rightColumns, const std::string& root, std::unique_ptr<ResultWriter> sink,
+                 const MalformedFn& onMalformed, PlanProfile* profile = nullptr);
+
+// A dikhao or jodo parsed and resolved against the schemas of its tables.
+struct BoundQuery {
+    std::string root;                    // database directory, "" for the working directory
+    bool join = false;
+    SelectQuery select;                  // dikhao
+    JoinQuery joinQuery;                 // jodo
+    std::vector<Column> columns;         // the dikhao table, or the left table of jodo
+    std::vector<Column> rightColumns;
+
+    const SelectQuery& output() const { return join ? joinQuery.select : select; }
+};
+
+// Parses and resolves the arguments of command (dikhao or jodo) that follow
+// its name against the database in root, and checks that the data files exist.
+bool bindQuery(const std::string& root, const std::string& command, const std::vector<std::string>& args, BoundQuery& q,
+               std::string& error);
+
+std::unique_ptr<PlanNode> planQuery(const BoundQuery& q, const Catalog& catalog);
+
+void executeQuery(const PlanNode& plan, const BoundQuery& q, std::unique_ptr<ResultWriter> sink,
+                  const MalformedFn& onMalformed, PlanProfile* profile = nullptr);
@@ -0,0 +1,9 @@
+#pragma once
+#include "Executor.hpp"
+#include "Planner.hpp"
+#include <ostream>
+
+// Prints a plan as an indented operator tree with the planner's row and cost
+// estimates. With a profile from an executed plan every operator also gets
+// what it actually did, followed by totals for the whole query.
+void printPlan(const PlanNode& plan, std::ostream& out, const PlanProfile* profile = nullptr);
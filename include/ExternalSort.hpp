@@ -0,0 +1,123 @@
+#pragma once
+#include "DataType.hpp"
+#include "MemoryBudget.hpp"
+#include "Query.hpp"
+#include "ResultWriter.hpp"
+#include "TableScan.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Appends the order-preserving binary encoding of value to key, so that
+// memcmp over concatenated encodings matches a typed multi-column comparison.
+// Numbers become fixed width big-endian with the sign bit flipped, strings are
+// 0x00-escaped and terminated; desc inverts the bytes of this column.
+void appendSortKey(std::string& key, std::string_view value, DataType type, bool desc);
+
+// Sorts rows by a normalized binary key within the query's memory budget. When
+// the budget refuses more memory the buffered rows are sorted and spilled to a run file
+// under data/tmp of the database in root; finish() then k-way merges the runs
+// with a loser tree. A run that cannot be written in full throws std::runtime_error. The sorter takes
+// its first few MiB of the budget when it is made, so an operator filling the
+// rest later cannot shrink its runs to a row each.
+class ExternalSorter {
+public:
+    ExternalSorter(MemoryBudget& budget, std::string root);
+    ~ExternalSorter();
+
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    void add(std::string_view key, const std::vector<std::string_view>& cells);
+
+    // Delivers the rows in key order; fn returns false to stop early.
+    void finish(const std::function<bool(const std::vector<std::string_view>&)>& fn);
+
+private:
+    struct Entry {
+        uint64_t prefix;    // first eight key bytes, big-endian, for cheap comparisons
+        size_t offset;      // record start in arena
+    };
+
+    void sortBuffered();
+    void spill();
+    std::string mergeRuns(size_t first, size_t count);
+
+    MemoryReservation reservation;
+    std::string root;
+    std::string arena;      // records: u32 key length, u32 payload length, key, payload
+    std::vector<Entry> entries;
+    std::vector<std::string> runs;
+    uint64_t sequence = 0;
+};
+
+// Largest LIMIT served from a TopNHeap; bigger ones use the external sort.
+constexpr size_t kTopNMaxRows = 100000;
+
+// Keeps the n smallest rows by key in a bounded max-heap; for ORDER BY ... LIMIT
+// this replaces a full sort with O(rows * log n) work and O(n) memory. The
+// rows held are charged to budget.
+class TopNHeap {
+public:
+    TopNHeap(size_t n, MemoryBudget& budget) : capacity(n), reservation(budget) {}
+
+    // False, without taking the row, when the budget refuses its memory.
+    bool add(std::string_view key, const std::vector<std::string_view>& cells);
+    void finish(const std::function<bool(const std::vector<std::string_view>&)>& fn);
+
+    // Hands every row held to sorter, keeping equal keys in arrival order.
+    void moveTo(ExternalSorter& sorter);
+
+private:
+    size_t capacity;
+    MemoryReservation reservation;
+    size_t bytes = 0;                // charged for the records held
+    std::vector<std::string> heap;   // records in ExternalSorter's layout
+    std::string scratch;
+    uint64_t sequence = 0;
+};
+
+// Result writer decorator that buffers rows in an ExternalSorter and forwards
+// them in ORDER BY order when the input ends. Rows may carry trailing hidden
+// columns used only as sort keys; those are dropped before forwarding. When
+// only the first limit rows are wanted a TopNHeap is used for small limits,
+// handing over to an ExternalSorter if the budget cannot hold them.
+class SortingWriter : public ResultWriter {
+public:
+    SortingWriter(std::unique_ptr<ResultWriter> downstream, std::vector<SortKey> keys, size_t visibleColumns,
+                  MemoryBudget& budget, std::string root, size_t limit = SIZE_MAX);
+
+    void begin(const std::vector<ResultColumn>& columns) override;
+    void row(const std::vector<std::string_view>& values) override;
+    void end() override;
+
+private:
+    std::unique_ptr<ResultWriter> downstream;
+    std::vector<SortKey> keys;
+    size_t visibleColumns;
+    size_t limit;
+    MemoryBudget& budget;
+    std::string root;
+    std::unique_ptr<ExternalSorter> sorter;
+    std::unique_ptr<TopNHeap> topN;
+    std::string key;
+    std::vector<std::string_view> visible;
+};
+
+// Rewrites the data file of table in the database in root ordered by one
+// column (ascending, stable) through an ExternalSorter, so the table need not
+// fit in memory. Malformed rows are reported and dropped. The new file
+// replaces the old one by a rename.
+bool sortTableFile(const std::string& root, const std::string& table, size_t columnCount, int keyIdx, DataType type,
+                   MemoryBudget& budget, const std::function<void(const std::string&)>& onMalformed, size_t& rows,
+                   std::string& error);
+
+// Byte range holding the rows whose key column equals value, in a file
+// sortTableFile ordered on that column. Two binary searches over file offsets,
+// each step reading the first row at or after the probed offset, so only
+// O(log size) rows are read. Equality is by the typed order ("07" and "7" are
+// in the same range); callers still apply their own filter to the rows.
+ByteRange findKeyRange(const std::string& path, size_t columnCount, int keyIdx, DataType type, std::string_view value);
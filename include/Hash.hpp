@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Finalizer from MurmurHash3; spreads entropy into both high and low bits.
+inline uint64_t mixHash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// 64-bit hash of a byte string, eight bytes per step.
+inline uint64_t hashBytes(std::string_view s, uint64_t seed = 0) {
+    uint64_t h = seed ^ (s.size() * 0x9e3779b97f4a7c15ULL);
+    const char* p = s.data();
+    size_t n = s.size();
+    while (n >= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h = (h ^ mixHash(w)) * 0x9e3779b97f4a7c15ULL;
+        p += 8;
+        n -= 8;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, n);
+    h = (h ^ mixHash(tail ^ n)) * 0x9e3779b97f4a7c15ULL;
+    return mixHash(h);
+}
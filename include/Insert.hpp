@@ -0,0 +1,17 @@
+#pragma once
+#include "catalog.hpp"
+#include <string>
+#include <vector>
+
+// Appends rows to the end of a table's data file, in the directory of
+// catalog's database, without reading the rest of it. Every row has a value per column of table ("" is null); values are
+// trimmed and checked against the column types, not-null and primary key
+// columns must be filled, primary keys must be new (all pk columns together
+// form the key) and foreign keys must exist in the table they reference.
+// Keys are looked up without a scan where possible: values outside the
+// column's analyzed min/max cannot be there, and a table clustered on the
+// column is binary searched; only what is left is found with one parallel
+// scan. Nothing is written unless every row passes. stillClustered is
+// cleared when the rows break the order of table.clusteredBy.
+bool insertRows(const TableDef& table, const Catalog& catalog, std::vector<std::vector<std::string>>& rows,
+                bool& stillClustered, std::string& error);
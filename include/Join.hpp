@@ -0,0 +1,75 @@
+#pragma once
+#include "MemoryBudget.hpp"
+#include "Query.hpp"
+#include "TableScan.hpp"
+#include "catalog.hpp"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// jodo <left> <right> [on <lcol>=<rcol>] followed by the dikhao clauses cols,
+// where, order by, limit, offset and format. Columns are referred to as
+// table.col, or by their bare name when only one side has it.
+struct JoinQuery {
+    std::string left;
+    std::string right;
+    std::string leftKey;    // empty until given by "on" or derived from a catalog FK
+    std::string rightKey;
+    SelectQuery select;     // resolved against left columns followed by right columns
+
+    // Filled in by resolveJoin()
+    int leftKeyIdx = -1;
+    int rightKeyIdx = -1;
+    size_t leftColumnCount = 0;
+};
+
+// args are everything after the command name.
+bool parseJoin(const std::vector<std::string>& args, JoinQuery& q, std::string& error);
+
+// Defaults the join key from a catalog FK between the two tables when no "on"
+// clause was given, then binds every column reference.
+bool resolveJoin(JoinQuery& q, const std::vector<Column>& leftColumns, const std::vector<Column>& rightColumns,
+                 const Catalog& catalog, std::string& error);
+
+// One side of a join: a table file, its key column and an optional filter that
+// is applied while scanning it.
+struct JoinInput {
+    std::string path;
+    size_t columnCount = 0;
+    int keyIdx = -1;
+    std::optional<Predicate> filter;    // columnIdx relative to this input
+    ScanCounters* counters = nullptr;   // rows read, and handed to the join
+    DataType keyType = DataType::STRING;   // keys compare as this type, see joinKeyType()
+};
+
+// The type both join keys are compared as, the same in every join algorithm:
+// INT when both are INT, FLOAT when both are numbers, otherwise the text.
+// Numbers compare by value ("07" joins "7"); empty keys, and keys that are
+// not numbers when comparing as one, never join.
+DataType joinKeyType(DataType left, DataType right);
+
+// Receives every matching pair, always in (left, right) order regardless of
+// which side was built. Returning false ends the join early.
+using JoinEmit = std::function<bool(RowView& left, RowView& right)>;
+using MalformedFn = std::function<void(const std::string&)>;
+
+// Hash join: the build input is loaded into a chained hash table keyed on its
+// join column (in the keyType encoding), then the probe input is streamed past it. Only the key column
+// of a probe row is decoded unless it finds a match. When the build side does
+// not fit in budget both inputs are partitioned by key hash into data/tmp of
+// the database in root and the partitions are joined pairwise (Grace hash
+// join), recursively if needed; rows then come out grouped by partition
+// rather than in probe order.
+void hashJoin(const JoinInput& build, const JoinInput& probe, bool buildIsLeft, const JoinEmit& emit,
+              const MalformedFn& onMalformed, MemoryBudget& budget, const std::string& root);
+
+// Merge join of two inputs already sorted ascending on their keys, in the
+// typed order cluster_karo writes; both keys are of keyType. Each side is
+// streamed once and only the right rows sharing the current key are held in
+// memory; matches come out in left file order. Returns false if an input
+// turns out not to be sorted, in which case the rows emitted so far are
+// incomplete.
+bool mergeJoin(const JoinInput& left, const JoinInput& right, DataType keyType, const JoinEmit& emit,
+               const MalformedFn& onMalformed);
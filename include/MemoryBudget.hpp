@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Memory accounting for one query. Operators reserve before growing their
+// in-memory state and spill (or fall back to a slower algorithm) when a
+// reservation is refused, so a single query stays within its limit instead of
+// running the process out of memory. Safe to share between worker threads.
+// A budget with a parent also charges every reservation to the parent, so one
+// operator's share of the query can be measured on its own.
+class MemoryBudget {
+public:
+    explicit MemoryBudget(size_t limit, MemoryBudget* parent = nullptr) : cap(limit), parent(parent) {}
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    bool tryReserve(size_t bytes) {
+        size_t cur = inUse.load(std::memory_order_relaxed);
+        do {
+            if (cur + bytes > cap) return false;
+        } while (!inUse.compare_exchange_weak(cur, cur + bytes, std::memory_order_relaxed));
+        if (parent && !parent->tryReserve(bytes)) {
+            inUse.fetch_sub(bytes, std::memory_order_relaxed);
+            return false;
+        }
+
+        size_t now = cur + bytes;
+        size_t seen = high.load(std::memory_order_relaxed);
+        while (now > seen && !high.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {}
+        return true;
+    }
+
+    void release(size_t bytes) {
+        inUse.fetch_sub(bytes, std::memory_order_relaxed);
+        if (parent) parent->release(bytes);
+    }
+
+    size_t limit() const { return cap; }
+    size_t used() const { return inUse.load(std::memory_order_relaxed); }
+    size_t peak() const { return high.load(std::memory_order_relaxed); }
+
+private:
+    size_t cap;
+    MemoryBudget* parent;
+    std::atomic<size_t> inUse{0};
+    std::atomic<size_t> high{0};
+};
+
+// Holds a growing share of a MemoryBudget and gives it back on destruction.
+// ensure() reserves in chunks so hot loops do not touch the shared counter per row.
+class MemoryReservation {
+public:
+    explicit MemoryReservation(MemoryBudget& budget) : budget(budget) {}
+    ~MemoryReservation() { reset(); }
+
+    MemoryReservation(const MemoryReservation&) = delete;
+    MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+    // Makes sure at least total bytes are reserved; false if the budget refuses.
+    bool ensure(size_t total) {
+        if (total <= held) return true;
+        size_t want = total - held;
+        if (want < kChunk) want = kChunk;
+        if (!budget.tryReserve(want)) {
+            want = total - held;
+            if (!budget.tryReserve(want)) return false;
+        }
+        held += want;
+        return true;
+    }
+
+    void reset() {
+        budget.release(held);
+        held = 0;
+    }
+
+    size_t bytes() const { return held; }
+
+private:
+    static constexpr size_t kChunk = 1 << 20;
+
+    MemoryBudget& budget;
+    size_t held = 0;
+};
+
+// Per-query memory limit: CDB_QUERY_MEMORY bytes, default 1 GiB.
+size_t queryMemoryLimit();
@@ -0,0 +1,24 @@
+#pragma once
+#include "Query.hpp"
+#include <functional>
+#include <optional>
+#include <string>
+
+// What update_karo / delete_karo do to the rows matching filter (every row
+// when there is none): drop them, or set column setIdx to setValue.
+struct Mutation {
+    std::optional<Predicate> filter;
+    bool remove = false;
+    int setIdx = -1;
+    std::string setValue;
+};
+
+// Applies m to the data file of table in the database in root. Morsels of the
+// file are rewritten in parallel on the thread pool; each morsel's output is a
+// staged batch that the calling thread appends, in file order, to a new file
+// under data/tmp.
+// The new file then replaces the table with one rename, so all batches
+// commit together and a failure part way leaves the old table untouched.
+// Malformed rows are reported and dropped. affected counts matching rows.
+bool applyMutation(const std::string& root, const std::string& table, size_t columnCount, const Mutation& m,
+                   size_t& affected, const std::function<void(const std::string&)>& onMalformed, std::string& error);
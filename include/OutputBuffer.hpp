@@ -0,0 +1,95 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+// Large manually managed write buffer in front of an ostream. Result writers
+// append into it and it is handed to the stream in big chunks, which avoids
+// per-cell iostream formatting overhead.
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::ostream& out, size_t capacity = 1 << 20)
+        : out(out), data(new char[capacity]), capacity(capacity) {}
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void put(char c) {
+        if (len == capacity) drain();
+        data[len++] = c;
+    }
+
+    void append(std::string_view s) { appendRaw(s.data(), s.size()); }
+
+    void appendRaw(const void* p, size_t n) {
+        if (len + n > capacity) {
+            drain();
+            if (n > capacity) {
+                out.write(static_cast<const char*>(p), static_cast<std::streamsize>(n));
+                return;
+            }
+        }
+        std::memcpy(data.get() + len, p, n);
+        len += n;
+    }
+
+    void appendFill(char c, size_t n) {
+        while (n > 0) {
+            if (len == capacity) drain();
+            size_t chunk = n < capacity - len ? n : capacity - len;
+            std::memset(data.get() + len, c, chunk);
+            len += chunk;
+            n -= chunk;
+        }
+    }
+
+    void appendInt(int64_t v) {
+        reserve(24);
+        auto res = std::to_chars(data.get() + len, data.get() + capacity, v);
+        len = static_cast<size_t>(res.ptr - data.get());
+    }
+
+    // Shortest representation that round-trips.
+    void appendFloat(double v) {
+        reserve(32);
+        auto res = std::to_chars(data.get() + len, data.get() + capacity, v);
+        len = static_cast<size_t>(res.ptr - data.get());
+    }
+
+    // Little-endian fixed width integers for binary formats.
+    void appendU8(uint8_t v) { put(static_cast<char>(v)); }
+    void appendU16(uint16_t v) { appendLE(v, 2); }
+    void appendU32(uint32_t v) { appendLE(v, 4); }
+    void appendU64(uint64_t v) { appendLE(v, 8); }
+
+    void flush() {
+        drain();
+        out.flush();
+    }
+
+private:
+    void drain() {
+        if (len > 0) {
+            out.write(data.get(), static_cast<std::streamsize>(len));
+            len = 0;
+        }
+    }
+
+    void reserve(size_t n) {
+        if (len + n > capacity) drain();
+    }
+
+    void appendLE(uint64_t v, int bytes) {
+        reserve(8);
+        for (int i = 0; i < bytes; ++i) data[len++] = static_cast<char>((v >> (8 * i)) & 0xFF);
+    }
+
+    std::ostream& out;
+    std::unique_ptr<char[]> data;
+    size_t capacity;
+    size_t len = 0;
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include "Query.hpp"
+#include "ResultWriter.hpp"
+#include "TableScan.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Morsels a worker may finish ahead of the one being consumed, per worker.
+constexpr size_t kMorselsAheadPerThread = 4;
+
+// Ordered morsel pipeline: threads pool tasks pull morsels of span, a part of
+// the file at path, from a MorselDispenser and call produce(stream, range, result, stop) for
+// each; the calling thread gets consume(result) for every morsel in file
+// order. consume returns false to end early, which raises stop for producers
+// still running. Producers stay a bounded window ahead of the consumer, so at
+// most a few results per worker are buffered. With one thread everything runs
+// inline on the calling thread.
+template <typename Result, typename Produce, typename Consume>
+void forEachMorselInOrder(const std::string& path, ByteRange span, size_t threads, Produce&& produce,
+                          Consume&& consume) {
+    MorselDispenser dispenser(span, kMorselBytes);
+    const size_t morsels = dispenser.count();
+    std::atomic<bool> stop{false};
+
+    if (threads <= 1) {
+        std::ifstream in(path, std::ios::binary);
+        size_t index;
+        ByteRange range;
+        while (dispenser.next(index, range)) {
+            Result result;
+            produce(in, range, result, stop);
+            if (!consume(result)) return;
+        }
+        return;
+    }
+
+    const size_t window = threads * kMorselsAheadPerThread;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<Result> results(morsels);
+    std::vector<char> ready(morsels, 0);
+    size_t consumed = 0;
+
+    auto work = [&]() {
+        std::ifstream in(path, std::ios::binary);
+        size_t index;
+        ByteRange range;
+        while (dispenser.next(index, range)) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return stop.load() || index < consumed + window; });
+                if (stop) return;
+            }
+            Result result;
+            produce(in, range, result, stop);
+            std::lock_guard<std::mutex> lock(mutex);
+            results[index] = std::move(result);
+            ready[index] = 1;
+            changed.notify_all();
+        }
+    };
+    TaskGroup group;
+    for (size_t i = 0; i < threads; ++i) group.run(work);
+
+    for (size_t m = 0; m < morsels; ++m) {
+        Result result;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return ready[m] != 0; });
+            result = std::move(results[m]);
+        }
+        bool more = consume(result);
+        std::lock_guard<std::mutex> lock(mutex);
+        consumed = m + 1;
+        if (!more) {
+            stop = true;
+            changed.notify_all();
+            break;
+        }
+        changed.notify_all();
+    }
+    group.wait();
+}
+
+// Scans range of a table with threads workers on the ordered morsel pipeline. Each
+// worker filters its morsel and copies out the scanIdx cells of the rows that
+// pass; the calling thread hands them to writer in file order, so the output
+// matches a serial scan. done() is checked after every row written and ends
+// the scan early (a satisfied LIMIT). Rows are tallied in counters when given.
+void parallelScan(const std::string& path, ByteRange range, size_t columnCount, const std::optional<Predicate>& filter,
+                  const std::vector<int>& scanIdx, size_t threads, ResultWriter& writer,
+                  const std::function<bool()>& done, const std::function<void(const std::string&)>& onMalformed,
+                  ScanCounters* counters = nullptr);
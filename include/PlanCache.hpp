@@ -0,0 +1,63 @@
+#pragma once
+#include "Executor.hpp"
+#include "Planner.hpp"
+#include "Utility.hpp"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A dikhao or jodo resolved and planned once and shared by every run of it.
+// When its where value is ? (parameter), bindParameter() gives the copy to run.
+struct PreparedQuery {
+    std::shared_ptr<const BoundQuery> query;
+    std::shared_ptr<const PlanNode> plan;
+    bool parameter = false;
+};
+
+// The dikhao and jodo statements this process has resolved and planned,
+// keyed by their database directory and normalized text: the arguments as
+// split, so spacing and quoting make no difference. An entry is used while the catalog is at the
+// version it was planned from and the schema files of its tables are
+// unchanged. Holds CDB_PLAN_CACHE entries (default 1024, 0 disables it),
+// dropping the least recently used.
+class PlanCache {
+public:
+    static PlanCache& instance();
+
+    // args start with the command name; root is the database directory, ""
+    // for the working directory. Besides the where value nothing may be ?.
+    bool prepare(const std::string& root, const std::vector<std::string>& args, PreparedQuery& prepared,
+                 std::string& error);
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    using Stamps = std::vector<std::pair<std::string, std::optional<FileStamp>>>;
+
+    struct Entry {
+        std::string key;
+        uint64_t catalogVersion = 0;
+        Stamps schemas;
+        PreparedQuery prepared;
+    };
+
+    PlanCache();
+    static bool current(const Entry& e, uint64_t catalogVersion);
+
+    mutable std::mutex mutex;
+    size_t capacity;
+    std::list<Entry> entries;           // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+};
+
+// prepared with its where value set to value.
+PreparedQuery bindParameter(const PreparedQuery& prepared, const std::string& value);
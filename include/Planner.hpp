@@ -0,0 +1,81 @@
+#pragma once
+#include "Column.hpp"
+#include "Join.hpp"
+#include "Query.hpp"
+#include "Statistics.hpp"
+#include "catalog.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Physical operators the executor can run.
+enum class PlanOp {
+    SeqScan,          // the whole data file; morsel-parallel with threads > 1
+    ClusteredSeek,    // rows equal to the filter value, found by binary search in a clustered file
+    HashAggregate,
+    Sort,             // external sort
+    TopN,             // ORDER BY with a LIMIT small enough for a heap
+    Limit,
+    HashJoin,         // spills to a Grace hash join past the memory budget
+    RadixJoin,
+    MergeJoin,
+};
+
+const char* planOpName(PlanOp op);
+
+// What the cost model knows about a table before reading it. The row count
+// comes from the analyzed statistics, scaled to the current file size, or
+// without them from the average length of the rows at the start of the file.
+struct TableEstimate {
+    uint64_t bytes = 0;
+    double rows = 0;
+    bool sized = false;     // false when the file size could not be read
+    std::optional<TableStats> stats;
+};
+
+TableEstimate estimateTable(const std::string& path, const std::optional<TableStats>& stats = std::nullopt);
+
+// Expected fraction of rows that pass p, from the column's statistics; without
+// them a tenth for "=" and half for "like".
+double selectivity(const Predicate& p, const std::vector<Column>& columns, const TableEstimate& t);
+
+// One operator of a physical plan. Scans are leaves; Limit, Sort, TopN and
+// HashAggregate have one child; joins have the left input first and the right
+// one second, whichever of them is built.
+struct PlanNode {
+    PlanOp op = PlanOp::SeqScan;
+
+    // Scans
+    std::string table;
+    std::string path;
+    size_t columnCount = 0;
+    std::optional<Predicate> filter;     // columnIdx relative to this table
+    int keyIdx = -1;                     // join column, for scans below a join
+
+    size_t threads = 1;                  // scans, HashAggregate, RadixJoin
+    bool buildLeft = true;               // HashJoin, RadixJoin
+    size_t limit = SIZE_MAX;             // Limit; rows kept by Sort and TopN
+    size_t offset = 0;                   // Limit
+
+    double rows = 0;                     // estimated output
+    double bytes = 0;
+    double cost = 0;                     // estimated for the whole subtree
+
+    std::string detail;                  // arguments as explain prints them
+
+    std::vector<std::unique_ptr<PlanNode>> children;
+};
+
+// A deep copy of plan, for binding parameter values into a cached plan.
+std::unique_ptr<PlanNode> clonePlan(const PlanNode& plan);
+
+// Picks the access path and the output operators for a resolved dikhao query.
+std::unique_ptr<PlanNode> planSelect(const SelectQuery& q, const std::vector<Column>& columns, const Catalog& catalog);
+
+// Plans a resolved jodo query: the WHERE predicate is pushed into the scan of
+// the table it names, then every applicable join algorithm and build side is
+// costed and the cheapest is kept.
+std::unique_ptr<PlanNode> planJoin(const JoinQuery& q, const std::vector<Column>& leftColumns,
+                                   const std::vector<Column>& rightColumns, const Catalog& catalog);
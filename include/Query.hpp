@@ -0,0 +1,63 @@
+#pragma once
+#include "Column.hpp"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// where <col> (=|like) <value>; a value of ? is a parameter, given for each run
+struct Predicate {
+    std::string column;
+    std::string op;
+    std::string value;
+    int columnIdx = -1;
+    bool parameter = false;     // value is still ?
+};
+
+enum class AggFunc { COUNT, SUM, AVG, MIN, MAX };
+
+// count | count:<col> | sum:<col> | avg:<col> | min:<col> | max:<col>
+struct AggSpec {
+    AggFunc func;
+    std::string column;     // empty for count over all rows
+    int columnIdx = -1;
+    DataType inputType = DataType::INT;
+};
+
+std::string aggName(const AggSpec& a);
+DataType aggResultType(const AggSpec& a);
+
+// <col>[:asc|:desc]; names a table column, or a group/aggregate output when aggregating
+struct SortKey {
+    std::string column;
+    bool desc = false;
+    int outputIdx = -1;     // position in the row handed to the result writer
+    DataType type = DataType::STRING;
+};
+
+// dikhao <table> [cols a,b,c] [where <col> (=|like) <value>] [group by a,b] [agg f:col,...]
+//        [order by c1[:desc],...] [limit n] [offset m] [format box|csv|jsonl|bin]
+struct SelectQuery {
+    std::string table;
+    std::vector<std::string> projection;   // empty means every column
+    std::optional<Predicate> filter;
+    std::vector<std::string> groupBy;
+    std::vector<AggSpec> aggregates;
+    std::vector<SortKey> orderBy;
+    std::optional<size_t> limit;
+    size_t offset = 0;
+    std::string format = "box";
+
+    // Filled in by resolveSelect()
+    std::vector<int> projectionIdx;
+    std::vector<int> groupByIdx;
+    std::vector<int> hiddenIdx;     // ORDER BY columns scanned but not projected
+};
+
+// Parses the clauses following the table name. On failure returns false and sets error.
+bool parseSelectClauses(const std::vector<std::string>& args, SelectQuery& q, std::string& error);
+
+// Binds column names in q to positions in columns.
+bool resolveSelect(SelectQuery& q, const std::vector<Column>& columns, std::string& error);
+
+bool matches(const Predicate& p, std::string_view cell);
@@ -0,0 +1,18 @@
+#pragma once
+#include "Join.hpp"
+#include "MemoryBudget.hpp"
+#include <cstddef>
+
+// Radix-partitioned hash join for INT keys. Both inputs are loaded by threads
+// pool tasks as (key, row) tuples, scattered by the top bits of the key hash into
+// partitions small enough for each one's hash table to stay in L2, and the
+// partition pairs are built and probed on worker threads. Keys compare as
+// numbers, so "07" matches "7"; cells that are not integers never join. A
+// filtered build side is turned into a Bloom filter that the probe scan
+// checks before loading a row.
+//
+// Matches are emitted by the calling thread, partition by partition. Returns
+// false, having emitted nothing, when both inputs do not fit in budget; the
+// caller then uses hashJoin, which can spill.
+bool radixJoin(const JoinInput& build, const JoinInput& probe, bool buildIsLeft, size_t threads,
+               const JoinEmit& emit, const MalformedFn& onMalformed, MemoryBudget& budget);
@@ -0,0 +1,161 @@
+#pragma once
+#include "DataType.hpp"
+#include "OutputBuffer.hpp"
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ResultColumn {
+    std::string name;
+    DataType type;
+};
+
+// Receives query output one row at a time, so results never have to be
+// collected in full before the first row is written.
+class ResultWriter {
+public:
+    virtual ~ResultWriter() = default;
+
+    virtual void begin(const std::vector<ResultColumn>& columns) = 0;
+    virtual void row(const std::vector<std::string_view>& values) = 0;
+    virtual void end() = 0;
+};
+
+// The ASCII box table. Column widths are taken from the first sampleRows rows;
+// after that rows are written as they arrive. A later value wider than its
+// column is printed in full rather than truncated.
+class BoxWriter : public ResultWriter {
+public:
+    explicit BoxWriter(std::ostream& out, size_t sampleRows = 1000);
+
+    void begin(const std::vector<ResultColumn>& columns) override;
+    void row(const std::vector<std::string_view>& values) override;
+    void end() override;
+
+private:
+    void flushSample();
+    void printSeparator();
+    void printRow(const std::vector<std::string_view>& values);
+
+    OutputBuffer buf;
+    size_t sampleRows;
+    bool streaming = false;
+    std::vector<std::string> header;
+    std::vector<size_t> colWidths;
+    std::vector<std::vector<std::string>> sample;
+};
+
+// RFC 4180 style CSV with a header line.
+class CsvWriter : public ResultWriter {
+public:
+    explicit CsvWriter(std::ostream& out) : buf(out) {}
+
+    void begin(const std::vector<ResultColumn>& columns) override;
+    void row(const std::vector<std::string_view>& values) override;
+    void end() override;
+
+private:
+    void field(std::string_view v);
+
+    OutputBuffer buf;
+};
+
+// One JSON object per row. INT and FLOAT cells are emitted as JSON numbers,
+// empty or unparsable numeric cells as null.
+class JsonLinesWriter : public ResultWriter {
+public:
+    explicit JsonLinesWriter(std::ostream& out) : buf(out) {}
+
+    void begin(const std::vector<ResultColumn>& columns) override;
+    void row(const std::vector<std::string_view>& values) override;
+    void end() override;
+
+private:
+    void string(std::string_view v);
+
+    OutputBuffer buf;
+    std::vector<ResultColumn> columns;
+};
+
+// Compact length-prefixed binary stream, all integers little-endian:
+//   header : "CDB1" u16 ncols, per column { u8 type (0 int, 1 string, 2 float), u16 len, name }
+//   row    : u8 1, per cell { u32 len, bytes }  INT = 8 byte int64, FLOAT = 8 byte double,
+//            STRING = raw bytes; a numeric cell that is empty or unparsable has len 0
+//   trailer: u8 0, u64 row count
+class BinaryWriter : public ResultWriter {
+public:
+    explicit BinaryWriter(std::ostream& out) : buf(out) {}
+
+    void begin(const std::vector<ResultColumn>& columns) override;
+    void row(const std::vector<std::string_view>& values) override;
+    void end() override;
+
+private:
+    OutputBuffer buf;
+    std::vector<ResultColumn> columns;
+    uint64_t rowCount = 0;
+};
+
+// Typed columnar batches, all integers little-endian:
+//   header : "CDBC" u16 ncols, per column { u8 type (0 int, 1 string, 2 float), u16 len, name }
+//   batch  : u8 1, u32 rows, then per column a validity bitmap of (rows + 7) / 8 bytes
+//            (bit r set when row r has a value) followed by
+//              INT / FLOAT : rows * 8 byte int64 / double, 0 where null
+//              STRING      : rows * u32 end offset, then the bytes of every cell
+//   trailer: u8 0, u64 row count
+// Empty cells, and numeric cells that do not parse, are null. Each batch is
+// flushed to the stream as soon as it is full, so readers get rows while
+// the query is still running.
+class ColumnarWriter : public ResultWriter {
+public:
+    static constexpr size_t kBatchRows = 4096;
+
+    explicit ColumnarWriter(std::ostream& out) : buf(out) {}
+
+    void begin(const std::vector<ResultColumn>& columns) override;
+    void row(const std::vector<std::string_view>& values) override;
+    void end() override;
+
+private:
+    struct ColumnData {
+        std::vector<uint8_t> valid;
+        std::vector<uint64_t> fixed;    // INT and FLOAT bit patterns
+        std::vector<uint32_t> ends;     // STRING
+        std::string bytes;
+    };
+
+    void flushBatch();
+
+    OutputBuffer buf;
+    std::vector<ResultColumn> columns;
+    std::vector<ColumnData> data;
+    size_t rows = 0;
+    uint64_t rowCount = 0;
+};
+
+// Drops the first offset rows and forwards at most limit rows after them.
+// Producers that can stop early check full().
+class LimitWriter : public ResultWriter {
+public:
+    LimitWriter(std::unique_ptr<ResultWriter> downstream, size_t offset, size_t limit)
+        : downstream(std::move(downstream)), offset(offset), limit(limit) {}
+
+    void begin(const std::vector<ResultColumn>& columns) override { downstream->begin(columns); }
+    void row(const std::vector<std::string_view>& values) override;
+    void end() override { downstream->end(); }
+
+    bool full() const { return emitted >= limit; }
+
+private:
+    std::unique_ptr<ResultWriter> downstream;
+    size_t offset;
+    size_t limit;
+    size_t skipped = 0;
+    size_t emitted = 0;
+};
+
+// format is one of box, csv, jsonl, bin, columns; returns nullptr for anything else.
+std::unique_ptr<ResultWriter> makeResultWriter(const std::string& format, std::ostream& out);
+bool isResultFormat(const std::string& format);
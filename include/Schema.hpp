@@ -11,9 +11,10 @@ public:
     void addColumn(const Column& col);
     const std::vector<Column>& getColumns() const;
 
-    bool saveToFile(const std::string& tableName) const;
+    // metadata/<tableName>.meta of the database in directory root ("" is the working directory)
+    bool saveToFile(const std::string& root, const std::string& tableName) const;
 
-    static Schema loadFromFile(const std::string& tableName);
+    static Schema loadFromFile(const std::string& root, const std::string& tableName);
 
 private:
     std::vector<Column> columns;
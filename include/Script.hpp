@@ -0,0 +1,20 @@
+#pragma once
+#include <istream>
+#include <ostream>
+#include <string>
+
+struct ScriptOptions {
+    bool transaction = false;   // stop at the first failure and undo the commands before it
+    bool yes = false;           // answer yes when delete_karo or drop_kro_table asks
+};
+
+// cdb run: executes the commands of script on the database in root ("" is
+// the working directory), one per line as on the command line (blank lines
+// and lines starting with # are skipped), in this process,
+// so the catalog, the parsed schemas and the worker pool are loaded once.
+// Prints every command's output to out and a line for each one that fails.
+// With options.transaction the files of every table a command is about to
+// change are saved first, and restored when a later command fails. False if
+// any command failed.
+bool runScript(const std::string& root, std::istream& script, const ScriptOptions& options, std::ostream& out,
+               std::ostream& err);
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Where cdb serve listens and cdb client connects: a Unix socket path and,
+// optionally, a TCP port on 127.0.0.1.
+struct ServerAddress {
+    std::string socketPath = "cdb.sock";
+    uint16_t port = 0;      // 0: Unix socket only
+};
+
+// Binary protocol. A connection that opens with kProtocolMagic exchanges
+// frames, all integers little-endian:
+//   frame  : u32 payload length, u8 type, u32 request id, payload
+//   Command: u16 argc, per argument { u32 len, bytes }
+//   Batch  : u32 count, then count Command payloads, run one after another
+//   Data   : bytes of the command's output, in order; query results in
+//            "format columns" arrive as typed column batches
+//   Warning: bytes of the command's warnings (skipped malformed rows)
+//   Done   : u32 commands run; the request is complete
+// Clients may send any number of requests without waiting for replies. The
+// requests of one connection run in the order sent, and every reply frame
+// carries the id of its request. Output is streamed as the command produces
+// it; a client that stops reading holds up its own command, not the server.
+constexpr char kProtocolMagic[4] = {'\0', 'C', 'B', '2'};
+constexpr uint32_t kMaxFrameBytes = 64u << 20;
+
+enum class FrameType : uint8_t { Command = 1, Batch = 2, Data = 16, Warning = 17, Done = 18 };
+
+// Long-lived server for the database in directory root ("" is the working
+// directory). One thread runs an epoll loop over non-blocking sockets;
+// commands run on a pool of worker threads, read-only ones (dikhao, jodo, explain, describe_kro) side by side
+// and everything else alone. The catalog, parsed schemas and the operator
+// thread pool stay in memory between commands.
+//
+// Besides the binary protocol it accepts plain text, one request at a time:
+//   request: the command's arguments separated by tabs, ending in "\n"
+//   reply  : "<out bytes> <err bytes>\n", then the command's output, then its warnings
+// Runs until SIGINT or SIGTERM. False with error if it cannot listen.
+bool runServer(const std::string& root, const ServerAddress& address, size_t workers, std::string& error);
+
+// Sends commands to a server over the binary protocol, all of them before
+// the first reply is read, and copies their output to out and their warnings
+// to err in order. With batch they travel in one Batch frame.
+bool runClient(const ServerAddress& address, const std::vector<std::vector<std::string>>& commands, bool batch,
+               std::ostream& out, std::ostream& err, std::string& error);
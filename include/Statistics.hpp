@@ -0,0 +1,75 @@
+#pragma once
+#include "Column.hpp"
+#include "DataType.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// HyperLogLog distinct-value sketch with 2^kBits one-byte registers (about 3%
+// standard error). Sketches merge by taking the larger register, so workers
+// count separately and rows added after an analyze can still be folded in.
+class HyperLogLog {
+public:
+    static constexpr unsigned kBits = 10;
+
+    HyperLogLog() : registers(size_t(1) << kBits, 0) {}
+
+    void add(uint64_t hash);
+    void merge(const HyperLogLog& other);
+    double estimate() const;
+
+    // Registers as hex text, for the catalog.
+    std::string encode() const;
+    bool decode(const std::string& hex);
+
+private:
+    std::vector<uint8_t> registers;
+};
+
+// Summary of one column. Empty cells count as nulls and are left out of
+// everything else.
+struct ColumnStats {
+    std::string column;
+    uint64_t nulls = 0;
+    std::string min;                     // in the column type's order; both empty
+    std::string max;                     // when the column has no values
+    double distinct = 0;
+    std::vector<std::string> histogram;  // equi-depth bucket bounds, lowest sampled value first
+    std::vector<std::pair<std::string, double>> common;   // most common values, fraction of all rows
+    HyperLogLog sketch;
+};
+
+// What analyze_karo learned about a table, kept in the catalog with its TableDef.
+struct TableStats {
+    uint64_t rows = 0;
+    uint64_t bytes = 0;         // data file size when rows was counted
+    uint64_t modified = 0;      // rows inserted, updated or deleted since the last analyze
+    std::vector<ColumnStats> columns;
+
+    const ColumnStats* column(const std::string& name) const;
+    // Rows in the data file now, scaling the analyzed row count by its size.
+    double estimateRows(uint64_t bytesNow) const;
+};
+
+// Scans a table data file with morsel workers on the thread pool. Row and
+// null counts, min/max and the HyperLogLog sketches cover every row; the
+// histograms and most common values come from a Bernoulli sample of about
+// 30000 rows, so large tables cost one streaming pass and a small sort.
+bool analyzeTable(const std::string& path, const std::vector<Column>& columns, TableStats& stats,
+                  const std::function<void(const std::string&)>& onMalformed, std::string& error);
+
+// Upkeep between analyses: counts and sketches follow cheap changes without a
+// rescan, and statsStale() says when enough has changed to analyze again.
+void noteDeleted(TableStats& stats, uint64_t rows, uint64_t bytesNow);
+void noteInserted(TableStats& stats, const std::vector<Column>& columns,
+                  const std::vector<std::vector<std::string>>& rows, uint64_t bytesNow);
+void noteUpdated(TableStats& stats, const Column& column, std::string_view value, uint64_t rows, uint64_t bytesNow);
+bool statsStale(const TableStats& stats);
+
+// Estimated fraction of the table's rows whose cell equals value, or contains
+// pattern (the "like" of a where clause).
+double equalSelectivity(const TableStats& table, const ColumnStats& c, DataType type, std::string_view value);
+double likeSelectivity(const TableStats& table, const ColumnStats& c, std::string_view pattern);
@@ -0,0 +1,165 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A view over one comma-separated row. Fields are located on demand, so a scan
+// only pays for the columns it actually touches (filter first, projection later).
+class RowView {
+public:
+    void reset(std::string_view line) {
+        text = line;
+        starts.clear();
+        starts.push_back(0);
+    }
+
+    std::string_view raw() const { return text; }
+
+    size_t fieldCount() const {
+        return static_cast<size_t>(std::count(text.begin(), text.end(), ',')) + 1;
+    }
+
+    // Trimmed value of field idx; caller guarantees idx < fieldCount().
+    std::string_view field(size_t idx) {
+        while (starts.size() <= idx + 1 && starts.back() <= text.size()) {
+            size_t comma = text.find(',', starts.back());
+            starts.push_back(comma == std::string_view::npos ? text.size() + 1 : comma + 1);
+        }
+        size_t begin = starts[idx];
+        size_t end = starts[idx + 1] - 1;
+        while (begin < end && isBlank(text[begin])) ++begin;
+        while (end > begin && isBlank(text[end - 1])) --end;
+        return text.substr(begin, end - begin);
+    }
+
+private:
+    static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    std::string_view text;
+    std::vector<size_t> starts;   // start offset of each field located so far
+};
+
+// Feeds every well-formed row of a table data stream to fn(RowView&).
+// Rows whose field count differs from columnCount go to onMalformed(line).
+// fn returns false to stop the scan early.
+template <typename Fn, typename BadRowFn>
+void forEachRow(std::istream& in, size_t columnCount, Fn&& fn, BadRowFn&& onMalformed) {
+    std::string line;
+    RowView row;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        row.reset(line);
+        if (row.fieldCount() != columnCount) {
+            onMalformed(line);
+            continue;
+        }
+        if (!fn(row)) break;
+    }
+}
+
+// Rows an operator read from a table and passed on past its filter, for
+// explain analyze. Workers count locally and add their totals when done.
+struct ScanCounters {
+    std::atomic<uint64_t> rowsRead{0};
+    std::atomic<uint64_t> rowsPassed{0};
+
+    void add(uint64_t read, uint64_t passed) {
+        rowsRead.fetch_add(read, std::memory_order_relaxed);
+        rowsPassed.fetch_add(passed, std::memory_order_relaxed);
+    }
+    void reset() {
+        rowsRead = 0;
+        rowsPassed = 0;
+    }
+};
+
+// Tables below this size are scanned by a single thread.
+constexpr uint64_t kParallelScanMinBytes = 4 << 20;
+
+struct ByteRange {
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Cuts a data file into at most parts ranges of similar size. A range owns every
+// row whose first byte falls inside it, so the cuts need not sit on line breaks.
+std::vector<ByteRange> splitFile(const std::string& path, size_t parts);
+
+// forEachRow restricted to the rows owned by range, read through an already
+// open stream. Workers that scan many ranges reuse one stream this way.
+template <typename Fn, typename BadRowFn>
+void forEachRowInRange(std::istream& in, ByteRange range, size_t columnCount, Fn&& fn, BadRowFn&& onMalformed) {
+    uint64_t pos = range.begin;
+    std::string line;
+    in.clear();
+    if (pos > 0) {
+        // Skip the tail of a row that started in the previous range.
+        in.seekg(static_cast<std::streamoff>(pos - 1));
+        char prev = 0;
+        in.get(prev);
+        if (prev != '\n') {
+            if (!std::getline(in, line)) return;
+            pos += line.size() + 1;
+        }
+    } else {
+        in.seekg(0);
+    }
+
+    RowView row;
+    while (pos < range.end && std::getline(in, line)) {
+        pos += line.size() + 1;
+        if (line.empty()) continue;
+        row.reset(line);
+        if (row.fieldCount() != columnCount) {
+            onMalformed(line);
+            continue;
+        }
+        if (!fn(row)) break;
+    }
+}
+
+// Each call opens its own stream, so ranges of one file can be scanned concurrently.
+template <typename Fn, typename BadRowFn>
+void forEachRowInRange(const std::string& path, ByteRange range, size_t columnCount, Fn&& fn, BadRowFn&& onMalformed) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return;
+    forEachRowInRange(in, range, columnCount, std::forward<Fn>(fn), std::forward<BadRowFn>(onMalformed));
+}
+
+// Morsel size for parallel scans: small enough that threads finishing early
+// find more work, large enough that claiming one is negligible.
+constexpr uint64_t kMorselBytes = 1 << 20;
+
+// Hands out consecutive byte ranges (morsels) of span to scan workers.
+// Workers pull the next morsel when done with one, so uneven filter cost or a
+// slow thread does not leave the others idle. Morsels are numbered in file
+// order for callers that must put results back in that order.
+class MorselDispenser {
+public:
+    MorselDispenser(ByteRange span, uint64_t morselBytes)
+        : span(span), step(morselBytes),
+          total(static_cast<size_t>((span.end - span.begin + morselBytes - 1) / morselBytes)) {}
+
+    // False once every morsel has been handed out.
+    bool next(size_t& index, ByteRange& range) {
+        index = cursor.fetch_add(1, std::memory_order_relaxed);
+        if (index >= total) return false;
+        range.begin = span.begin + index * step;
+        range.end = std::min(range.begin + step, span.end);
+        return true;
+    }
+
+    size_t count() const { return total; }
+
+private:
+    ByteRange span;
+    uint64_t step;
+    size_t total;
+    std::atomic<size_t> cursor{0};
+};
@@ -0,0 +1,176 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Task = std::function<void()>;
+
+// CPU time spent on behalf of one query, read from the clock of each thread
+// that works for it. While a Scope is open on a thread, that thread's CPU is
+// charged to the meter, and so is every TaskGroup task it starts (and the
+// tasks those start). A task run inside another scope, say by TaskGroup::wait,
+// pauses the outer scope, so no time is counted twice or charged to a query
+// it was not spent on.
+class CpuMeter {
+public:
+    class Scope {
+    public:
+        explicit Scope(CpuMeter* meter);    // nullptr charges nobody
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        friend class CpuMeter;
+        void charge(uint64_t now);
+
+        CpuMeter* meter;
+        Scope* outer;
+        uint64_t mark;
+    };
+
+    // The meter of the innermost scope open on this thread, or nullptr.
+    static CpuMeter* current();
+
+    double seconds() const { return nanos.load(std::memory_order_relaxed) / 1e9; }
+
+private:
+    std::atomic<uint64_t> nanos{0};
+};
+
+// Chase-Lev work-stealing deque. The owning worker pushes and pops at the
+// bottom without locking; other workers steal from the top with one CAS.
+// Grown arrays are kept until the deque dies, since a thief may still be
+// reading the old one.
+class WorkDeque {
+public:
+    WorkDeque();
+
+    void push(Task* task);     // owner only
+    Task* pop();               // owner only; nullptr when empty
+    Task* steal();             // any thread; nullptr when empty or lost a race
+    bool empty() const;
+
+private:
+    struct Ring {
+        explicit Ring(int64_t capacity) : capacity(capacity), slots(new std::atomic<Task*>[capacity]) {}
+        Task* get(int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t i, Task* t) { slots[i & (capacity - 1)].store(t, std::memory_order_relaxed); }
+
+        int64_t capacity;
+        std::unique_ptr<std::atomic<Task*>[]> slots;
+    };
+
+    Ring* grow(Ring* ring, int64_t bottom, int64_t top);
+
+    std::atomic<int64_t> top{0};
+    std::atomic<int64_t> bottom{0};
+    std::atomic<Ring*> ring;
+    std::vector<std::unique_ptr<Ring>> rings;   // every ring ever used, owned here
+};
+
+// Process-wide pool that parallel operators (scans, aggregation, joins) submit
+// tasks to instead of starting threads per query. Each worker runs tasks from
+// its own deque, then from the shared injection queue fed by non-pool threads,
+// then steals from a random other worker before going to sleep.
+//
+// The worker count comes from CDB_THREADS (default: hardware threads); with
+// CDB_PIN_THREADS=1 worker i is pinned to CPU i.
+class ThreadPool {
+public:
+    struct WorkerStats {
+        int cpu;                 // pinned CPU, -1 when not pinned
+        uint64_t tasks;          // tasks run
+        uint64_t steals;         // tasks taken from another worker
+        double busySeconds;      // time spent running tasks
+        double uptimeSeconds;
+    };
+
+    ThreadPool(size_t workers, bool pin);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static ThreadPool& instance();
+    // The pool if instance() has already created it, else nullptr.
+    static ThreadPool* existing();
+
+    void submit(Task task);
+    // Runs one queued task on the calling thread; false if none was found.
+    bool runOne();
+
+    size_t size() const { return workers.size(); }
+    std::vector<WorkerStats> stats() const;
+
+private:
+    struct Worker {
+        WorkDeque deque;
+        std::thread thread;
+        int cpu = -1;
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busyNanos{0};
+    };
+
+    void loop(size_t self);
+    Task* findTask(size_t self);
+    void run(Task* task, Worker* worker);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex injectMutex;
+    std::deque<Task*> injected;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> pending{0};    // submitted tasks not yet taken
+    std::atomic<bool> stopping{false};
+    std::chrono::steady_clock::time_point started;
+};
+
+// Tasks submitted together and waited for together. wait() runs queued tasks
+// on the calling thread while it waits, so nesting a group inside a task
+// cannot starve the pool. A task that throws does not take its pool thread
+// down: the other tasks run to the end and wait() rethrows the first
+// exception on the waiting thread.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::instance()) : pool(pool) {}
+    ~TaskGroup() { drain(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(Task task);
+    void wait();
+
+private:
+    void drain();    // wait() without rethrowing
+
+    ThreadPool& pool;
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t outstanding = 0;
+    std::exception_ptr error;    // the first task exception, until wait() rethrows it
+};
+
+// Runs fn(0) .. fn(n - 1) as pool tasks and waits for all of them; n == 1 runs inline.
+template <typename Fn>
+void parallelFor(size_t n, Fn&& fn) {
+    if (n == 1) {
+        fn(0);
+        return;
+    }
+    TaskGroup group;
+    for (size_t i = 0; i < n; ++i) group.run([&fn, i] { fn(i); });
+    group.wait();
+}
@@ -1,6 +1,40 @@
 #pragma once
+#include <cstdint>
+#include <optional>
 #include <vector>
 #include <string>
 
 std::vector<std::string> split(const std::string& str, char delimiter);
 std::string trim(const std::string& s);
+
+// Splits a command line as a shell would for simple cases: on blanks, with
+// single or double quotes grouping an argument. False on an unclosed quote.
+bool splitCommandLine(const std::string& line, std::vector<std::string>& args, std::string& error);
+
+// Reads a non-negative integer from the environment, or returns fallback.
+size_t envSize(const char* name, size_t fallback);
+
+// Worker threads for parallel operators: CDB_THREADS, else the hardware thread count.
+size_t workerThreads();
+
+// Files of the database in directory root; an empty root is the working
+// directory. relative is e.g. "metadata/catalog.meta".
+std::string databasePath(const std::string& root, const std::string& relative);
+std::string dataPath(const std::string& root, const std::string& table);    // data/<table>.dat
+std::string metaPath(const std::string& root, const std::string& table);    // metadata/<table>.meta
+
+// A fresh file name under the data/tmp of root (created on demand) for
+// operator spill files, unique across the processes sharing the directory.
+// Never throws; callers find out from opening or writing the file.
+std::string makeTempPath(const std::string& root, const std::string& prefix);
+
+// Size and modification time of a file, to tell whether a copy parsed
+// earlier in a long-running process is still current.
+struct FileStamp {
+    uint64_t size = 0;
+    int64_t modified = 0;
+
+    bool operator==(const FileStamp& o) const { return size == o.size && modified == o.modified; }
+};
+
+std::optional<FileStamp> fileStamp(const std::string& path);
@@ -1,10 +1,12 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <optional>
 
 // Reuse your DataType enum and getDataType(string) from DataType.hpp
 #include "DataType.hpp"
+#include "Statistics.hpp"
 
 // Column definition with constraints
 struct ColumnDef {
@@ -21,28 +23,45 @@ struct ColumnDef {
 struct TableDef {
     std::string name;
     std::vector<ColumnDef> columns;
+    // Column the data file is known to be sorted on (ascending), set by cluster_karo
+    std::string clusteredBy;
+    // Set by analyze_karo, kept roughly current by later changes
+    std::optional<TableStats> stats;
 };
 
 class Catalog {
 public:
-    // Load the whole catalog from metadata/catalog.meta (creates empty if missing)
-    static Catalog load();
+    // Load the whole catalog from metadata/catalog.meta of the database in
+    // directory root, "" for the working directory (creates empty if missing)
+    static Catalog load(const std::string& root);
 
-    // Save entire catalog back to disk
+    // Save entire catalog back to the directory it was loaded from
     bool save() const;
 
+    // The database directory this catalog belongs to
+    const std::string& root() const { return directory; }
+
+    // Goes up with every save, so anything derived from the catalog (cached
+    // plans) can tell that it changed. currentVersion() is that of the file
+    // on disk, without copying the catalog.
+    uint64_t version() const { return versionNumber; }
+    static uint64_t currentVersion(const std::string& root);
+
     // CRUD on table metadata
     bool addTable(const TableDef& tdef);        // returns false if table exists
+    bool updateTable(const TableDef& tdef);     // returns false if table is missing
     std::optional<TableDef> getTable(const std::string& name) const;
     bool tableExists(const std::string& name) const;
     std::vector<std::string> listTables() const;
 
 private:
     std::vector<TableDef> tables;
+    uint64_t versionNumber = 0;
+    std::string directory;
 
     // parsing / serialization
-    static std::string catalogPath();
-    static void ensureMetadataDir();
+    static std::string catalogPath(const std::string& root);
+    static void ensureMetadataDir(const std::string& root);
 
     static std::string serialize(const Catalog& c);
     static Catalog parse(const std::string& text);
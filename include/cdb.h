@@ -0,0 +1,120 @@
+#ifndef CDB_H
+#define CDB_H
+
+/*
+ * C interface to cdb_core, for embedding the database from languages that
+ * can call C. It wraps Database.hpp: a cdb_db is an open database, a
+ * cdb_stmt a prepared command.
+ *
+ * Strings passed in are NUL-terminated UTF-8. Pointers handed out stay valid
+ * until the call noted with each function; nothing is copied out of a result
+ * batch. A cdb_db may be used from several threads, a cdb_stmt from one at a
+ * time; finalize statements before closing their database. No C++ exception
+ * crosses this interface.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cdb_db cdb_db;
+typedef struct cdb_stmt cdb_stmt;
+
+/* Result codes. */
+#define CDB_OK      0
+#define CDB_ERROR   1
+#define CDB_MISUSE  2     /* a NULL argument or an unopened database */
+#define CDB_ROW     100   /* cdb_step / cdb_step_batch: a row or batch is ready */
+#define CDB_DONE    101   /* no more rows, or a command without rows has run */
+
+/* Column types, as in the bin and columns result formats. */
+#define CDB_INT     0
+#define CDB_STRING  1
+#define CDB_FLOAT   2
+
+/* Opens (creating it if needed) the database in directory. Any number of
+ * databases may be open; each handle has its own table lock, so threads
+ * share one handle per directory. *db is set even on failure so that
+ * cdb_errmsg can tell why; free it with cdb_close. */
+int cdb_open(const char* directory, cdb_db** db);
+int cdb_close(cdb_db* db);
+
+/* The last error of a call on db or one of its statements, or "". Valid
+ * until the next such call fails, from any thread. A call without a
+ * statement or database to record it on returns CDB_MISUSE only. */
+const char* cdb_errmsg(cdb_db* db);
+
+/* Runs one command line as the CLI would: CDB_OK, or CDB_ERROR when the
+ * command failed. *output, when not NULL, receives what it printed; valid
+ * until this thread's next cdb_exec. */
+int cdb_exec(cdb_db* db, const char* command, const char** output);
+
+/* Parses a command once for any number of runs. dikhao and jodo share one
+ * plan per statement text in the process until the catalog or the schema of
+ * their tables changes. Arguments that are ? are parameters, numbered from 0;
+ * of a dikhao or jodo only the where value may be one. */
+int cdb_prepare(cdb_db* db, const char* command, cdb_stmt** stmt);
+int cdb_finalize(cdb_stmt* stmt);
+
+/* Parameters keep their values across runs; binding one takes effect at the
+ * next run (after cdb_reset). CDB_MISUSE if there is no parameter index. */
+int cdb_bind_parameter_count(cdb_stmt* stmt);
+int cdb_bind_text(cdb_stmt* stmt, int index, const char* value);
+int cdb_bind_int64(cdb_stmt* stmt, int index, int64_t value);
+
+/* Moves to the next row: CDB_ROW, CDB_DONE at the end, or CDB_ERROR. The
+ * first step runs the statement; a command without rows returns CDB_DONE
+ * (CDB_ERROR if it failed) and leaves what it printed in cdb_output. After CDB_DONE call cdb_reset to
+ * run it again. */
+int cdb_step(cdb_stmt* stmt);
+/* Stops the current run early; the next step starts over. */
+int cdb_reset(cdb_stmt* stmt);
+
+/* Output of the last run of a command without rows. Valid until the next
+ * step or reset. */
+const char* cdb_output(cdb_stmt* stmt);
+/* Skipped malformed rows of the last run, once it is done. */
+const char* cdb_warnings(cdb_stmt* stmt);
+
+/* Result columns of a dikhao or jodo; starts the run if needed. Names are
+ * valid until reset or finalize. cdb_column_type is -1 for no such column. */
+int cdb_column_count(cdb_stmt* stmt);
+const char* cdb_column_name(cdb_stmt* stmt, int col);
+int cdb_column_type(cdb_stmt* stmt, int col);
+
+/* Cells of the current row. Empty cells and numeric cells that do not parse
+ * are null. cdb_column_text returns the stored text of any column, not
+ * NUL-terminated, with its length in *len; valid until the row's batch is
+ * left. */
+int cdb_column_is_null(cdb_stmt* stmt, int col);
+int64_t cdb_column_int64(cdb_stmt* stmt, int col);
+double cdb_column_double(cdb_stmt* stmt, int col);
+const char* cdb_column_text(cdb_stmt* stmt, int col, size_t* len);
+
+/* Moves to the next whole batch of up to 4096 rows: CDB_ROW, CDB_DONE or
+ * CDB_ERROR. cdb_step carries on after it. */
+int cdb_step_batch(cdb_stmt* stmt);
+
+/* The current batch: the one cdb_step_batch moved to, or the one holding the
+ * current row. The arrays point into the batch and are valid until the next
+ * step past it, reset or finalize.
+ *   validity : bit r of byte r / 8 set when row r has a value
+ *   int64    : one value per row, INT columns only (else NULL)
+ *   double   : one value per row, FLOAT columns only (else NULL)
+ *   text     : end offset of every row's text in bytes, any column */
+size_t cdb_batch_rows(cdb_stmt* stmt);
+size_t cdb_batch_row(cdb_stmt* stmt);                 /* the current row within it */
+const uint8_t* cdb_batch_validity(cdb_stmt* stmt, int col);
+const int64_t* cdb_batch_int64(cdb_stmt* stmt, int col);
+const double* cdb_batch_double(cdb_stmt* stmt, int col);
+const uint32_t* cdb_batch_text_ends(cdb_stmt* stmt, int col);
+const char* cdb_batch_text_bytes(cdb_stmt* stmt, int col);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,501 @@
+#include "Aggregate.hpp"
+#include "Hash.hpp"
+#include "ThreadPool.hpp"
+#include "Utility.hpp"
+#include <atomic>
+#include <charconv>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+bool parseCell(std::string_view s, int64_t& out) { return parseInt(s, out); }
+bool parseCell(std::string_view s, double& out) { return parseFloat(s, out); }
+bool parseCell(std::string_view s, std::string& out) {
+    if (s.empty()) return false;
+    out.assign(s);
+    return true;
+}
+
+void formatValue(int64_t v, std::string& out) {
+    char tmp[24];
+    auto res = std::to_chars(tmp, tmp + sizeof tmp, v);
+    out.assign(tmp, res.ptr);
+}
+void formatValue(double v, std::string& out) {
+    char tmp[32];
+    auto res = std::to_chars(tmp, tmp + sizeof tmp, v);
+    out.assign(tmp, res.ptr);
+}
+void formatValue(const std::string& v, std::string& out) { out = v; }
+
+// sum += v, or false, leaving sum alone, when that overflows; doubles never do.
+bool addChecked(int64_t& sum, int64_t v) {
+    int64_t r;
+    if (__builtin_add_overflow(sum, v, &r)) return false;
+    sum = r;
+    return true;
+}
+bool addChecked(double& sum, double v) {
+    sum += v;
+    return true;
+}
+
+class CountAcc : public Accumulator {
+public:
+    explicit CountAcc(bool allRows) : allRows(allRows) {}
+
+    void resize(size_t total) override { counts.resize(total, 0); }
+
+    void update(const uint32_t* groups, const std::string_view* values, size_t n) override {
+        if (allRows) {
+            for (size_t i = 0; i < n; ++i) ++counts[groups[i]];
+        } else {
+            for (size_t i = 0; i < n; ++i) counts[groups[i]] += values[i].empty() ? 0 : 1;
+        }
+    }
+
+    void merge(const Accumulator& other, const uint32_t* from, const uint32_t* to, size_t n) override {
+        const auto& o = static_cast<const CountAcc&>(other);
+        for (size_t i = 0; i < n; ++i) counts[to[i]] += o.counts[from[i]];
+    }
+
+    void format(uint32_t group, std::string& out) const override { formatValue(counts[group], out); }
+
+private:
+    bool allRows;
+    std::vector<int64_t> counts;
+};
+
+// An int sum that leaves 64 bits fails the query rather than wrapping.
+template <typename T>
+class SumAcc : public Accumulator {
+public:
+    explicit SumAcc(std::string name) : name(std::move(name)) {}
+
+    void resize(size_t total) override {
+        sums.resize(total, T{});
+        seen.resize(total, 0);
+    }
+
+    void update(const uint32_t* groups, const std::string_view* values, size_t n) override {
+        T v;
+        for (size_t i = 0; i < n; ++i) {
+            if (!parseCell(values[i], v)) continue;
+            add(groups[i], v);
+            seen[groups[i]] = 1;
+        }
+    }
+
+    void merge(const Accumulator& other, const uint32_t* from, const uint32_t* to, size_t n) override {
+        const auto& o = static_cast<const SumAcc&>(other);
+        for (size_t i = 0; i < n; ++i) {
+            if (!o.seen[from[i]]) continue;
+            add(to[i], o.sums[from[i]]);
+            seen[to[i]] = 1;
+        }
+    }
+
+    void format(uint32_t group, std::string& out) const override {
+        if (seen[group]) formatValue(sums[group], out);
+        else out.clear();
+    }
+
+private:
+    void add(uint32_t group, T v) {
+        if (!addChecked(sums[group], v)) throw std::runtime_error("Integer overflow in " + name);
+    }
+
+    std::string name;
+    std::vector<T> sums;
+    std::vector<uint8_t> seen;
+};
+
+// An int sum that would leave 64 bits moves into carry and carries on from
+// zero, so the average stays exact until then and close after.
+template <typename T>
+class AvgAcc : public Accumulator {
+public:
+    void resize(size_t total) override {
+        sums.resize(total, T{});
+        carry.resize(total, 0);
+        counts.resize(total, 0);
+    }
+
+    void update(const uint32_t* groups, const std::string_view* values, size_t n) override {
+        T v;
+        for (size_t i = 0; i < n; ++i) {
+            if (!parseCell(values[i], v)) continue;
+            add(groups[i], v);
+            ++counts[groups[i]];
+        }
+    }
+
+    void merge(const Accumulator& other, const uint32_t* from, const uint32_t* to, size_t n) override {
+        const auto& o = static_cast<const AvgAcc&>(other);
+        for (size_t i = 0; i < n; ++i) {
+            add(to[i], o.sums[from[i]]);
+            carry[to[i]] += o.carry[from[i]];
+            counts[to[i]] += o.counts[from[i]];
+        }
+    }
+
+    void format(uint32_t group, std::string& out) const override {
+        if (counts[group] == 0) out.clear();
+        else formatValue((carry[group] + static_cast<double>(sums[group])) / static_cast<double>(counts[group]), out);
+    }
+
+private:
+    void add(uint32_t group, T v) {
+        if (addChecked(sums[group], v)) return;
+        carry[group] += static_cast<double>(sums[group]);
+        sums[group] = v;
+    }
+
+    std::vector<T> sums;
+    std::vector<double> carry;
+    std::vector<int64_t> counts;
+};
+
+template <typename T, bool IsMax>
+class ExtremeAcc : public Accumulator {
+public:
+    void resize(size_t total) override {
+        vals.resize(total, T{});
+        seen.resize(total, 0);
+    }
+
+    void update(const uint32_t* groups, const std::string_view* values, size_t n) override {
+        T v;
+        for (size_t i = 0; i < n; ++i) {
+            if (!parseCell(values[i], v)) continue;
+            offer(groups[i], v);
+        }
+    }
+
+    void merge(const Accumulator& other, const uint32_t* from, const uint32_t* to, size_t n) override {
+        const auto& o = static_cast<const ExtremeAcc&>(other);
+        for (size_t i = 0; i < n; ++i) {
+            if (o.seen[from[i]]) offer(to[i], o.vals[from[i]]);
+        }
+    }
+
+    void format(uint32_t group, std::string& out) const override {
+        if (seen[group]) formatValue(vals[group], out);
+        else out.clear();
+    }
+
+private:
+    void offer(uint32_t g, const T& v) {
+        if (!seen[g] || (IsMax ? vals[g] < v : v < vals[g])) {
+            vals[g] = v;
+            seen[g] = 1;
+        }
+    }
+
+    std::vector<T> vals;
+    std::vector<uint8_t> seen;
+};
+
+template <template <typename> class Acc, typename... Args>
+std::unique_ptr<Accumulator> numericAcc(DataType t, Args&&... args) {
+    if (t == DataType::FLOAT) return std::make_unique<Acc<double>>(std::forward<Args>(args)...);
+    return std::make_unique<Acc<int64_t>>(std::forward<Args>(args)...);
+}
+
+template <bool IsMax>
+std::unique_ptr<Accumulator> extremeAcc(DataType t) {
+    switch (t) {
+        case DataType::INT: return std::make_unique<ExtremeAcc<int64_t, IsMax>>();
+        case DataType::FLOAT: return std::make_unique<ExtremeAcc<double, IsMax>>();
+        default: return std::make_unique<ExtremeAcc<std::string, IsMax>>();
+    }
+}
+
+} // namespace
+
+std::unique_ptr<Accumulator> makeAccumulator(const AggSpec& spec) {
+    switch (spec.func) {
+        case AggFunc::COUNT: return std::make_unique<CountAcc>(spec.column.empty());
+        case AggFunc::SUM: return numericAcc<SumAcc>(spec.inputType, aggName(spec));
+        case AggFunc::AVG: return numericAcc<AvgAcc>(spec.inputType);
+        case AggFunc::MIN: return extremeAcc<false>(spec.inputType);
+        case AggFunc::MAX: return extremeAcc<true>(spec.inputType);
+    }
+    return nullptr;
+}
+
+GroupTable::GroupTable() {
+    rehash(1024);
+    keyEnds.push_back(0);
+}
+
+std::string_view GroupTable::key(uint32_t group) const {
+    return std::string_view(keyData).substr(keyEnds[group], keyEnds[group + 1] - keyEnds[group]);
+}
+
+void GroupTable::rehash(size_t capacity) {
+    std::vector<Slot> old(capacity, Slot{0, kEmpty});
+    old.swap(slots);
+    mask = capacity - 1;
+    for (const auto& s : old) {
+        if (s.group == kEmpty) continue;
+        size_t pos = s.hash & mask;
+        while (slots[pos].group != kEmpty) pos = (pos + 1) & mask;
+        slots[pos] = s;
+    }
+}
+
+void GroupTable::findOrInsert(const uint64_t* hashes, const std::string_view* keys, size_t n, uint32_t* groupIds) {
+    // Keep the load factor at or below one half even if every key is new.
+    if ((size() + n) * 2 > slots.size()) {
+        size_t capacity = slots.size();
+        while ((size() + n) * 2 > capacity) capacity *= 2;
+        rehash(capacity);
+    }
+
+#if defined(__GNUC__)
+    for (size_t i = 0; i < n; ++i) __builtin_prefetch(&slots[hashes[i] & mask]);
+#endif
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t pos = hashes[i] & mask;
+        while (true) {
+            Slot& s = slots[pos];
+            if (s.group == kEmpty) {
+                uint32_t g = static_cast<uint32_t>(groupHashes.size());
+                s.hash = hashes[i];
+                s.group = g;
+                groupHashes.push_back(hashes[i]);
+                keyData.append(keys[i]);
+                keyEnds.push_back(keyData.size());
+                groupIds[i] = g;
+                break;
+            }
+            if (s.hash == hashes[i] && key(s.group) == keys[i]) {
+                groupIds[i] = s.group;
+                break;
+            }
+            pos = (pos + 1) & mask;
+        }
+    }
+}
+
+HashAggregator::HashAggregator(const SelectQuery& q, const std::vector<Column>& columns)
+    : groupIdx(q.groupByIdx), specs(q.aggregates) {
+    for (int idx : groupIdx) outColumns.push_back({columns[idx].name, columns[idx].type});
+
+    for (const auto& a : specs) {
+        int input = -1;
+        if (a.columnIdx >= 0) {
+            for (size_t k = 0; k < inputIdx.size(); ++k) {
+                if (inputIdx[k] == a.columnIdx) input = static_cast<int>(k);
+            }
+            if (input == -1) {
+                input = static_cast<int>(inputIdx.size());
+                inputIdx.push_back(a.columnIdx);
+            }
+        }
+        aggInput.push_back(input);
+        accs.push_back(makeAccumulator(a));
+
+        outColumns.push_back({aggName(a), aggResultType(a)});
+    }
+
+    inputBufs.resize(inputIdx.size());
+    inputEnds.resize(inputIdx.size());
+}
+
+void HashAggregator::consume(RowView& row) {
+    for (size_t k = 0; k < groupIdx.size(); ++k) {
+        if (k > 0) keyBuf.push_back('\0');
+        keyBuf.append(row.field(groupIdx[k]));
+    }
+    keyEnds.push_back(keyBuf.size());
+
+    for (size_t k = 0; k < inputIdx.size(); ++k) {
+        inputBufs[k].append(row.field(inputIdx[k]));
+        inputEnds[k].push_back(inputBufs[k].size());
+    }
+
+    if (++pending == kBatchSize) processBatch();
+}
+
+void HashAggregator::finish() {
+    if (pending > 0) processBatch();
+}
+
+void HashAggregator::processBatch() {
+    std::string_view keys[kBatchSize];
+    uint64_t hashes[kBatchSize];
+    uint32_t ids[kBatchSize];
+    std::string_view values[kBatchSize];
+
+    size_t begin = 0;
+    for (size_t i = 0; i < pending; ++i) {
+        keys[i] = std::string_view(keyBuf).substr(begin, keyEnds[i] - begin);
+        hashes[i] = hashBytes(keys[i]);
+        begin = keyEnds[i];
+    }
+
+    groups.findOrInsert(hashes, keys, pending, ids);
+    for (auto& acc : accs) acc->resize(groups.size());
+
+    for (size_t a = 0; a < accs.size(); ++a) {
+        int input = aggInput[a];
+        if (input >= 0) {
+            begin = 0;
+            for (size_t i = 0; i < pending; ++i) {
+                values[i] = std::string_view(inputBufs[input]).substr(begin, inputEnds[input][i] - begin);
+                begin = inputEnds[input][i];
+            }
+        }
+        accs[a]->update(ids, values, pending);
+    }
+
+    pending = 0;
+    keyBuf.clear();
+    keyEnds.clear();
+    for (size_t k = 0; k < inputBufs.size(); ++k) {
+        inputBufs[k].clear();
+        inputEnds[k].clear();
+    }
+}
+
+void HashAggregator::merge(HashAggregator& other, uint32_t partition, unsigned radixBits) {
+    finish();
+    other.finish();
+
+    std::vector<uint32_t> source;
+    std::vector<uint64_t> hashes;
+    std::vector<std::string_view> keys;
+    for (uint32_t g = 0; g < other.groups.size(); ++g) {
+        uint64_t h = other.groups.hash(g);
+        if (radixBits > 0 && (h >> (64 - radixBits)) != partition) continue;
+        source.push_back(g);
+        hashes.push_back(h);
+        keys.push_back(other.groups.key(g));
+    }
+
+    std::vector<uint32_t> target(source.size());
+    groups.findOrInsert(hashes.data(), keys.data(), source.size(), target.data());
+
+    for (size_t a = 0; a < accs.size(); ++a) {
+        accs[a]->resize(groups.size());
+        accs[a]->merge(*other.accs[a], source.data(), target.data(), source.size());
+    }
+}
+
+std::unique_ptr<HashAggregator> HashAggregator::emptyCopy() const {
+    std::unique_ptr<HashAggregator> copy(new HashAggregator());
+    copy->groupIdx = groupIdx;
+    copy->inputIdx = inputIdx;
+    copy->aggInput = aggInput;
+    copy->specs = specs;
+    copy->outColumns = outColumns;
+    for (const auto& a : specs) copy->accs.push_back(makeAccumulator(a));
+    copy->inputBufs.resize(inputIdx.size());
+    copy->inputEnds.resize(inputIdx.size());
+    return copy;
+}
+
+std::vector<ResultColumn> HashAggregator::resultColumns() const {
+    return outColumns;
+}
+
+void HashAggregator::emit(ResultWriter& writer) const {
+    // Global aggregation over an empty input still yields one row.
+    size_t total = groups.size();
+    if (total == 0 && !groupIdx.empty()) return;
+
+    std::vector<std::string> cells(outColumns.size());
+    std::vector<std::string_view> values(outColumns.size());
+    for (uint32_t g = 0; g < total || (total == 0 && g == 0); ++g) {
+        if (total > 0) {
+            std::string_view key = groups.key(g);
+            for (size_t k = 0; k < groupIdx.size(); ++k) {
+                size_t sep = key.find('\0');
+                cells[k].assign(key.substr(0, sep));
+                key = sep == std::string_view::npos ? std::string_view() : key.substr(sep + 1);
+            }
+        }
+        for (size_t a = 0; a < accs.size(); ++a) {
+            std::string& out = cells[groupIdx.size() + a];
+            if (total > 0) {
+                accs[a]->format(g, out);
+            } else {
+                out = specs[a].func == AggFunc::COUNT ? "0" : "";
+            }
+        }
+        for (size_t i = 0; i < cells.size(); ++i) values[i] = cells[i];
+        writer.row(values);
+    }
+}
+
+std::vector<std::unique_ptr<HashAggregator>> aggregateTable(
+    const SelectQuery& q, const std::vector<Column>& columns, const std::string& path, ByteRange range,
+    size_t threads, const std::function<void(const std::string&)>& onMalformed, ScanCounters* counters) {
+    // Below this many groups in total a serial merge is cheaper than partitioning.
+    constexpr size_t kRadixMergeMinGroups = 1 << 16;
+    constexpr unsigned kRadixBits = 6;
+
+    MorselDispenser dispenser(range, kMorselBytes);
+
+    std::vector<std::unique_ptr<HashAggregator>> partials;
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) partials.push_back(std::make_unique<HashAggregator>(q, columns));
+
+    std::mutex reportMutex;
+    auto report = [&](const std::string& line) {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        onMalformed(line);
+    };
+    // Every worker folds whichever morsels it pulls into its own aggregator.
+    auto scan = [&](size_t i) {
+        HashAggregator& agg = *partials[i];
+        std::ifstream in(path, std::ios::binary);
+        size_t index;
+        ByteRange morsel;
+        uint64_t read = 0, passed = 0;
+        while (dispenser.next(index, morsel)) {
+            forEachRowInRange(in, morsel, columns.size(),
+                [&](RowView& row) {
+                    ++read;
+                    if (q.filter && !matches(*q.filter, row.field(q.filter->columnIdx))) return true;
+                    ++passed;
+                    agg.consume(row);
+                    return true;
+                },
+                report);
+        }
+        agg.finish();
+        if (counters) counters->add(read, passed);
+    };
+
+    if (partials.size() == 1) {
+        scan(0);
+        return partials;
+    }
+
+    parallelFor(partials.size(), scan);
+
+    size_t totalGroups = 0;
+    for (const auto& p : partials) totalGroups += p->groupCount();
+
+    std::vector<std::unique_ptr<HashAggregator>> result;
+    if (totalGroups < kRadixMergeMinGroups) {
+        for (size_t i = 1; i < partials.size(); ++i) partials[0]->merge(*partials[i]);
+        result.push_back(std::move(partials[0]));
+        return result;
+    }
+
+    // Each radix partition owns a disjoint slice of the hash space, so the
+    // partitions can be merged independently and concatenated.
+    const size_t partitions = size_t(1) << kRadixBits;
+    for (size_t p = 0; p < partitions; ++p) result.push_back(partials[0]->emptyCopy());
+
+    parallelFor(partitions, [&](size_t p) {
+        for (auto& partial : partials) result[p]->merge(*partial, static_cast<uint32_t>(p), kRadixBits);
+    });
+    return result;
+}
@@ -0,0 +1,284 @@
+#include "cdb.h"
+#include "Database.hpp"
+#include <mutex>
+#include <sstream>
+
+struct cdb_db {
+    std::unique_ptr<Database> db;
+    std::mutex mutex;
+    std::string error;                   // of the last call on it or its statements that failed
+};
+
+struct cdb_stmt {
+    cdb_db* owner = nullptr;
+    std::unique_ptr<Statement> statement;
+    std::unique_ptr<Rows> rows;          // the current run of a dikhao or jodo
+    std::vector<ResultColumn> columns;   // of that run
+    bool done = false;
+    std::string output;
+    std::string warnings;
+};
+
+namespace {
+
+// cdb_exec's output. A cdb_db may be shared between threads, so it is kept per thread.
+thread_local std::string lastOutput;
+
+// Records error on db, when there is one to record it on.
+int fail(cdb_db* db, const std::string& error, int code = CDB_ERROR) {
+    if (db) {
+        std::lock_guard<std::mutex> lock(db->mutex);
+        db->error = error;
+    }
+    return code;
+}
+
+// Starts a run of a dikhao or jodo if none is under way.
+bool start(cdb_stmt* stmt) {
+    if (stmt->rows || stmt->done) return true;
+    std::string error;
+    stmt->rows = stmt->statement->query(error);
+    if (!stmt->rows) {
+        fail(stmt->owner, error);
+        return false;
+    }
+    stmt->columns = stmt->rows->columns();
+    return true;
+}
+
+// The current batch of stmt if col is one of its columns.
+const BatchColumn* batchColumn(cdb_stmt* stmt, int col) {
+    if (!stmt || !stmt->rows || !stmt->rows->batch() || col < 0) return nullptr;
+    const RowBatch* batch = stmt->rows->batch();
+    return static_cast<size_t>(col) < batch->columns.size() ? &batch->columns[col] : nullptr;
+}
+
+// True when stmt is on a row and col is one of its columns.
+bool onCell(cdb_stmt* stmt, int col) {
+    return batchColumn(stmt, col) && stmt->rows->position() < stmt->rows->batch()->rows;
+}
+
+// After the last row: keeps the warnings and reports how the run ended.
+int finish(cdb_stmt* stmt) {
+    stmt->done = true;
+    stmt->warnings = stmt->rows->warnings();
+    std::string error = stmt->rows->error();
+    stmt->rows.reset();
+    return error.empty() ? CDB_DONE : fail(stmt->owner, error);
+}
+
+} // namespace
+
+extern "C" {
+
+int cdb_open(const char* directory, cdb_db** db) {
+    if (!directory || !db) return CDB_MISUSE;
+    *db = nullptr;
+    try {
+        *db = new cdb_db();
+        std::string error;
+        (*db)->db = Database::open(directory, error);
+        return (*db)->db ? CDB_OK : fail(*db, error);
+    } catch (const std::exception& e) {
+        return fail(*db, e.what());
+    }
+}
+
+int cdb_close(cdb_db* db) {
+    delete db;
+    return CDB_OK;
+}
+
+const char* cdb_errmsg(cdb_db* db) {
+    if (!db) return "";
+    std::lock_guard<std::mutex> lock(db->mutex);
+    return db->error.c_str();
+}
+
+int cdb_exec(cdb_db* db, const char* command, const char** output) {
+    if (!db || !db->db || !command) return fail(db, "cdb_exec: NULL or unopened database", CDB_MISUSE);
+    try {
+        std::vector<std::string> args;
+        std::string error;
+        if (!splitCommandLine(command, args, error)) return fail(db, error);
+        if (args.empty()) return fail(db, "Empty command.");
+        std::ostringstream out, err;
+        bool ok = db->db->execute(args, out, err);
+        lastOutput = out.str();
+        if (output) *output = lastOutput.c_str();
+        return ok ? CDB_OK : fail(db, lastOutput);
+    } catch (const std::exception& e) {
+        return fail(db, e.what());
+    }
+}
+
+int cdb_prepare(cdb_db* db, const char* command, cdb_stmt** stmt) {
+    if (!db || !db->db || !command || !stmt) return fail(db, "cdb_prepare: NULL or unopened database", CDB_MISUSE);
+    *stmt = nullptr;
+    try {
+        std::string error;
+        auto statement = db->db->prepare(command, error);
+        if (!statement) return fail(db, error);
+        *stmt = new cdb_stmt();
+        (*stmt)->owner = db;
+        (*stmt)->statement = std::move(statement);
+        return CDB_OK;
+    } catch (const std::exception& e) {
+        return fail(db, e.what());
+    }
+}
+
+int cdb_finalize(cdb_stmt* stmt) {
+    delete stmt;
+    return CDB_OK;
+}
+
+int cdb_bind_parameter_count(cdb_stmt* stmt) {
+    return stmt ? static_cast<int>(stmt->statement->parameterCount()) : 0;
+}
+
+int cdb_bind_text(cdb_stmt* stmt, int index, const char* value) {
+    if (!stmt) return CDB_MISUSE;
+    if (!value) return fail(stmt->owner, "cdb_bind_text: NULL value", CDB_MISUSE);
+    if (index < 0 || !stmt->statement->bind(static_cast<size_t>(index), std::string(value))) {
+        return fail(stmt->owner, "cdb_bind_text: no parameter " + std::to_string(index), CDB_MISUSE);
+    }
+    return CDB_OK;
+}
+
+int cdb_bind_int64(cdb_stmt* stmt, int index, int64_t value) {
+    if (!stmt) return CDB_MISUSE;
+    if (index < 0 || !stmt->statement->bind(static_cast<size_t>(index), value)) {
+        return fail(stmt->owner, "cdb_bind_int64: no parameter " + std::to_string(index), CDB_MISUSE);
+    }
+    return CDB_OK;
+}
+
+int cdb_step(cdb_stmt* stmt) {
+    if (!stmt) return CDB_MISUSE;
+    if (stmt->done) return CDB_DONE;
+    try {
+        const auto& args = stmt->statement->arguments();
+        if (args.front() != "dikhao" && args.front() != "jodo") {
+            std::ostringstream out, err;
+            bool ok = stmt->statement->execute(out, err);
+            stmt->output = out.str();
+            stmt->warnings = err.str();
+            stmt->done = true;
+            return ok ? CDB_DONE : fail(stmt->owner, stmt->output);
+        }
+        if (!start(stmt)) return CDB_ERROR;
+        return stmt->rows->next() ? CDB_ROW : finish(stmt);
+    } catch (const std::exception& e) {
+        return fail(stmt->owner, e.what());
+    }
+}
+
+int cdb_step_batch(cdb_stmt* stmt) {
+    if (!stmt) return CDB_MISUSE;
+    if (stmt->done) return CDB_DONE;
+    try {
+        if (!start(stmt)) return CDB_ERROR;
+        return stmt->rows->nextBatch() ? CDB_ROW : finish(stmt);
+    } catch (const std::exception& e) {
+        return fail(stmt->owner, e.what());
+    }
+}
+
+int cdb_reset(cdb_stmt* stmt) {
+    if (!stmt) return CDB_MISUSE;
+    stmt->rows.reset();
+    stmt->columns.clear();
+    stmt->done = false;
+    stmt->output.clear();
+    stmt->warnings.clear();
+    return CDB_OK;
+}
+
+const char* cdb_output(cdb_stmt* stmt) {
+    return stmt ? stmt->output.c_str() : "";
+}
+
+const char* cdb_warnings(cdb_stmt* stmt) {
+    return stmt ? stmt->warnings.c_str() : "";
+}
+
+int cdb_column_count(cdb_stmt* stmt) {
+    if (!stmt) return 0;
+    const auto& args = stmt->statement->arguments();
+    if (args.front() == "dikhao" || args.front() == "jodo") {
+        try {
+            start(stmt);
+        } catch (const std::exception& e) {
+            fail(stmt->owner, e.what());
+        }
+    }
+    return static_cast<int>(stmt->columns.size());
+}
+
+const char* cdb_column_name(cdb_stmt* stmt, int col) {
+    if (col < 0 || col >= cdb_column_count(stmt)) return nullptr;
+    return stmt->columns[col].name.c_str();
+}
+
+int cdb_column_type(cdb_stmt* stmt, int col) {
+    if (col < 0 || col >= cdb_column_count(stmt)) return -1;
+    switch (stmt->columns[col].type) {
+        case DataType::INT: return CDB_INT;
+        case DataType::FLOAT: return CDB_FLOAT;
+        default: return CDB_STRING;
+    }
+}
+
+int cdb_column_is_null(cdb_stmt* stmt, int col) {
+    return onCell(stmt, col) ? stmt->rows->isNull(col) : 1;
+}
+
+int64_t cdb_column_int64(cdb_stmt* stmt, int col) {
+    return onCell(stmt, col) ? stmt->rows->getInt(col) : 0;
+}
+
+double cdb_column_double(cdb_stmt* stmt, int col) {
+    return onCell(stmt, col) ? stmt->rows->getDouble(col) : 0;
+}
+
+const char* cdb_column_text(cdb_stmt* stmt, int col, size_t* len) {
+    std::string_view text = onCell(stmt, col) ? stmt->rows->getString(col) : std::string_view();
+    if (len) *len = text.size();
+    return text.data();
+}
+
+size_t cdb_batch_rows(cdb_stmt* stmt) {
+    return stmt && stmt->rows && stmt->rows->batch() ? stmt->rows->batch()->rows : 0;
+}
+
+size_t cdb_batch_row(cdb_stmt* stmt) {
+    return stmt && stmt->rows ? stmt->rows->position() : 0;
+}
+
+const uint8_t* cdb_batch_validity(cdb_stmt* stmt, int col) {
+    const BatchColumn* c = batchColumn(stmt, col);
+    return c ? c->valid.data() : nullptr;
+}
+
+const int64_t* cdb_batch_int64(cdb_stmt* stmt, int col) {
+    const BatchColumn* c = batchColumn(stmt, col);
+    return c && c->type == DataType::INT ? c->ints.data() : nullptr;
+}
+
+const double* cdb_batch_double(cdb_stmt* stmt, int col) {
+    const BatchColumn* c = batchColumn(stmt, col);
+    return c && c->type == DataType::FLOAT ? c->floats.data() : nullptr;
+}
+
+const uint32_t* cdb_batch_text_ends(cdb_stmt* stmt, int col) {
+    const BatchColumn* c = batchColumn(stmt, col);
+    return c ? c->ends.data() : nullptr;
+}
+
+const char* cdb_batch_text_bytes(cdb_stmt* stmt, int col) {
+    const BatchColumn* c = batchColumn(stmt, col);
+    return c ? c->bytes.data() : nullptr;
+}
+
+} // extern "C"
@@ -1,13 +1,34 @@
 #include "CommandHandler.hpp"
 #include "Schema.hpp"
 #include "Utility.hpp"
+#include "Query.hpp"
+#include "TableScan.hpp"
+#include "ResultWriter.hpp"
+#include "Aggregate.hpp"
+#include "ExternalSort.hpp"
+#include "Join.hpp"
+#include "Mutation.hpp"
+#include "Executor.hpp"
+#include "Explain.hpp"
+#include "Insert.hpp"
+#include "PlanCache.hpp"
+#include "Script.hpp"
+#include "Server.hpp"
+#include "Planner.hpp"
+#include "Statistics.hpp"
+#include "ThreadPool.hpp"
+#include <chrono>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <cmath>
 #include <optional>
 
 #ifdef _WIN32
   #include <direct.h>
+  #include <fcntl.h>
+  #include <io.h>
 #else
   #include <sys/stat.h>
   #include <sys/types.h>
@@ -22,11 +43,122 @@ void makeDir(const std::string& path) {
 #endif
 }
 
-void handleCommand(int argc, char* argv[], const std::string& command) {
+// Warns about table rows with the wrong number of fields on err.
+static MalformedFn malformedReporter(std::ostream& err) {
+    return [&err](const std::string& line) { err << "Skipping malformed row: " << line << "\n"; };
+}
+
+// After update_karo / delete_karo: folds the change into the table's
+// statistics and analyzes it again once they have drifted too far.
+static void refreshStats(const std::string& root, const std::string& tableName, const std::vector<Column>& columns,
+                         const std::function<void(TableStats&, uint64_t)>& note, const MalformedFn& reportMalformed) {
+    Catalog cat = Catalog::load(root);
+    auto tdef = cat.getTable(tableName);
+    if (!tdef || !tdef->stats) return;
+
+    std::string path = dataPath(root, tableName);
+    std::error_code ec;
+    uint64_t bytes = std::filesystem::file_size(path, ec);
+    note(*tdef->stats, ec ? 0 : bytes);
+    if (statsStale(*tdef->stats)) {
+        TableStats fresh;
+        std::string error;
+        if (analyzeTable(path, columns, fresh, reportMalformed, error)) tdef->stats = fresh;
+    }
+    cat.updateTable(*tdef);
+    cat.save();
+}
+
+// The bin and columns formats write raw bytes; keep Windows from translating line breaks.
+static void prepareStdout(const std::string& format) {
+#ifdef _WIN32
+    if (format == "bin" || format == "columns") _setmode(_fileno(stdout), _O_BINARY);
+#else
+    (void)format;
+#endif
+}
+
+enum class ExplainMode { None, Plan, Analyze };
+
+// Prints the plan for explain; for explain analyze runs it first through run,
+// which writes the result rows to a stream that discards them.
+static void explainPlan(const PlanNode& plan, double planningSeconds, ExplainMode mode, std::ostream& out,
+                        const std::function<void(std::ostream&, PlanProfile&)>& run) {
+    PlanProfile profile;
+    if (mode == ExplainMode::Analyze) {
+        std::ostream discard(nullptr);
+        run(discard, profile);
+    }
+    printPlan(plan, out, mode == ExplainMode::Analyze ? &profile : nullptr);
+    out << "Planning: " << std::fixed << std::setprecision(3) << planningSeconds << " s\n";
+}
+
+// dikhao or jodo, run or explained; argv[1] is the command name.
+static bool queryCommand(const std::string& root, int argc, char* argv[], ExplainMode explain, std::ostream& out,
+                         std::ostream& err) {
+    auto reportMalformed = malformedReporter(err);
+    const std::string command = argv[1];
+    if (command == "dikhao" && argc < 3) {
+        out << "Usage: cdb dikhao <table> [cols <c1,c2,...>] [where <col> (=|like) <value>]\n"
+                  << "       [group by <c1,...>] [agg count|count:<col>|sum:<col>|avg:<col>|min:<col>|max:<col>,...]\n"
+                  << "       [order by <c1[:asc|:desc],...>] [limit <n>] [offset <m>] [format box|csv|jsonl|bin|columns]\n";
+        return false;
+    }
+    if (command == "jodo" && argc < 4) {
+        out << "Usage: cdb jodo <left> <right> [on <lcol>=<rcol>] [cols <t.c,...>] [where <t.c> (=|like) <value>]\n"
+                  << "       [order by <t.c[:asc|:desc],...>] [limit <n>] [offset <m>] [format box|csv|jsonl|bin|columns]\n";
+        return false;
+    }
+
+    std::string error;
+    if (explain == ExplainMode::None) {
+        // Plans are reused from earlier runs of the same statement in this process (run, serve).
+        PreparedQuery prepared;
+        if (!PlanCache::instance().prepare(root, std::vector<std::string>(argv + 1, argv + argc), prepared, error)) {
+            out << error << "\n";
+            return false;
+        }
+        if (prepared.parameter) {
+            out << "The where value is a parameter (?); give it through a prepared statement.\n";
+            return false;
+        }
+        const auto& query = *prepared.query;
+        prepareStdout(query.output().format);
+        try {
+            executeQuery(*prepared.plan, query, makeResultWriter(query.output().format, out), reportMalformed);
+        } catch (const std::runtime_error& e) {
+            out << "Query failed: " << e.what() << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    BoundQuery query;
+    if (!bindQuery(root, command, std::vector<std::string>(argv + 2, argv + argc), query, error)) {
+        out << error << "\n";
+        return false;
+    }
+    auto planStart = std::chrono::steady_clock::now();
+    auto plan = planQuery(query, Catalog::load(root));
+    double planning = std::chrono::duration<double>(std::chrono::steady_clock::now() - planStart).count();
+    try {
+        explainPlan(*plan, planning, explain, out, [&](std::ostream& out, PlanProfile& profile) {
+            executeQuery(*plan, query, makeResultWriter(query.output().format, out), reportMalformed, &profile);
+        });
+    } catch (const std::runtime_error& e) {
+        out << "Query failed: " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool handleCommand(const std::string& root, int argc, char* argv[], const std::string& command, std::ostream& out,
+                   std::ostream& err, std::istream& in) {
+    auto reportMalformed = malformedReporter(err);
     if (command == "table_banao") {
     if (argc < 4) {
-        std::cout << "Usage: cdb table_banao <table> <col:type[:pk][:notnull][:fk=tbl.col]> ...\n";
-        return;
+        out << "Usage: cdb table_banao <table> <col:type[:pk][:notnull][:fk=tbl.col]> ...\n";
+        return false;
     }
 
     std::string tableName = argv[2];
@@ -39,16 +171,16 @@ void handleCommand(int argc, char* argv[], const std::string& command) {
         // split by ':'
         auto parts = split(spec, ':'); // use your Utility::split(string, char)
         if (parts.size() < 2) {
-            std::cout << "Invalid column spec: " << spec << "\n";
-            return;
+            out << "Invalid column spec: " << spec << "\n";
+            return false;
         }
         ColumnDef c;
         c.name = parts[0];
         try {
             c.type = getDataType(parts[1]); // your existing mapper
         } catch (...) {
-            std::cout << "Invalid type in: " << spec << "\n";
-            return;
+            out << "Invalid type in: " << spec << "\n";
+            return false;
         }
         for (size_t k = 2; k < parts.size(); ++k) {
             if (parts[k] == "pk") c.isPrimaryKey = true;
@@ -61,22 +193,22 @@ void handleCommand(int argc, char* argv[], const std::string& command) {
                     c.fkTable  = pair[0];
                     c.fkColumn = pair[1];
                 } else {
-                    std::cout << "Invalid fk format in: " << spec << " (use fk=Table.Column)\n";
-                    return;
+                    out << "Invalid fk format in: " << spec << " (use fk=Table.Column)\n";
+                    return false;
                 }
             } else {
-                std::cout << "Unknown modifier in: " << spec << " (use pk/notnull/fk=...)\n";
-                return;
+                out << "Unknown modifier in: " << spec << " (use pk/notnull/fk=...)\n";
+                return false;
             }
         }
         tdef.columns.push_back(c);
     }
 
     // Load & update catalog
-    Catalog cat = Catalog::load();
+    Catalog cat = Catalog::load(root);
     if (cat.tableExists(tableName)) {
-        std::cout << "Table already exists: " << tableName << "\n";
-        return;
+        out << "Table already exists: " << tableName << "\n";
+        return false;
     }
 
     // (Optional) Validate FK targets exist right now (stronger UX)
@@ -84,156 +216,203 @@ void handleCommand(int argc, char* argv[], const std::string& command) {
         if (col.hasForeignKey) {
             auto tgt = cat.getTable(col.fkTable);
             if (!tgt.has_value()) {
-                std::cout << "FK references missing table: " << col.fkTable << "\n";
-                return;
+                out << "FK references missing table: " << col.fkTable << "\n";
+                return false;
             }
             bool foundCol = false;
             for (const auto& tc : tgt->columns) {
                 if (tc.name == col.fkColumn) { foundCol = true; break; }
             }
             if (!foundCol) {
-                std::cout << "FK references missing column: " << col.fkTable << "." << col.fkColumn << "\n";
-                return;
+                out << "FK references missing column: " << col.fkTable << "." << col.fkColumn << "\n";
+                return false;
             }
         }
     }
 
     if (!cat.addTable(tdef) || !cat.save()) {
-        std::cout << "Failed to register table in catalog.\n";
-        return;
+        out << "Failed to register table in catalog.\n";
+        return false;
     }
 
     // Create empty data file
-    makeDir("data"); // use same helper as before
-    std::ofstream dataFile(("data/" + tableName + ".dat").c_str(), std::ios::app);
+    makeDir(databasePath(root, "data")); // use same helper as before
+    std::ofstream dataFile(dataPath(root, tableName).c_str(), std::ios::app);
     dataFile.close();
 
-    // Create per-table schema snapshot if you still use it elsewhere (optional)
-    // Or you can migrate all schema reads to Catalog instead of Schema::<...>
+    // Per-table schema snapshot, read by dikhao/update_karo/delete_karo/describe_kro
+    std::vector<Column> snapshot;
+    for (const auto& col : tdef.columns) snapshot.push_back({col.name, col.type});
+    if (!Schema(snapshot).saveToFile(root, tableName)) {
+        out << "Failed to write schema file for table: " << tableName << "\n";
+        return false;
+    }
 
-    std::cout << "Relational table '" << tableName << "' created and registered.\n";
+    out << "Relational table '" << tableName << "' created and registered.\n";
 }
 
 
 
-else if (command == "dikhao") {
-    if (argc < 3) {
-        std::cout << "Usage: cdb dikhao <table> [where <col> (=|like) <value>]\n";
-        return;
+else if (command == "insert_karo") {
+    if (argc < 4) {
+        out << "Usage: cdb insert_karo <table> <value1> <value2> ... [<value1> <value2> ... ]\n";
+        return false;
     }
 
     std::string tableName = argv[2];
-    Schema schema;
-    try {
-        schema = Schema::loadFromFile(tableName);
-    } catch (const std::exception& e) {
-        std::cout << "Failed to load schema for table: " << tableName << "\n";
-        return;
+    Catalog cat = Catalog::load(root);
+    auto tdef = cat.getTable(tableName);
+    if (!tdef) {
+        out << "Table not found: " << tableName << "\n";
+        return false;
     }
 
-    std::ifstream dataFile("data/" + tableName + ".dat");
-    if (!dataFile.is_open()) {
-        std::cout << "Failed to open data file for table: " << tableName << "\n";
-        return;
+    // Every group of as many values as the table has columns is a row.
+    const size_t columnCount = tdef->columns.size();
+    const size_t valueCount = static_cast<size_t>(argc - 3);
+    if (columnCount == 0 || valueCount % columnCount != 0) {
+        out << "Expected " << columnCount << " value(s) per row, got " << valueCount << ".\n";
+        return false;
     }
+    std::vector<std::vector<std::string>> rows;
+    for (size_t i = 3; i < static_cast<size_t>(argc); i += columnCount) rows.emplace_back(argv + i, argv + i + columnCount);
 
-    bool useFilter = false;
-    std::string whereCol, whereOp, whereVal;
+    bool stillClustered = false;
+    std::string error;
+    if (!insertRows(*tdef, cat, rows, stillClustered, error)) {
+        out << error << "\n";
+        return false;
+    }
 
-    if (argc > 3 && std::string(argv[3]) == "where") {
-        if (argc == 7) {
-            useFilter = true;
-            whereCol = argv[4];
-            whereOp = argv[5];
-            whereVal = argv[6];
-        } else {
-            std::cout << "Invalid WHERE clause syntax.\n";
-            return;
-        }
+    if (!tdef->clusteredBy.empty() && !stillClustered) {
+        tdef->clusteredBy.clear();
+        cat.updateTable(*tdef);
+        cat.save();
     }
+    std::vector<Column> columns;
+    for (const auto& c : tdef->columns) columns.push_back({c.name, c.type});
+    refreshStats(root, tableName, columns, [&](TableStats& stats, uint64_t bytes) {
+        noteInserted(stats, columns, rows, bytes);
+    }, reportMalformed);
 
-    int whereColIdx = -1;
-    if (useFilter) {
-        const auto& columns = schema.getColumns();
-        for (size_t i = 0; i < columns.size(); ++i) {
-            if (columns[i].name == whereCol) {
-                whereColIdx = static_cast<int>(i);
-                break;
-            }
-        }
-        if (whereColIdx == -1) {
-            std::cout << "Column not found in schema: " << whereCol << "\n";
-            return;
-        }
+    out << "Inserted " << rows.size() << " row(s).\n";
+}
+else if (command == "dikhao" || command == "jodo") {
+    return queryCommand(root, argc, argv, ExplainMode::None, out, err);
+}
+else if (command == "explain") {
+    bool analyze = argc > 2 && std::string(argv[2]) == "analyze";
+    int shift = analyze ? 2 : 1;
+    std::string target = argc > shift + 1 ? argv[shift + 1] : "";
+    if (target != "dikhao" && target != "jodo") {
+        out << "Usage: cdb explain [analyze] dikhao <table> [clauses...]\n"
+                  << "       cdb explain [analyze] jodo <left> <right> [clauses...]\n";
+        return false;
+    }
+    return queryCommand(root, argc - shift, argv + shift, analyze ? ExplainMode::Analyze : ExplainMode::Plan, out, err);
+}
+else if (command == "cluster_karo") {
+    if (argc < 4) {
+        out << "Usage: cdb cluster_karo <table> <col>\n";
+        return false;
     }
 
-    const auto& columns = schema.getColumns();
-    std::vector<std::vector<std::string>> allRows;
+    std::string tableName = argv[2];
+    std::string column = argv[3];
 
-    std::string line;
-    while (std::getline(dataFile, line)) {
-        auto values = split(line, ',');  
-        if (values.size() != columns.size()) {
-            std::cout << "Skipping malformed row: " << line << "\n";
-            continue;
-        }
-        allRows.push_back(values);
+    Schema schema;
+    try {
+        schema = Schema::loadFromFile(root, tableName);
+    } catch (...) {
+        out << "Failed to load schema for table: " << tableName << "\n";
+        return false;
     }
-    dataFile.close();
-
-    std::vector<size_t> colWidths(columns.size());
+    const auto& columns = schema.getColumns();
+    int colIdx = -1;
     for (size_t i = 0; i < columns.size(); ++i) {
-        colWidths[i] = columns[i].name.size();
+        if (columns[i].name == column) colIdx = static_cast<int>(i);
     }
-    for (const auto& row : allRows) {
-        for (size_t i = 0; i < row.size(); ++i) {
-            if (row[i].size() > colWidths[i]) {
-                colWidths[i] = row[i].size();
-            }
-        }
+    if (colIdx == -1) {
+        out << "Column not found in schema: " << column << "\n";
+        return false;
     }
 
-    auto printSeparator = [&]() {
-        for (auto w : colWidths) {
-            std::cout << "+" << std::string(w + 2, '-');
-        }
-        std::cout << "+\n";
-    };
+    Catalog cat = Catalog::load(root);
+    auto tdef = cat.getTable(tableName);
+    if (!tdef) {
+        out << "Table not registered in catalog: " << tableName << "\n";
+        return false;
+    }
 
-    printSeparator();
-    for (size_t i = 0; i < columns.size(); ++i) {
-        std::cout << "| " << std::left << std::setw(colWidths[i]) << columns[i].name << " ";
-    }
-    std::cout << "|\n";
-    printSeparator();
-
-    for (const auto& row : allRows) {
-        bool match = true;
-        if (useFilter) {
-            std::string cell = row[whereColIdx];
-            if (whereOp == "=") {
-                match = (cell == whereVal);
-            } else if (whereOp == "like") {
-                match = (cell.find(whereVal) != std::string::npos);
-            } else {
-                std::cout << "Unsupported operator: " << whereOp << "\n";
-                return;
-            }
-        }
+    MemoryBudget budget(queryMemoryLimit());
+    size_t rows = 0;
+    std::string error;
+    if (!sortTableFile(root, tableName, columns.size(), colIdx, columns[colIdx].type, budget, reportMalformed, rows,
+                       error)) {
+        out << error << "\n";
+        return false;
+    }
 
-        if (match) {
-            for (size_t i = 0; i < row.size(); ++i) {
-                std::cout << "| " << std::left << std::setw(colWidths[i]) << row[i] << " ";
-            }
-            std::cout << "|\n";
-        }
+    tdef->clusteredBy = column;
+    if (!cat.updateTable(*tdef) || !cat.save()) {
+        out << "Failed to record clustering in catalog.\n";
+        return false;
+    }
+    out << "Clustered " << rows << " row(s) of '" << tableName << "' by " << column << ".\n";
+}
+else if (command == "analyze_karo") {
+    if (argc < 3) {
+        out << "Usage: cdb analyze_karo <table>\n";
+        return false;
     }
-    printSeparator();
+
+    std::string tableName = argv[2];
+    Schema schema;
+    try {
+        schema = Schema::loadFromFile(root, tableName);
+    } catch (...) {
+        out << "Failed to load schema for table: " << tableName << "\n";
+        return false;
+    }
+    const auto& columns = schema.getColumns();
+
+    Catalog cat = Catalog::load(root);
+    auto tdef = cat.getTable(tableName);
+    if (!tdef) {
+        out << "Table not found in catalog: " << tableName << "\n";
+        return false;
+    }
+
+    TableStats stats;
+    std::string error;
+    if (!analyzeTable(dataPath(root, tableName), columns, stats, reportMalformed, error)) {
+        out << error << "\n";
+        return false;
+    }
+    tdef->stats = stats;
+    cat.updateTable(*tdef);
+    if (!cat.save()) {
+        out << "Failed to save catalog.\n";
+        return false;
+    }
+
+    out << "Analyzed " << stats.rows << " row(s) of '" << tableName << "'.\n";
+    out << "+----------------+------------+------------+------------------+------------------+\n";
+    out << "| Column         | Nulls      | Distinct   | Min              | Max              |\n";
+    out << "+----------------+------------+------------+------------------+------------------+\n";
+    for (const auto& c : stats.columns) {
+        out << "| " << std::setw(14) << std::left << c.column
+                  << " | " << std::setw(10) << std::left << c.nulls
+                  << " | " << std::setw(10) << std::left << static_cast<uint64_t>(std::llround(c.distinct))
+                  << " | " << std::setw(16) << std::left << c.min
+                  << " | " << std::setw(16) << std::left << c.max << " |\n";
+    }
+    out << "+----------------+------------+------------+------------------+------------------+\n";
 }
 else if (command == "update_karo") {
     if (argc < 5 || std::string(argv[3]) != "change") {
-        std::cout << "Usage: cdb update_karo <table> change <col>=<val> [where <col> (=|like) <val>]\n";
-        return;
+        out << "Usage: cdb update_karo <table> change <col>=<val> [where <col> (=|like) <val>]\n";
+        return false;
     }
 
     std::string tableName = argv[2];
@@ -241,8 +420,8 @@ else if (command == "update_karo") {
 
     auto setParts = split(setArg, '=');
     if (setParts.size() != 2) {
-        std::cout << "Invalid change format. Use <col>=<val>\n";
-        return;
+        out << "Invalid change format. Use <col>=<val>\n";
+        return false;
     }
 
     std::string setCol = setParts[0];
@@ -260,10 +439,10 @@ else if (command == "update_karo") {
 
     Schema schema;
     try {
-        schema = Schema::loadFromFile(tableName);
+        schema = Schema::loadFromFile(root, tableName);
     } catch (...) {
-        std::cout << "Failed to load schema.\n";
-        return;
+        out << "Failed to load schema.\n";
+        return false;
     }
 
     const auto& columns = schema.getColumns();
@@ -275,66 +454,49 @@ else if (command == "update_karo") {
     }
 
     if (setColIdx == -1) {
-        std::cout << "Column to change not found in schema: " << setCol << "\n";
-        return;
+        out << "Column to change not found in schema: " << setCol << "\n";
+        return false;
     }
     if (useFilter && whereColIdx == -1) {
-        std::cout << "WHERE column not found in schema: " << whereCol << "\n";
-        return;
+        out << "WHERE column not found in schema: " << whereCol << "\n";
+        return false;
     }
 
-    std::ifstream inFile("data/" + tableName + ".dat");
-    if (!inFile.is_open()) {
-        std::cout << "Failed to open data file.\n";
-        return;
+    if (useFilter && whereOp != "=" && whereOp != "like") {
+        out << "Unsupported WHERE operator: " << whereOp << "\n";
+        return false;
     }
 
-    std::vector<std::vector<std::string>> updatedRows;
-    std::string line;
-    int updateCount = 0;
+    Mutation mutation;
+    if (useFilter) mutation.filter = Predicate{whereCol, whereOp, whereVal, whereColIdx};
+    mutation.setIdx = setColIdx;
+    mutation.setValue = setVal;
 
-    while (std::getline(inFile, line)) {
-        auto values = split(line, ',');
-        if (values.size() != columns.size()) continue;
-
-        bool match = true;
-        if (useFilter) {
-            std::string cell = values[whereColIdx];
-            if (whereOp == "=") {
-                match = (cell == whereVal);
-            } else if (whereOp == "like") {
-                match = cell.find(whereVal) != std::string::npos;
-            } else {
-                std::cout << "Unsupported WHERE operator: " << whereOp << "\n";
-                return;
-            }
-        }
-
-        if (match) {
-            values[setColIdx] = setVal;
-            updateCount++;
-        }
-
-        updatedRows.push_back(values);
+    size_t updateCount = 0;
+    std::string error;
+    if (!applyMutation(root, tableName, columns.size(), mutation, updateCount, reportMalformed, error)) {
+        out << error << "\n";
+        return false;
     }
-    inFile.close();
 
-    std::ofstream outFile("data/" + tableName + ".dat");
-    for (const auto& row : updatedRows) {
-        for (size_t i = 0; i < row.size(); ++i) {
-            outFile << row[i];
-            if (i != row.size() - 1) outFile << ",";
-        }
-        outFile << "\n";
+    // Rewriting the cluster column breaks the file's sort order.
+    Catalog cat = Catalog::load(root);
+    auto tdef = cat.getTable(tableName);
+    if (tdef && tdef->clusteredBy == setCol && updateCount > 0) {
+        tdef->clusteredBy.clear();
+        cat.updateTable(*tdef);
+        cat.save();
     }
-    outFile.close();
+    refreshStats(root, tableName, columns, [&](TableStats& stats, uint64_t bytes) {
+        noteUpdated(stats, columns[setColIdx], setVal, updateCount, bytes);
+    }, reportMalformed);
 
-    std::cout << "Updated " << updateCount << " row(s).\n";
+    out << "Updated " << updateCount << " row(s).\n";
 }
 else if (command == "delete_karo") {
     if (argc < 3) {
-        std::cout << "Usage: cdb delete_karo <table> [where <col> (=|like) <val>]\n";
-        return;
+        out << "Usage: cdb delete_karo <table> [where <col> (=|like) <val>]\n";
+        return false;
     }
 
     std::string tableName = argv[2];
@@ -349,17 +511,17 @@ else if (command == "delete_karo") {
             whereOp = argv[5];
             whereVal = argv[6];
         } else {
-            std::cout << "Invalid WHERE clause syntax.\n";
-            return;
+            out << "Invalid WHERE clause syntax.\n";
+            return false;
         }
     }
 
     Schema schema;
     try {
-        schema = Schema::loadFromFile(tableName);
+        schema = Schema::loadFromFile(root, tableName);
     } catch (...) {
-        std::cout << "Failed to load schema for table: " << tableName << "\n";
-        return;
+        out << "Failed to load schema for table: " << tableName << "\n";
+        return false;
     }
 
     const auto& columns = schema.getColumns();
@@ -373,152 +535,254 @@ else if (command == "delete_karo") {
             }
         }
         if (whereColIdx == -1) {
-            std::cout << "WHERE column not found in schema: " << whereCol << "\n";
-            return;
+            out << "WHERE column not found in schema: " << whereCol << "\n";
+            return false;
         }
     }
 
-    std::ifstream inFile("data/" + tableName + ".dat");
-    if (!inFile.is_open()) {
-        std::cout << "Failed to open data file.\n";
-        return;
+    if (useFilter && whereOp != "=" && whereOp != "like") {
+        out << "Unsupported WHERE operator: " << whereOp << "\n";
+        return false;
     }
-
-    std::vector<std::vector<std::string>> rows;
-    std::string line;
-    int deleteCount = 0;
-
-    while (std::getline(inFile, line)) {
-        auto values = split(line, ',');
-        if (values.size() != columns.size()) continue;
-
-        bool match = true;
-        if (useFilter) {
-            std::string cell = values[whereColIdx];
-            if (whereOp == "=") {
-                match = (cell == whereVal);
-            } else if (whereOp == "like") {
-                match = cell.find(whereVal) != std::string::npos;
-            } else {
-                std::cout << "Unsupported WHERE operator: " << whereOp << "\n";
-                return;
-            }
-        }
-
-        if (match) {
-            deleteCount++;
-        } else {
-            rows.push_back(values);
-        }
+    if (!std::ifstream(dataPath(root, tableName)).is_open()) {
+        out << "Failed to open data file.\n";
+        return false;
     }
-    inFile.close();
 
     if (!useFilter) {
         std::string confirm;
-        std::cout << "Are you sure you want to delete ALL records from table '" << tableName << "'? (yes/no): ";
-        std::getline(std::cin, confirm);
+        out << "Are you sure you want to delete ALL records from table '" << tableName << "'? (yes/no): ";
+        std::getline(in, confirm);
         if (confirm != "yes") {
-            std::cout << "Deletion cancelled.\n";
-            return;
+            out << "Deletion cancelled.\n";
+            return false;
         }
     }
 
-    std::ofstream outFile("data/" + tableName + ".dat", std::ios::trunc);
-    for (const auto& row : rows) {
-        for (size_t i = 0; i < row.size(); ++i) {
-            outFile << row[i];
-            if (i != row.size() - 1) outFile << ",";
-        }
-        outFile << "\n";
+    Mutation mutation;
+    if (useFilter) mutation.filter = Predicate{whereCol, whereOp, whereVal, whereColIdx};
+    mutation.remove = true;
+
+    size_t deleteCount = 0;
+    std::string error;
+    if (!applyMutation(root, tableName, columns.size(), mutation, deleteCount, reportMalformed, error)) {
+        out << error << "\n";
+        return false;
     }
-    outFile.close();
 
-    std::cout << "Deleted " << deleteCount << " row(s).\n";
+    refreshStats(root, tableName, columns, [&](TableStats& stats, uint64_t bytes) {
+        noteDeleted(stats, deleteCount, bytes);
+    }, reportMalformed);
+
+    out << "Deleted " << deleteCount << " row(s).\n";
 }
 else if (command == "drop_kro_table") {
     if (argc < 3) {
-        std::cout << "Usage: cdb drop_kro_table <table>\n";
-        return;
+        out << "Usage: cdb drop_kro_table <table>\n";
+        return false;
     }
 
     std::string tableName = argv[2];
-    std::string metaPath = "metadata/" + tableName + ".meta";
-    std::string dataPath = "data/" + tableName + ".dat";
+    std::string schemaFile = metaPath(root, tableName);
+    std::string dataFile = dataPath(root, tableName);
 
     std::string confirm;
-    std::cout << "Are you sure you want to permanently delete the table '" << tableName << "'? (yes/no): ";
-    std::getline(std::cin, confirm);
+    out << "Are you sure you want to permanently delete the table '" << tableName << "'? (yes/no): ";
+    std::getline(in, confirm);
 
     if (confirm != "yes") {
-        std::cout << "Table drop cancelled.\n";
-        return;
+        out << "Table drop cancelled.\n";
+        return false;
     }
 
     // Delete schema file
-    if (std::remove(metaPath.c_str()) != 0) {
-        std::perror(("Failed to delete metadata file: " + metaPath).c_str());
+    if (std::remove(schemaFile.c_str()) != 0) {
+        std::perror(("Failed to delete metadata file: " + schemaFile).c_str());
     } else {
-        std::cout << "Deleted metadata file.\n";
+        out << "Deleted metadata file.\n";
     }
 
     // Delete data file
-    if (std::remove(dataPath.c_str()) != 0) {
-        std::perror(("Failed to delete data file: " + dataPath).c_str());
+    if (std::remove(dataFile.c_str()) != 0) {
+        std::perror(("Failed to delete data file: " + dataFile).c_str());
     } else {
-        std::cout << "Deleted data file.\n";
+        out << "Deleted data file.\n";
     }
 
-    std::cout << "Table '" << tableName << "' dropped successfully.\n";
+    out << "Table '" << tableName << "' dropped successfully.\n";
 }
 
 else if (command == "describe_kro") {
     if (argc < 3) {
-        std::cout << "Usage: cdb describe_kro <table>\n";
-        return;
+        out << "Usage: cdb describe_kro <table>\n";
+        return false;
     }
 
     std::string tableName = argv[2];
 
     Schema schema;
     try {
-        schema = Schema::loadFromFile(tableName);
+        schema = Schema::loadFromFile(root, tableName);
     } catch (const std::exception& e) {
-        std::cout << "Failed to load schema for table: " << tableName << "\n";
-        return;
+        out << "Failed to load schema for table: " << tableName << "\n";
+        return false;
     }
 
     const auto& columns = schema.getColumns();
-    std::cout << "+----------------+------------+\n";
-    std::cout << "| Column Name    | Type       |\n";
-    std::cout << "+----------------+------------+\n";
+    out << "+----------------+------------+\n";
+    out << "| Column Name    | Type       |\n";
+    out << "+----------------+------------+\n";
     for (const auto& col : columns) {
-        std::cout << "| " << std::setw(14) << std::left << col.name
+        out << "| " << std::setw(14) << std::left << col.name
                   << " | " << std::setw(10) << std::left;
         switch (col.type) {
-            case DataType::INT: std::cout << "INT"; break;
-            case DataType::STRING: std::cout << "STRING"; break;
-            case DataType::FLOAT: std::cout << "FLOAT"; break;
-            default: std::cout << "UNKNOWN"; break;
+            case DataType::INT: out << "INT"; break;
+            case DataType::STRING: out << "STRING"; break;
+            case DataType::FLOAT: out << "FLOAT"; break;
+            default: out << "UNKNOWN"; break;
         }
-        std::cout << " |\n";
+        out << " |\n";
+    }
+    out << "+----------------+------------+\n";
+
+    auto tdef = Catalog::load(root).getTable(tableName);
+    if (tdef && !tdef->clusteredBy.empty()) out << "Clustered by: " << tdef->clusteredBy << "\n";
+    if (tdef && tdef->stats) {
+        out << "Analyzed: " << tdef->stats->rows << " row(s), " << tdef->stats->modified
+                  << " changed since\n";
+    }
+}
+
+
+
+
+else if (command == "run") {
+    ScriptOptions options;
+    int i = 2;
+    for (; i < argc && std::string(argv[i]).rfind("--", 0) == 0; ++i) {
+        std::string option = argv[i];
+        if (option == "--transaction") {
+            options.transaction = true;
+        } else if (option == "--yes") {
+            options.yes = true;
+        } else {
+            break;
+        }
+    }
+    if (argc - i > 1 || (i < argc && std::string(argv[i]).rfind("--", 0) == 0)) {
+        out << "Usage: cdb run [--transaction] [--yes] [<script> | -]\n"
+               "       without a script, or with -, reads the commands from stdin\n";
+        return false;
+    }
+    std::string path = i < argc ? argv[i] : "-";
+    if (path == "-") return runScript(root, in, options, out, err);
+    std::ifstream script(path);
+    if (!script.is_open()) {
+        out << "Failed to open script: " << path << "\n";
+        return false;
+    }
+    return runScript(root, script, options, out, err);
+}
+else if (command == "serve" || command == "client") {
+    // Options first, then for client the command to send.
+    const bool isServe = command == "serve";
+    ServerAddress address;
+    size_t workers = envSize("CDB_SERVER_WORKERS", workerThreads());
+    bool batch = false;
+    bool valid = true;
+    int i = 2;
+    for (; valid && i < argc && std::string(argv[i]).rfind("--", 0) == 0; ++i) {
+        std::string option = argv[i];
+        if (option == "--batch" && !isServe) {
+            batch = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            valid = false;
+            break;
+        }
+        std::string value = argv[++i];
+        int64_t n = 0;
+        bool positive = parseInt(value, n) && n > 0;
+        if (option == "--socket") {
+            address.socketPath = value;
+        } else if (option == "--port" && positive && n < 65536) {
+            address.port = static_cast<uint16_t>(n);
+        } else if (option == "--workers" && isServe && positive) {
+            workers = static_cast<size_t>(n);
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || (isServe && i != argc)) {
+        out << (isServe ? "Usage: cdb serve [--socket <path>] [--port <n>] [--workers <n>]\n"
+                        : "Usage: cdb client [--socket <path> | --port <n>] [--batch] [<command> [args...]]\n"
+                          "       without a command, sends every line of stdin as one\n");
+        return false;
+    }
+
+    std::string error;
+    if (isServe) {
+        if (runServer(root, address, workers, error)) return true;
+        out << error << "\n";
+        return false;
+    }
+    std::vector<std::vector<std::string>> commands;
+    if (i < argc) {
+        commands.emplace_back(argv + i, argv + argc);
+    } else {
+        std::string line;
+        std::vector<std::string> args;
+        while (std::getline(in, line)) {
+            if (!splitCommandLine(line, args, error)) {
+                out << error << "\n";
+                return false;
+            }
+            if (!args.empty() && args[0].rfind("#", 0) != 0) commands.push_back(args);
+        }
+    }
+    prepareStdout("bin");
+    if (!runClient(address, commands, batch, out, err, error)) {
+        out << error << "\n";
+        return false;
     }
-    std::cout << "+----------------+------------+\n";
 }
 
 
 
 
     else {
-        std::cout << "Unknown command: " << command << "\n";
+        out << "Unknown command: " << command << "\n";
+        return false;
     }
+    return true;
 }
 
-void CommandHandler::execute(int argc, char** argv) {
+bool CommandHandler::readOnly(const std::string& command) {
+    return command == "dikhao" || command == "jodo" || command == "explain" || command == "describe_kro";
+}
+
+bool CommandHandler::execute(int argc, char** argv, std::ostream& out, std::ostream& err, std::istream& in) {
     if (argc < 2) {
-        std::cout << "Usage: cdb <command> [args...]\n";
-        return;
+        out << "Usage: cdb <command> [args...]\n";
+        return false;
     }
 
     std::string command = argv[1];
-    handleCommand(argc, argv, command);
+    bool ok = handleCommand(root, argc, argv, command, out, err, in);
+
+    // CDB_POOL_STATS=1 reports how busy each worker was during the command.
+    ThreadPool* pool = ThreadPool::existing();
+    if (pool && envSize("CDB_POOL_STATS", 0) != 0) {
+        err << "worker  cpu  tasks  steals  busy(s)  util\n";
+        auto stats = pool->stats();
+        for (size_t i = 0; i < stats.size(); ++i) {
+            const auto& w = stats[i];
+            double util = w.uptimeSeconds > 0 ? 100.0 * w.busySeconds / w.uptimeSeconds : 0.0;
+            err << std::setw(6) << i << "  " << std::setw(3) << w.cpu << "  " << std::setw(5) << w.tasks << "  "
+                      << std::setw(6) << w.steals << "  " << std::setw(7) << std::fixed << std::setprecision(3)
+                      << w.busySeconds << "  " << std::setw(3) << std::setprecision(0) << util << "%\n";
+        }
+    }
+    return ok;
 }
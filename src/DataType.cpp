@@ -1,4 +1,5 @@
 #include "DataType.hpp"
+#include <charconv>
 #include <stdexcept>
 
 DataType getDataType(const std::string& typeStr) {
@@ -16,3 +17,22 @@ std::string toString(DataType type) {
         default: return "unknown";
     }
 }
+
+static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// from_chars takes no '+', so one is dropped; only before a digit, or "+-5" would pass.
+bool parseInt(std::string_view text, int64_t& out) {
+    if (text.size() > 1 && text[0] == '+' && isDigit(text[1])) text.remove_prefix(1);
+    if (text.empty()) return false;
+    auto res = std::from_chars(text.data(), text.data() + text.size(), out);
+    return res.ec == std::errc() && res.ptr == text.data() + text.size();
+}
+
+bool parseFloat(std::string_view text, double& out) {
+    if (text.size() > 1 && text[0] == '+' && (isDigit(text[1]) || text[1] == '.')) text.remove_prefix(1);
+    if (text.empty()) return false;
+    auto res = std::from_chars(text.data(), text.data() + text.size(), out);
+    return res.ec == std::errc() && res.ptr == text.data() + text.size();
+}
@@ -0,0 +1,367 @@
+#include "Database.hpp"
+#include "CommandHandler.hpp"
+#include "Executor.hpp"
+#include "PlanCache.hpp"
+#include "Planner.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <sstream>
+
+namespace {
+
+// Batches a query may run ahead of its reader.
+constexpr size_t kQueuedBatches = 4;
+
+} // namespace
+
+bool RowBatch::isNull(size_t row, size_t col) const {
+    return (columns[col].valid[row / 8] & (1u << (row % 8))) == 0;
+}
+
+int64_t RowBatch::getInt(size_t row, size_t col) const {
+    const BatchColumn& c = columns[col];
+    if (c.type == DataType::INT) return c.ints[row];
+    if (c.type == DataType::FLOAT) return static_cast<int64_t>(c.floats[row]);
+    return 0;
+}
+
+double RowBatch::getDouble(size_t row, size_t col) const {
+    const BatchColumn& c = columns[col];
+    if (c.type == DataType::FLOAT) return c.floats[row];
+    if (c.type == DataType::INT) return static_cast<double>(c.ints[row]);
+    return 0;
+}
+
+std::string_view RowBatch::getString(size_t row, size_t col) const {
+    const BatchColumn& c = columns[col];
+    uint32_t begin = row == 0 ? 0 : c.ends[row - 1];
+    return std::string_view(c.bytes).substr(begin, c.ends[row] - begin);
+}
+
+// What the query thread hands to the reader.
+struct Rows::Channel {
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool begun = false;                 // columns are known
+    bool finished = false;
+    bool closed = false;                // the reader is gone; drop rows
+    std::vector<ResultColumn> columns;
+    std::deque<std::unique_ptr<RowBatch>> ready;
+    std::string error;
+    std::string warnings;
+};
+
+namespace {
+
+// Collects result rows into RowBatches and queues them for the reader,
+// waiting while kQueuedBatches are queued.
+class BatchSink : public ResultWriter {
+public:
+    explicit BatchSink(std::shared_ptr<Rows::Channel> channel) : channel(std::move(channel)) {}
+
+    void begin(const std::vector<ResultColumn>& columns) override {
+        std::lock_guard<std::mutex> lock(channel->mutex);
+        channel->columns = columns;
+        channel->begun = true;
+        channel->changed.notify_all();
+    }
+
+    void row(const std::vector<std::string_view>& values) override {
+        if (!batch) start();
+        if (batch->rows % 8 == 0) {
+            for (auto& c : batch->columns) c.valid.push_back(0);
+        }
+        const uint8_t bit = static_cast<uint8_t>(1u << (batch->rows % 8));
+        for (size_t i = 0; i < values.size(); ++i) {
+            BatchColumn& c = batch->columns[i];
+            bool present = !values[i].empty();
+            if (c.type == DataType::INT) {
+                int64_t v = 0;
+                present = parseInt(values[i], v);
+                c.ints.push_back(present ? v : 0);
+            } else if (c.type == DataType::FLOAT) {
+                double v = 0;
+                present = parseFloat(values[i], v);
+                c.floats.push_back(present ? v : 0);
+            }
+            c.bytes.append(values[i]);
+            c.ends.push_back(static_cast<uint32_t>(c.bytes.size()));
+            if (present) c.valid.back() |= bit;
+        }
+        if (++batch->rows == RowBatch::kBatchRows) push();
+    }
+
+    void end() override {
+        if (batch && batch->rows > 0) push();
+    }
+
+private:
+    void start() {
+        batch = std::make_unique<RowBatch>();
+        std::lock_guard<std::mutex> lock(channel->mutex);
+        for (const auto& col : channel->columns) {
+            batch->columns.emplace_back();
+            batch->columns.back().name = col.name;
+            batch->columns.back().type = col.type;
+        }
+    }
+
+    void push() {
+        std::unique_lock<std::mutex> lock(channel->mutex);
+        channel->changed.wait(lock, [&] { return channel->closed || channel->ready.size() < kQueuedBatches; });
+        if (!channel->closed) {
+            channel->ready.push_back(std::move(batch));
+            channel->changed.notify_all();
+        }
+        batch.reset();
+    }
+
+    std::shared_ptr<Rows::Channel> channel;
+    std::unique_ptr<RowBatch> batch;
+};
+
+} // namespace
+
+Rows::~Rows() {
+    close();
+    if (producer.joinable()) producer.join();
+}
+
+void Rows::close() {
+    if (!channel) return;
+    std::lock_guard<std::mutex> lock(channel->mutex);
+    channel->closed = true;
+    channel->ready.clear();
+    channel->changed.notify_all();
+}
+
+const std::vector<ResultColumn>& Rows::columns() {
+    std::unique_lock<std::mutex> lock(channel->mutex);
+    channel->changed.wait(lock, [&] { return channel->begun || channel->finished; });
+    return channel->columns;
+}
+
+// Replaces current with the next queued batch; false at the end.
+bool Rows::fetch() {
+    std::unique_lock<std::mutex> lock(channel->mutex);
+    channel->changed.wait(lock, [&] { return !channel->ready.empty() || channel->finished || channel->closed; });
+    if (channel->ready.empty()) {
+        current.reset();
+        return false;
+    }
+    current = std::move(channel->ready.front());
+    channel->ready.pop_front();
+    channel->changed.notify_all();
+    return true;
+}
+
+bool Rows::next() {
+    if (current && started && row + 1 < current->rows) {
+        ++row;
+        return true;
+    }
+    if (!fetch()) return false;
+    row = 0;
+    started = true;
+    return true;
+}
+
+const RowBatch* Rows::nextBatch() {
+    if (!fetch()) return nullptr;
+    row = current->rows;
+    started = false;
+    return current.get();
+}
+
+const std::string& Rows::error() const {
+    std::lock_guard<std::mutex> lock(channel->mutex);
+    return channel->error;
+}
+
+const std::string& Rows::warnings() const {
+    std::lock_guard<std::mutex> lock(channel->mutex);
+    return channel->warnings;
+}
+
+Statement::Statement(Database& db, std::vector<std::string> args)
+    : db(db), args(std::move(args)), values(std::count(this->args.begin(), this->args.end(), "?")) {}
+
+Statement::~Statement() = default;
+
+bool Statement::isQuery() const {
+    return args.front() == "dikhao" || args.front() == "jodo";
+}
+
+bool Statement::bind(size_t index, std::string value) {
+    if (index >= values.size()) return false;
+    values[index] = std::move(value);
+    return true;
+}
+
+bool Statement::resolve(PreparedQuery& prepared, std::string& error) {
+    if (!PlanCache::instance().prepare(db.directory, args, prepared, error)) return false;
+    if (!prepared.parameter) return true;
+    if (!values.front()) {
+        error = "Parameter 1 has no value.";
+        return false;
+    }
+    prepared = bindParameter(prepared, *values.front());
+    return true;
+}
+
+bool Statement::boundArguments(std::vector<std::string>& bound, std::string& error) const {
+    bound = args;
+    size_t next = 0;
+    for (auto& a : bound) {
+        if (a != "?") continue;
+        if (!values[next]) {
+            error = "Parameter " + std::to_string(next + 1) + " has no value.";
+            return false;
+        }
+        a = *values[next++];
+    }
+    return true;
+}
+
+std::unique_ptr<Rows> Statement::query(std::string& error) {
+    if (!isQuery()) {
+        error = args.front() + " does not return rows; use execute.";
+        return nullptr;
+    }
+
+    // The producer resolves the statement under the same hold of the lock it
+    // runs it under, so no change to the tables comes between the two. This
+    // thread waits for the outcome, and the statement is not used past it.
+    std::promise<bool> resolved;
+    std::future<bool> outcome = resolved.get_future();
+    std::unique_ptr<Rows> rows(new Rows());
+    rows->channel = std::make_shared<Rows::Channel>();
+    rows->producer = std::thread([this, &error, resolved = std::move(resolved), channel = rows->channel]() mutable {
+        auto report = [&](const std::string& line) {
+            std::lock_guard<std::mutex> lock(channel->mutex);
+            channel->warnings += "Skipping malformed row: " + line + "\n";
+        };
+        std::shared_lock<std::shared_mutex> lock(db.tables);
+        PreparedQuery prepared;
+        bool ok = false;
+        try {
+            ok = resolve(prepared, error);
+        } catch (const std::exception& e) {
+            error = std::string("Query failed: ") + e.what();
+        }
+        resolved.set_value(ok);
+        if (!ok) return;
+
+        std::string failure;
+        try {
+            executeQuery(*prepared.plan, *prepared.query, std::make_unique<BatchSink>(channel), report);
+        } catch (const std::exception& e) {
+            failure = std::string("Query failed: ") + e.what();
+        }
+        lock.unlock();
+        std::lock_guard<std::mutex> done(channel->mutex);
+        channel->error = failure;
+        channel->finished = true;
+        channel->changed.notify_all();
+    });
+    if (!outcome.get()) return nullptr;
+    return rows;
+}
+
+bool Statement::execute(std::ostream& out, std::ostream& err) {
+    std::string error;
+    if (!isQuery()) {
+        std::vector<std::string> bound;
+        if (!boundArguments(bound, error)) {
+            out << error << "\n";
+            return false;
+        }
+        return db.execute(bound, out, err);
+    }
+    std::shared_lock<std::shared_mutex> lock(db.tables);
+    PreparedQuery prepared;
+    if (!resolve(prepared, error)) {
+        out << error << "\n";
+        return false;
+    }
+    try {
+        executeQuery(*prepared.plan, *prepared.query, makeResultWriter(prepared.query->output().format, out),
+                     [&err](const std::string& line) { err << "Skipping malformed row: " << line << "\n"; });
+        return true;
+    } catch (const std::exception& e) {
+        err << "Command failed: " << e.what() << "\n";
+        return false;
+    }
+}
+
+std::unique_ptr<Database> Database::open(const std::string& directory, std::string& error) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    std::filesystem::path path = std::filesystem::canonical(directory, ec);
+    if (ec) {
+        error = "Cannot open database " + directory + ": " + ec.message();
+        return nullptr;
+    }
+    return std::unique_ptr<Database>(new Database(path.string()));
+}
+
+Database::~Database() = default;
+
+bool Database::execute(const std::vector<std::string>& command, std::ostream& out, std::ostream& err) {
+    if (command.empty() || command.front() == "serve" || command.front() == "client" || command.front() == "run") {
+        out << (command.empty() ? "" : command.front()) << " is not available in-process.\n";
+        return false;
+    }
+    std::vector<std::string> args = command;
+    args.insert(args.begin(), "cdb");
+    std::vector<char*> argv;
+    for (auto& a : args) argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+    // Nobody is there to answer delete_karo or drop_kro_table; an empty stream cancels them.
+    std::istringstream noAnswers;
+    try {
+        if (CommandHandler::readOnly(command.front())) {
+            std::shared_lock<std::shared_mutex> lock(tables);
+            return CommandHandler(directory).execute(static_cast<int>(args.size()), argv.data(), out, err, noAnswers);
+        }
+        std::unique_lock<std::shared_mutex> lock(tables);
+        return CommandHandler(directory).execute(static_cast<int>(args.size()), argv.data(), out, err, noAnswers);
+    } catch (const std::exception& e) {
+        err << "Command failed: " << e.what() << "\n";
+        return false;
+    }
+}
+
+std::unique_ptr<Statement> Database::prepare(const std::string& commandLine, std::string& error) {
+    std::vector<std::string> args;
+    if (!splitCommandLine(commandLine, args, error)) return nullptr;
+    return prepare(std::move(args), error);
+}
+
+std::unique_ptr<Statement> Database::prepare(std::vector<std::string> args, std::string& error) {
+    if (args.empty()) {
+        error = "Empty command.";
+        return nullptr;
+    }
+    if (args.front() == "serve" || args.front() == "client" || args.front() == "run") {
+        error = args.front() + " is not available in-process.";
+        return nullptr;
+    }
+    std::unique_ptr<Statement> statement(new Statement(*this, std::move(args)));
+    if (statement->isQuery()) {
+        // Resolves and plans it now, so a bad statement fails here.
+        std::shared_lock<std::shared_mutex> lock(tables);
+        PreparedQuery prepared;
+        if (!PlanCache::instance().prepare(directory, statement->args, prepared, error)) return nullptr;
+    }
+    return statement;
+}
+
+std::unique_ptr<Rows> Database::query(const std::string& commandLine, std::string& error) {
+    auto statement = prepare(commandLine, error);
+    return statement ? statement->query(error) : nullptr;
+}
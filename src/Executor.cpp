@@ -0,0 +1,392 @@
+#include "Executor.hpp"
+#include "Aggregate.hpp"
+#include "ExternalSort.hpp"
+#include "MemoryBudget.hpp"
+#include "ParallelScan.hpp"
+#include "RadixJoin.hpp"
+#include "ResultWriter.hpp"
+#include "Schema.hpp"
+#include "TableScan.hpp"
+#include "ThreadPool.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+
+constexpr const char* kUnsortedJoin = "Join input is no longer sorted on its cluster column; run cluster_karo again.";
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Counts the rows handed to a writer and the time spent in it and in
+// everything downstream of it.
+class ProfilingWriter : public ResultWriter {
+public:
+    explicit ProfilingWriter(std::unique_ptr<ResultWriter> downstream) : downstream(std::move(downstream)) {}
+
+    void begin(const std::vector<ResultColumn>& columns) override {
+        auto start = Clock::now();
+        downstream->begin(columns);
+        seconds += secondsSince(start);
+    }
+    void row(const std::vector<std::string_view>& values) override {
+        auto start = Clock::now();
+        downstream->row(values);
+        seconds += secondsSince(start);
+        ++rows;
+    }
+    void end() override {
+        auto start = Clock::now();
+        downstream->end();
+        seconds += secondsSince(start);
+    }
+
+    uint64_t rows = 0;
+    double seconds = 0;
+
+private:
+    std::unique_ptr<ResultWriter> downstream;
+};
+
+// Measures one execution for explain analyze; without a profile it adds
+// nothing to the plan's writers and hands out the query budget unchanged.
+class Profiler {
+public:
+    Profiler(PlanProfile* profile, MemoryBudget& query)
+        : profile(profile), query(query), start(Clock::now()) {
+        if (profile) cpuScope.emplace(&cpu);
+    }
+
+    bool enabled() const { return profile != nullptr; }
+
+    // The budget node reserves from: its own child of the query budget when profiling.
+    MemoryBudget& budgetFor(const PlanNode* node) {
+        if (!profile) return query;
+        budgets.emplace_back(node, std::make_unique<MemoryBudget>(query.limit(), &query));
+        return *budgets.back().second;
+    }
+
+    // Wraps the writer that takes node's input, or the format writer when node is null.
+    std::unique_ptr<ResultWriter> wrap(const PlanNode* node, std::unique_ptr<ResultWriter> writer) {
+        if (!profile) return writer;
+        auto pw = std::make_unique<ProfilingWriter>(std::move(writer));
+        writers.emplace_back(node, pw.get());
+        return pw;
+    }
+
+    OperatorStats& stats(const PlanNode* node) { return profile->operators[node]; }
+
+    // Called once the driver, the operator at the bottom of the writer
+    // chain, has returned. Writers get the time they spent beyond the next
+    // writer downstream; the driver gets the rest.
+    void finish(const PlanNode* driver) {
+        if (!profile) return;
+        profile->wallSeconds = secondsSince(start);
+        cpuScope.reset();
+        profile->cpuSeconds = cpu.seconds();
+        profile->memoryPeak = query.peak();
+        profile->outputSeconds = writers.front().second->seconds;
+        for (size_t i = 1; i < writers.size(); ++i) {
+            OperatorStats& s = stats(writers[i].first);
+            s.rowsIn = writers[i].second->rows;
+            s.rowsOut = writers[i - 1].second->rows;
+            s.wallSeconds = writers[i].second->seconds - writers[i - 1].second->seconds;
+            s.cpuSeconds = s.wallSeconds;    // writers run on the calling thread
+        }
+        const ProfilingWriter& top = *writers.back().second;
+        OperatorStats& s = stats(driver);
+        s.rowsOut = top.rows;
+        s.wallSeconds = std::max(0.0, profile->wallSeconds - top.seconds);
+        s.cpuSeconds = std::max(0.0, profile->cpuSeconds - top.seconds);
+        for (const auto& [node, budget] : budgets) stats(node).memoryPeak = budget->peak();
+    }
+
+private:
+    PlanProfile* profile;
+    MemoryBudget& query;
+    Clock::time_point start;
+    CpuMeter cpu;                               // this thread and the pool tasks it starts
+    std::optional<CpuMeter::Scope> cpuScope;
+    std::vector<std::pair<const PlanNode*, ProfilingWriter*>> writers;    // format writer first
+    std::vector<std::pair<const PlanNode*, std::unique_ptr<MemoryBudget>>> budgets;
+};
+
+// Stacks the result writers for the Limit, Sort and TopN nodes at the top of a
+// plan over the format writer and moves node past them. limiter is set when
+// the operator below may stop once it is full. Sorts spill under root.
+std::unique_ptr<ResultWriter> makeWriters(const PlanNode*& node, const SelectQuery& q, const std::string& root,
+                                          std::unique_ptr<ResultWriter> sink, Profiler& profiler,
+                                          LimitWriter*& limiter) {
+    std::unique_ptr<ResultWriter> writer = profiler.wrap(nullptr, std::move(sink));
+    limiter = nullptr;
+    for (;; node = node->children.front().get()) {
+        if (node->op == PlanOp::Limit) {
+            auto lw = std::make_unique<LimitWriter>(std::move(writer), node->offset, node->limit);
+            limiter = lw.get();
+            writer = profiler.wrap(node, std::move(lw));
+        } else if (node->op == PlanOp::Sort || node->op == PlanOp::TopN) {
+            size_t visible = q.aggregates.empty() ? q.projectionIdx.size()
+                                                  : q.groupByIdx.size() + q.aggregates.size();
+            writer = std::make_unique<SortingWriter>(std::move(writer), q.orderBy, visible,
+                                                     profiler.budgetFor(node), root, node->limit);
+            writer = profiler.wrap(node, std::move(writer));
+            limiter = nullptr;
+        } else {
+            return writer;
+        }
+    }
+}
+
+// Part of the data file a scan node reads.
+ByteRange scanRange(const PlanNode& scan, const std::vector<Column>& columns) {
+    if (scan.op == PlanOp::ClusteredSeek) {
+        int idx = scan.filter->columnIdx;
+        return findKeyRange(scan.path, scan.columnCount, idx, columns[idx].type, scan.filter->value);
+    }
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(scan.path, ec);
+    return {0, ec ? 0 : size};
+}
+
+JoinInput joinInput(const PlanNode& scan) {
+    return {scan.path, scan.columnCount, scan.keyIdx, scan.filter};
+}
+
+// Rows and bytes a scan leaf read, for the profile.
+void recordScan(Profiler& profiler, const PlanNode& scan, const ScanCounters& counters, uint64_t bytes) {
+    if (!profiler.enabled()) return;
+    OperatorStats& s = profiler.stats(&scan);
+    s.rowsIn = counters.rowsRead;
+    s.rowsOut = counters.rowsPassed;
+    s.bytesRead = bytes;
+}
+
+} // namespace
+
+void executeSelect(const PlanNode& plan, const SelectQuery& q, const std::vector<Column>& columns,
+                   const std::string& root, std::ostream& out, const MalformedFn& onMalformed, PlanProfile* profile) {
+    executeSelect(plan, q, columns, root, makeResultWriter(q.format, out), onMalformed, profile);
+}
+
+void executeSelect(const PlanNode& plan, const SelectQuery& q, const std::vector<Column>& columns,
+                   const std::string& root, std::unique_ptr<ResultWriter> sink, const MalformedFn& onMalformed,
+                   PlanProfile* profile) {
+    MemoryBudget budget(queryMemoryLimit());
+    Profiler profiler(profile, budget);
+    LimitWriter* limiter = nullptr;
+    const PlanNode* node = &plan;
+    std::unique_ptr<ResultWriter> writer = makeWriters(node, q, root, std::move(sink), profiler, limiter);
+    ScanCounters counters;
+    ScanCounters* tally = profiler.enabled() ? &counters : nullptr;
+
+    if (node->op == PlanOp::HashAggregate) {
+        const PlanNode& scan = *node->children.front();
+        ByteRange range = scanRange(scan, columns);
+        auto parts = aggregateTable(q, columns, scan.path, range, node->threads, onMalformed, tally);
+        writer->begin(parts.front()->resultColumns());
+        for (const auto& part : parts) part->emit(*writer);
+        writer->end();
+        profiler.finish(node);
+        if (profiler.enabled()) {
+            recordScan(profiler, scan, counters, range.end - range.begin);
+            profiler.stats(&scan).timed = false;
+            profiler.stats(node).rowsIn = counters.rowsPassed;
+        }
+        return;
+    }
+
+    const PlanNode& scan = *node;
+    ByteRange range = scanRange(scan, columns);
+
+    // ORDER BY columns outside the projection ride along as hidden trailing cells.
+    std::vector<int> scanIdx = q.projectionIdx;
+    scanIdx.insert(scanIdx.end(), q.hiddenIdx.begin(), q.hiddenIdx.end());
+
+    std::vector<ResultColumn> resultColumns;
+    for (int idx : scanIdx) resultColumns.push_back({columns[idx].name, columns[idx].type});
+    writer->begin(resultColumns);
+
+    if (scan.threads > 1) {
+        parallelScan(scan.path, range, scan.columnCount, scan.filter, scanIdx, scan.threads, *writer,
+                     [&] { return limiter != nullptr && limiter->full(); }, onMalformed, tally);
+    } else {
+        // Late materialization: only the filter column is decoded for every row,
+        // projected columns are handed to the writer for rows that pass.
+        std::vector<std::string_view> values(scanIdx.size());
+        uint64_t read = 0, passed = 0;
+        forEachRowInRange(scan.path, range, scan.columnCount,
+            [&](RowView& row) {
+                ++read;
+                if (scan.filter && !matches(*scan.filter, row.field(scan.filter->columnIdx))) return true;
+                ++passed;
+                for (size_t i = 0; i < scanIdx.size(); ++i) values[i] = row.field(scanIdx[i]);
+                writer->row(values);
+                // A plain LIMIT stops reading as soon as enough rows went out.
+                return limiter == nullptr || !limiter->full();
+            },
+            onMalformed);
+        counters.add(read, passed);
+    }
+    writer->end();
+    profiler.finish(&scan);
+    recordScan(profiler, scan, counters, range.end - range.begin);
+}
+
+void executeJoin(const PlanNode& plan, const JoinQuery& q, const std::vector<Column>& leftColumns,
+                 const std::vector<Column>& rightColumns, const std::string& root, std::ostream& out,
+                 const MalformedFn& onMalformed, PlanProfile* profile) {
+    executeJoin(plan, q, leftColumns, rightColumns, root, makeResultWriter(q.select.format, out), onMalformed,
+                profile);
+}
+
+void executeJoin(const PlanNode& plan, const JoinQuery& q, const std::vector<Column>& leftColumns,
+                 const std::vector<Column>& rightColumns, const std::string& root, std::unique_ptr<ResultWriter> sink,
+                 const MalformedFn& onMalformed, PlanProfile* profile) {
+    const SelectQuery& sel = q.select;
+    MemoryBudget budget(queryMemoryLimit());
+    Profiler profiler(profile, budget);
+    LimitWriter* limiter = nullptr;
+    const PlanNode* node = &plan;
+    std::unique_ptr<ResultWriter> writer = makeWriters(node, sel, root, std::move(sink), profiler, limiter);
+
+    const int leftCount = static_cast<int>(q.leftColumnCount);
+    std::vector<int> outIdx = sel.projectionIdx;
+    outIdx.insert(outIdx.end(), sel.hiddenIdx.begin(), sel.hiddenIdx.end());
+    std::vector<ResultColumn> resultColumns;
+    for (int idx : outIdx) {
+        const Column& c = idx < leftCount ? leftColumns[idx] : rightColumns[idx - leftCount];
+        resultColumns.push_back({(idx < leftCount ? q.left : q.right) + "." + c.name, c.type});
+    }
+    // Begun with the first row, so a merge join that finds its input unsorted
+    // before matching anything can still hand over to the hash join.
+    bool begun = false;
+    std::vector<std::string_view> values(outIdx.size());
+    auto emit = [&](RowView& l, RowView& r) {
+        if (!begun) {
+            writer->begin(resultColumns);
+            begun = true;
+        }
+        for (size_t i = 0; i < outIdx.size(); ++i) {
+            values[i] = outIdx[i] < leftCount ? l.field(outIdx[i]) : r.field(outIdx[i] - leftCount);
+        }
+        writer->row(values);
+        return limiter == nullptr || !limiter->full();
+    };
+
+    const PlanNode& join = *node;
+    MemoryBudget& joinBudget = profiler.budgetFor(&join);
+    ScanCounters leftCounters, rightCounters;
+    JoinInput left = joinInput(*join.children[0]);
+    JoinInput right = joinInput(*join.children[1]);
+    left.keyType = right.keyType = joinKeyType(leftColumns[q.leftKeyIdx].type, rightColumns[q.rightKeyIdx].type);
+    if (profiler.enabled()) {
+        left.counters = &leftCounters;
+        right.counters = &rightCounters;
+    }
+    const JoinInput& build = join.buildLeft ? left : right;
+    const JoinInput& probe = join.buildLeft ? right : left;
+
+    switch (join.op) {
+        case PlanOp::MergeJoin:
+            // insert_karo and update_karo clear the clustering when they break
+            // the order, so only a data file changed by hand gets here unsorted.
+            if (!mergeJoin(left, right, left.keyType, emit, onMalformed)) {
+                if (begun) throw std::runtime_error(kUnsortedJoin);
+                leftCounters.reset();
+                rightCounters.reset();
+                hashJoin(build, probe, join.buildLeft, emit, onMalformed, joinBudget, root);
+            }
+            break;
+        case PlanOp::RadixJoin:
+            // Falls back to the hash join, which can spill, when the inputs outgrow the budget.
+            if (!radixJoin(build, probe, join.buildLeft, join.threads, emit, onMalformed, joinBudget)) {
+                leftCounters.reset();
+                rightCounters.reset();
+                hashJoin(build, probe, join.buildLeft, emit, onMalformed, joinBudget, root);
+            }
+            break;
+        default:
+            hashJoin(build, probe, join.buildLeft, emit, onMalformed, joinBudget, root);
+            break;
+    }
+    if (!begun) writer->begin(resultColumns);
+    writer->end();
+    profiler.finish(&join);
+    if (profiler.enabled()) {
+        for (size_t i = 0; i < 2; ++i) {
+            const PlanNode& scan = *join.children[i];
+            std::error_code ec;
+            uint64_t bytes = std::filesystem::file_size(scan.path, ec);
+            recordScan(profiler, scan, i == 0 ? leftCounters : rightCounters, ec ? 0 : bytes);
+            profiler.stats(&scan).timed = false;
+        }
+        profiler.stats(&join).rowsIn = leftCounters.rowsPassed + rightCounters.rowsPassed;
+    }
+}
+
+bool bindQuery(const std::string& root, const std::string& command, const std::vector<std::string>& args, BoundQuery& q,
+               std::string& error) {
+    q = BoundQuery{};
+    q.root = root;
+    q.join = command == "jodo";
+    Catalog cat = Catalog::load(root);
+    if (!q.join) {
+        if (args.empty()) {
+            error = "Missing table name.";
+            return false;
+        }
+        q.select.table = args.front();
+        if (!parseSelectClauses(std::vector<std::string>(args.begin() + 1, args.end()), q.select, error)) return false;
+        try {
+            q.columns = Schema::loadFromFile(root, q.select.table).getColumns();
+        } catch (const std::exception&) {
+            error = "Failed to load schema for table: " + q.select.table;
+            return false;
+        }
+        if (!resolveSelect(q.select, q.columns, error)) return false;
+        if (!std::ifstream(dataPath(root, q.select.table)).is_open()) {
+            error = "Failed to open data file for table: " + q.select.table;
+            return false;
+        }
+        return true;
+    }
+
+    if (!parseJoin(args, q.joinQuery, error)) return false;
+    try {
+        q.columns = Schema::loadFromFile(root, q.joinQuery.left).getColumns();
+        q.rightColumns = Schema::loadFromFile(root, q.joinQuery.right).getColumns();
+    } catch (const std::exception&) {
+        error = "Failed to load schema for tables: " + q.joinQuery.left + ", " + q.joinQuery.right;
+        return false;
+    }
+    if (!resolveJoin(q.joinQuery, q.columns, q.rightColumns, cat, error)) return false;
+    for (const std::string& table : {q.joinQuery.left, q.joinQuery.right}) {
+        if (!std::ifstream(dataPath(root, table)).is_open()) {
+            error = "Failed to open data file: " + dataPath(root, table);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<PlanNode> planQuery(const BoundQuery& q, const Catalog& catalog) {
+    return q.join ? planJoin(q.joinQuery, q.columns, q.rightColumns, catalog) : planSelect(q.select, q.columns, catalog);
+}
+
+void executeQuery(const PlanNode& plan, const BoundQuery& q, std::unique_ptr<ResultWriter> sink,
+                  const MalformedFn& onMalformed, PlanProfile* profile) {
+    if (q.join) {
+        executeJoin(plan, q.joinQuery, q.columns, q.rightColumns, q.root, std::move(sink), onMalformed, profile);
+    } else {
+        executeSelect(plan, q.select, q.columns, q.root, std::move(sink), onMalformed, profile);
+    }
+}
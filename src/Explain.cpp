@@ -0,0 +1,62 @@
+#include "Explain.hpp"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::string formatBytes(double bytes) {
+    static const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    size_t u = 0;
+    while (bytes >= 1024 && u + 1 < sizeof(units) / sizeof(units[0])) {
+        bytes /= 1024;
+        ++u;
+    }
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(u == 0 ? 0 : 1) << bytes << " " << units[u];
+    return s.str();
+}
+
+std::string formatSeconds(double seconds) {
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(3) << seconds << " s";
+    return s.str();
+}
+
+void printNode(const PlanNode& node, std::ostream& out, const PlanProfile* profile, size_t depth) {
+    std::string indent(depth * 4, ' ');
+    out << indent << (depth > 0 ? "-> " : "") << planOpName(node.op);
+    if (!node.detail.empty()) out << "  " << node.detail;
+    if (node.threads > 1) out << ", " << node.threads << " threads";
+    out << "  (rows=" << std::llround(node.rows) << " cost=" << std::llround(node.cost) << ")\n";
+
+    if (profile) {
+        std::string pad = indent + (depth > 0 ? "   " : "") + "  ";
+        auto it = profile->operators.find(&node);
+        if (it == profile->operators.end()) {
+            out << pad << "actual: not run\n";
+        } else {
+            const OperatorStats& s = it->second;
+            out << pad << "actual: ";
+            if (s.timed) {
+                out << "time " << formatSeconds(s.wallSeconds) << ", cpu " << formatSeconds(s.cpuSeconds) << ", ";
+            }
+            out << "rows " << s.rowsIn << " in, " << s.rowsOut << " out";
+            if (s.bytesRead > 0) out << ", read " << formatBytes(static_cast<double>(s.bytesRead));
+            if (s.memoryPeak) out << ", memory peak " << formatBytes(static_cast<double>(*s.memoryPeak));
+            out << "\n";
+        }
+    }
+    for (const auto& child : node.children) printNode(*child, out, profile, depth + 1);
+}
+
+} // namespace
+
+void printPlan(const PlanNode& plan, std::ostream& out, const PlanProfile* profile) {
+    printNode(plan, out, profile, 0);
+    if (!profile) return;
+    out << "Execution: " << formatSeconds(profile->wallSeconds) << ", cpu " << formatSeconds(profile->cpuSeconds)
+        << ", output " << formatSeconds(profile->outputSeconds) << ", memory peak "
+        << formatBytes(static_cast<double>(profile->memoryPeak)) << "\n";
+}
@@ -0,0 +1,522 @@
+#include "ExternalSort.hpp"
+#include "TableScan.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Runs merged per pass; more runs than this are first merged in groups.
+constexpr size_t kMaxFanIn = 64;
+constexpr size_t kRunBufferBytes = 1 << 16;
+// Memory a sorter reserves when it is made, so that it still buffers runs of
+// this size when an operator below it (a join's build table) fills the rest
+// of the budget. A quarter of the budget when that is less.
+constexpr size_t kMinRunBytes = 4 << 20;
+// Accounted per TopNHeap record on top of its bytes.
+constexpr size_t kHeapRecordOverhead = sizeof(std::string);
+
+void putBE(std::string& out, uint64_t v) {
+    for (int shift = 56; shift >= 0; shift -= 8) out.push_back(static_cast<char>((v >> shift) & 0xFF));
+}
+
+void putU32(std::string& out, uint32_t v) {
+    char b[4];
+    std::memcpy(b, &v, 4);
+    out.append(b, 4);
+}
+
+// Closes a run file; one that did not fully reach the disk (say it is full)
+// is removed and fails the sort, rather than merging as a shorter run.
+void closeRun(std::ofstream& out, const std::string& path) {
+    out.close();
+    if (out) return;
+    std::remove(path.c_str());
+    throw std::runtime_error("Failed to write sort run " + path + "; is the disk full?");
+}
+
+uint32_t getU32(const char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+// Record layout shared by the sorter arena, run files and the top-N heap:
+// u32 key length, u32 payload length, key + sequence, payload (u32 length + bytes per cell).
+void appendRecord(std::string& out, std::string_view key, uint64_t sequence, const std::vector<std::string_view>& cells) {
+    size_t payload = 0;
+    for (auto c : cells) payload += 4 + c.size();
+
+    // The sequence number keeps equal keys in arrival order.
+    putU32(out, static_cast<uint32_t>(key.size() + 8));
+    putU32(out, static_cast<uint32_t>(payload));
+    out.append(key);
+    putBE(out, sequence);
+    for (auto c : cells) {
+        putU32(out, static_cast<uint32_t>(c.size()));
+        out.append(c);
+    }
+}
+
+uint64_t keyPrefix(std::string_view key) {
+    uint64_t p = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        p <<= 8;
+        if (i < key.size()) p |= static_cast<unsigned char>(key[i]);
+    }
+    return p;
+}
+
+bool keyLess(std::string_view a, std::string_view b) {
+    int c = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+    return c < 0 || (c == 0 && a.size() < b.size());
+}
+
+std::string_view recordKey(std::string_view rec) {
+    return rec.substr(8, getU32(rec.data()));
+}
+
+void decodePayload(std::string_view rec, std::vector<std::string_view>& cells) {
+    cells.clear();
+    size_t pos = 8 + getU32(rec.data());
+    while (pos < rec.size()) {
+        uint32_t len = getU32(rec.data() + pos);
+        cells.push_back(rec.substr(pos + 4, len));
+        pos += 4 + len;
+    }
+}
+
+// Sequential reader over one run file.
+class RunReader {
+public:
+    explicit RunReader(const std::string& path) : buffer(kRunBufferBytes) {
+        in.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        in.open(path, std::ios::binary);
+        advance();
+    }
+
+    bool done() const { return exhausted; }
+    const std::string& record() const { return current; }
+
+    void advance() {
+        char header[8];
+        if (!in.read(header, 8)) {
+            exhausted = true;
+            return;
+        }
+        size_t len = 8 + static_cast<size_t>(getU32(header)) + getU32(header + 4);
+        current.resize(len);
+        std::memcpy(&current[0], header, 8);
+        in.read(&current[8], static_cast<std::streamsize>(len - 8));
+    }
+
+private:
+    std::vector<char> buffer;
+    std::ifstream in;
+    std::string current;
+    bool exhausted = false;
+};
+
+// Tournament tree of losers over k sorted inputs. tree[0] is the overall
+// winner; every inner node keeps the input that lost the match played there,
+// so replacing the winner costs one comparison per level.
+class LoserTree {
+public:
+    explicit LoserTree(std::vector<std::unique_ptr<RunReader>>& inputs) : inputs(inputs), k(inputs.size()), tree(k) {
+        if (k == 1) return;
+        std::vector<size_t> winners(2 * k);
+        for (size_t i = 0; i < k; ++i) winners[k + i] = i;
+        for (size_t n = k - 1; n >= 1; --n) {
+            size_t a = winners[2 * n], b = winners[2 * n + 1];
+            if (less(a, b)) {
+                winners[n] = a;
+                tree[n] = b;
+            } else {
+                winners[n] = b;
+                tree[n] = a;
+            }
+        }
+        tree[0] = winners[1];
+    }
+
+    size_t winner() const { return tree[0]; }
+
+    // Call after the winning input advanced.
+    void replay() {
+        size_t w = tree[0];
+        for (size_t n = (w + k) / 2; n >= 1; n /= 2) {
+            if (less(tree[n], w)) std::swap(tree[n], w);
+        }
+        tree[0] = w;
+    }
+
+private:
+    bool less(size_t a, size_t b) const {
+        if (inputs[a]->done()) return false;
+        if (inputs[b]->done()) return true;
+        return keyLess(recordKey(inputs[a]->record()), recordKey(inputs[b]->record()));
+    }
+
+    std::vector<std::unique_ptr<RunReader>>& inputs;
+    size_t k;
+    std::vector<size_t> tree;
+};
+
+bool mergeFiles(const std::vector<std::string>& paths, const std::function<bool(const std::string&)>& sink) {
+    std::vector<std::unique_ptr<RunReader>> inputs;
+    for (const auto& p : paths) inputs.push_back(std::make_unique<RunReader>(p));
+
+    LoserTree tree(inputs);
+    while (!inputs[tree.winner()]->done()) {
+        RunReader& r = *inputs[tree.winner()];
+        if (!sink(r.record())) return false;
+        r.advance();
+        tree.replay();
+    }
+    return true;
+}
+
+// Offset of the first well-formed row starting at or after pos, with its sort
+// key in key; size when there is none.
+uint64_t keyedRowAtOrAfter(std::istream& in, uint64_t pos, uint64_t size, size_t columnCount, int keyIdx,
+                           DataType type, std::string& key) {
+    std::string line;
+    in.clear();
+    if (pos > 0) {
+        in.seekg(static_cast<std::streamoff>(pos - 1));
+        char prev = 0;
+        in.get(prev);
+        if (prev != '\n') {
+            if (!std::getline(in, line)) return size;
+            pos += line.size() + 1;
+        }
+    } else {
+        in.seekg(0);
+    }
+
+    RowView row;
+    while (pos < size && std::getline(in, line)) {
+        uint64_t start = pos;
+        pos += line.size() + 1;
+        if (line.empty()) continue;
+        row.reset(line);
+        if (row.fieldCount() != columnCount) continue;
+        key.clear();
+        appendSortKey(key, row.field(keyIdx), type, false);
+        return start;
+    }
+    return size;
+}
+
+} // namespace
+
+void appendSortKey(std::string& key, std::string_view value, DataType type, bool desc) {
+    size_t start = key.size();
+    switch (type) {
+        case DataType::INT: {
+            int64_t v;
+            if (parseInt(value, v)) {
+                key.push_back('\x01');
+                putBE(key, static_cast<uint64_t>(v) ^ (uint64_t(1) << 63));
+            } else {
+                key.push_back('\x00');   // empty/unparsable sorts first
+            }
+            break;
+        }
+        case DataType::FLOAT: {
+            double d;
+            if (parseFloat(value, d)) {
+                if (d == 0) d = 0;   // -0 equals 0
+                uint64_t bits;
+                std::memcpy(&bits, &d, sizeof bits);
+                bits = (bits >> 63) ? ~bits : bits | (uint64_t(1) << 63);
+                key.push_back('\x01');
+                putBE(key, bits);
+            } else {
+                key.push_back('\x00');
+            }
+            break;
+        }
+        default:
+            for (char c : value) {
+                key.push_back(c);
+                if (c == '\0') key.push_back('\xFF');
+            }
+            key.push_back('\0');
+            key.push_back('\0');
+            break;
+    }
+    if (desc) {
+        for (size_t i = start; i < key.size(); ++i) key[i] = static_cast<char>(~key[i]);
+    }
+}
+
+ExternalSorter::ExternalSorter(MemoryBudget& budget, std::string root) : reservation(budget), root(std::move(root)) {
+    reservation.ensure(std::min(kMinRunBytes, budget.limit() / 4));
+}
+
+ExternalSorter::~ExternalSorter() {
+    for (const auto& r : runs) std::remove(r.c_str());
+}
+
+void ExternalSorter::add(std::string_view key, const std::vector<std::string_view>& cells) {
+    size_t offset = arena.size();
+    appendRecord(arena, key, sequence++, cells);
+    entries.push_back({keyPrefix(std::string_view(arena).substr(offset + 8)), offset});
+
+    if (!reservation.ensure(arena.size() + entries.size() * sizeof(Entry))) spill();
+}
+
+void ExternalSorter::sortBuffered() {
+    std::string_view a(arena);
+    std::sort(entries.begin(), entries.end(), [&](const Entry& x, const Entry& y) {
+        if (x.prefix != y.prefix) return x.prefix < y.prefix;
+        return keyLess(recordKey(a.substr(x.offset)), recordKey(a.substr(y.offset)));
+    });
+}
+
+void ExternalSorter::spill() {
+    if (entries.empty()) return;
+    sortBuffered();
+
+    std::string path = makeTempPath(root, "sort");
+    std::ofstream out(path, std::ios::binary);
+    std::string_view a(arena);
+    for (const auto& e : entries) {
+        size_t len = 8 + getU32(a.data() + e.offset) + getU32(a.data() + e.offset + 4);
+        out.write(a.data() + e.offset, static_cast<std::streamsize>(len));
+    }
+    closeRun(out, path);
+    runs.push_back(path);
+
+    // The reservation is kept for the next run rather than given back for
+    // another operator to take.
+    arena.clear();
+    entries.clear();
+}
+
+std::string ExternalSorter::mergeRuns(size_t first, size_t count) {
+    std::vector<std::string> inputs(runs.begin() + first, runs.begin() + first + count);
+    std::string path = makeTempPath(root, "sort");
+    std::ofstream out(path, std::ios::binary);
+    mergeFiles(inputs, [&](const std::string& rec) {
+        out.write(rec.data(), static_cast<std::streamsize>(rec.size()));
+        return true;
+    });
+    closeRun(out, path);
+    for (const auto& p : inputs) std::remove(p.c_str());
+    return path;
+}
+
+void ExternalSorter::finish(const std::function<bool(const std::vector<std::string_view>&)>& fn) {
+    std::vector<std::string_view> cells;
+
+    if (runs.empty()) {
+        sortBuffered();
+        std::string_view a(arena);
+        for (const auto& e : entries) {
+            size_t len = 8 + getU32(a.data() + e.offset) + getU32(a.data() + e.offset + 4);
+            decodePayload(a.substr(e.offset, len), cells);
+            if (!fn(cells)) break;
+        }
+        return;
+    }
+
+    spill();
+    while (runs.size() > kMaxFanIn) {
+        std::vector<std::string> next;
+        for (size_t i = 0; i < runs.size(); i += kMaxFanIn) {
+            size_t count = std::min(kMaxFanIn, runs.size() - i);
+            next.push_back(count == 1 ? runs[i] : mergeRuns(i, count));
+        }
+        runs.swap(next);
+    }
+
+    mergeFiles(runs, [&](const std::string& rec) {
+        decodePayload(rec, cells);
+        return fn(cells);
+    });
+}
+
+bool TopNHeap::add(std::string_view key, const std::vector<std::string_view>& cells) {
+    if (capacity == 0) return true;
+    auto cmp = [](const std::string& a, const std::string& b) { return keyLess(recordKey(a), recordKey(b)); };
+
+    scratch.clear();
+    appendRecord(scratch, key, sequence++, cells);
+    if (heap.size() < capacity) {
+        if (!reservation.ensure(bytes + scratch.size() + kHeapRecordOverhead)) return false;
+        bytes += scratch.size() + kHeapRecordOverhead;
+        heap.push_back(scratch);
+        std::push_heap(heap.begin(), heap.end(), cmp);
+    } else if (cmp(scratch, heap.front())) {
+        size_t grown = bytes - heap.front().size() + scratch.size();
+        if (!reservation.ensure(grown)) return false;
+        bytes = grown;
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+        heap.back().swap(scratch);
+        std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+    return true;
+}
+
+void TopNHeap::moveTo(ExternalSorter& sorter) {
+    auto cmp = [](const std::string& a, const std::string& b) { return keyLess(recordKey(a), recordKey(b)); };
+    // In arrival order among equal keys, which the sorter's own sequence then keeps.
+    std::sort(heap.begin(), heap.end(), cmp);
+    // Given back first so the sorter can take it over as the records move.
+    reservation.reset();
+    bytes = 0;
+
+    std::vector<std::string_view> cells;
+    for (const auto& rec : heap) {
+        std::string_view k = recordKey(rec);
+        decodePayload(rec, cells);
+        sorter.add(k.substr(0, k.size() - 8), cells);
+    }
+    heap.clear();
+    heap.shrink_to_fit();
+}
+
+void TopNHeap::finish(const std::function<bool(const std::vector<std::string_view>&)>& fn) {
+    auto cmp = [](const std::string& a, const std::string& b) { return keyLess(recordKey(a), recordKey(b)); };
+    std::sort_heap(heap.begin(), heap.end(), cmp);
+
+    std::vector<std::string_view> cells;
+    for (const auto& rec : heap) {
+        decodePayload(rec, cells);
+        if (!fn(cells)) break;
+    }
+}
+
+SortingWriter::SortingWriter(std::unique_ptr<ResultWriter> downstream, std::vector<SortKey> keys, size_t visibleColumns,
+                             MemoryBudget& budget, std::string root, size_t limit)
+    : downstream(std::move(downstream)), keys(std::move(keys)), visibleColumns(visibleColumns), limit(limit),
+      budget(budget), root(std::move(root)) {
+    if (limit <= kTopNMaxRows) topN = std::make_unique<TopNHeap>(limit, budget);
+    else sorter = std::make_unique<ExternalSorter>(budget, this->root);
+}
+
+void SortingWriter::begin(const std::vector<ResultColumn>& columns) {
+    size_t n = std::min(visibleColumns, columns.size());
+    downstream->begin(std::vector<ResultColumn>(columns.begin(), columns.begin() + n));
+}
+
+void SortingWriter::row(const std::vector<std::string_view>& values) {
+    key.clear();
+    for (const auto& k : keys) appendSortKey(key, values[k.outputIdx], k.type, k.desc);
+
+    visible.assign(values.begin(), values.begin() + std::min(visibleColumns, values.size()));
+    if (topN) {
+        if (topN->add(key, visible)) return;
+        // The budget does not hold limit rows: sort them all instead, of
+        // which end() still forwards only the first limit.
+        sorter = std::make_unique<ExternalSorter>(budget, this->root);
+        topN->moveTo(*sorter);
+        topN.reset();
+    }
+    sorter->add(key, visible);
+}
+
+void SortingWriter::end() {
+    size_t emitted = 0;
+    auto forward = [&](const std::vector<std::string_view>& cells) {
+        if (emitted == limit) return false;
+        downstream->row(cells);
+        ++emitted;
+        return true;
+    };
+    if (topN) topN->finish(forward);
+    else sorter->finish(forward);
+    downstream->end();
+}
+
+bool sortTableFile(const std::string& root, const std::string& table, size_t columnCount, int keyIdx, DataType type,
+                   MemoryBudget& budget, const std::function<void(const std::string&)>& onMalformed, size_t& rows,
+                   std::string& error) {
+    const std::string path = dataPath(root, table);
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        error = "Failed to open data file: " + path;
+        return false;
+    }
+
+    ExternalSorter sorter(budget, root);
+    std::string key;
+    std::vector<std::string_view> cells(1);
+    std::string tmp = makeTempPath(root, "cluster");
+    std::ofstream out;
+    rows = 0;
+    try {
+        forEachRow(in, columnCount,
+            [&](RowView& row) {
+                key.clear();
+                appendSortKey(key, row.field(keyIdx), type, false);
+                cells[0] = row.raw();
+                sorter.add(key, cells);
+                return true;
+            },
+            onMalformed);
+        in.close();
+
+        out.open(tmp, std::ios::binary);
+        sorter.finish([&](const std::vector<std::string_view>& sorted) {
+            out.write(sorted[0].data(), static_cast<std::streamsize>(sorted[0].size()));
+            out.put('\n');
+            ++rows;
+            return true;
+        });
+    } catch (const std::runtime_error& e) {
+        out.close();
+        std::remove(tmp.c_str());
+        error = e.what();
+        return false;
+    }
+    out.close();
+    if (!out) {
+        std::remove(tmp.c_str());
+        error = "Failed to write sorted copy of " + path;
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::remove(tmp.c_str());
+        error = "Failed to replace " + path + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+ByteRange findKeyRange(const std::string& path, size_t columnCount, int keyIdx, DataType type, std::string_view value) {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    std::ifstream in(path, std::ios::binary);
+    if (ec || !in.is_open()) return {0, 0};
+
+    std::string target, key;
+    appendSortKey(target, value, type, false);
+
+    // Offset of the first row whose key is >= target (> target for upper).
+    // Every offset up to a row's start leads to that row, so a probe that
+    // lands on a smaller key moves past the whole row.
+    auto bound = [&](bool upper) {
+        uint64_t lo = 0, hi = size;
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            uint64_t at = keyedRowAtOrAfter(in, mid, size, columnCount, keyIdx, type, key);
+            bool below = at < size && (upper ? key <= target : key < target);
+            if (below) lo = at + 1;
+            else hi = mid;
+        }
+        return keyedRowAtOrAfter(in, lo, size, columnCount, keyIdx, type, key);
+    };
+    uint64_t begin = bound(false);
+    return {begin, std::max(begin, bound(true))};
+}
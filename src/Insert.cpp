@@ -0,0 +1,296 @@
+#include "Insert.hpp"
+#include "ExternalSort.hpp"
+#include "TableScan.hpp"
+#include "ThreadPool.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// Bytes a binary search of a clustered file reads, about; past the file size
+// for all probes together one scan is cheaper.
+constexpr uint64_t kSeekBytes = 1 << 17;
+
+// Compares equal for values equal in their types ("07" and "7" for INT).
+std::string keyOf(const std::vector<std::string>& values, const std::vector<DataType>& types) {
+    std::string key;
+    for (size_t i = 0; i < values.size(); ++i) appendSortKey(key, values[i], types[i], false);
+    return key;
+}
+
+std::string describe(const std::vector<std::string>& values) {
+    std::string text;
+    for (const auto& v : values) text += (text.empty() ? "" : ",") + v;
+    return text;
+}
+
+// The keys of probes (each the values of cols) that are rows of table, in the database in root.
+std::unordered_set<std::string> findKeys(const std::string& root, const TableDef& table, const std::vector<int>& cols,
+                                         const std::vector<std::vector<std::string>>& probes) {
+    std::vector<DataType> types;
+    for (int c : cols) types.push_back(table.columns[c].type);
+    std::unordered_map<std::string, const std::vector<std::string>*> pending;
+    for (const auto& p : probes) pending.emplace(keyOf(p, types), &p);
+
+    std::unordered_set<std::string> found;
+    const std::string path = dataPath(root, table.name);
+    const size_t columnCount = table.columns.size();
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec || size == 0) return found;
+
+    // While the stats have seen every change to the file, a value outside a
+    // column's min/max is in no row.
+    if (table.stats && table.stats->bytes == size) {
+        for (size_t i = 0; i < cols.size(); ++i) {
+            const ColumnStats* c = table.stats->column(table.columns[cols[i]].name);
+            if (!c) continue;
+            std::string lo, hi, key;
+            appendSortKey(lo, c->min, types[i], false);
+            appendSortKey(hi, c->max, types[i], false);
+            for (auto it = pending.begin(); it != pending.end();) {
+                key.clear();
+                appendSortKey(key, (*it->second)[i], types[i], false);
+                bool outside = c->min.empty() || key < lo || key > hi;
+                it = outside ? pending.erase(it) : std::next(it);
+            }
+        }
+    }
+
+    auto rowKey = [&](RowView& row, std::string& key) {
+        key.clear();
+        for (size_t i = 0; i < cols.size(); ++i) appendSortKey(key, row.field(cols[i]), types[i], false);
+    };
+    auto ignore = [](const std::string&) {};
+
+    auto cluster = std::find_if(cols.begin(), cols.end(), [&](int c) {
+        return table.columns[c].name == table.clusteredBy;
+    });
+    if (cluster != cols.end() && pending.size() * kSeekBytes < size) {
+        size_t i = cluster - cols.begin();
+        std::string key;
+        for (const auto& [probe, values] : pending) {
+            ByteRange range = findKeyRange(path, columnCount, *cluster, types[i], (*values)[i]);
+            forEachRowInRange(path, range, columnCount, [&](RowView& row) {
+                rowKey(row, key);
+                if (key != probe) return true;
+                found.insert(probe);
+                return false;
+            }, ignore);
+        }
+        return found;
+    }
+    if (pending.empty()) return found;
+
+    // One scan for the rest, stopped once every key has turned up.
+    std::mutex mutex;
+    std::atomic<size_t> missing{pending.size()};
+    auto ranges = splitFile(path, size < kParallelScanMinBytes ? 1 : workerThreads());
+    parallelFor(ranges.size(), [&](size_t r) {
+        std::string key;
+        forEachRowInRange(path, ranges[r], columnCount, [&](RowView& row) {
+            rowKey(row, key);
+            if (pending.count(key)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (found.insert(key).second) --missing;
+            }
+            return missing > 0;
+        }, ignore);
+    });
+    return found;
+}
+
+// The last non-blank line of a data file of size bytes, read from its end.
+std::string lastLine(const std::string& path, uint64_t size, bool& endsWithNewline) {
+    std::ifstream in(path, std::ios::binary);
+    std::string tail;
+    uint64_t pos = size;
+    while (pos > 0) {
+        uint64_t step = std::min<uint64_t>(pos, 4096);
+        pos -= step;
+        std::string chunk(step, '\0');
+        in.seekg(static_cast<std::streamoff>(pos));
+        in.read(&chunk[0], static_cast<std::streamsize>(step));
+        tail.insert(0, chunk);
+        size_t end = tail.find_last_not_of("\r\n");
+        if (end == std::string::npos) continue;
+        size_t start = tail.rfind('\n', end);
+        if (start != std::string::npos) {
+            endsWithNewline = tail.back() == '\n';
+            return tail.substr(start + 1, end - start);
+        }
+    }
+    endsWithNewline = tail.empty() || tail.back() == '\n';
+    size_t end = tail.find_last_not_of("\r\n");
+    return end == std::string::npos ? "" : tail.substr(0, end + 1);
+}
+
+bool checkValues(const TableDef& table, std::vector<std::vector<std::string>>& rows, std::string& error) {
+    for (size_t r = 0; r < rows.size(); ++r) {
+        const std::string where = " (row " + std::to_string(r + 1) + ")";
+        for (size_t c = 0; c < table.columns.size(); ++c) {
+            const ColumnDef& col = table.columns[c];
+            std::string& v = rows[r][c];
+            v = trim(v);
+            if (v.find_first_of(",\r\n") != std::string::npos) {
+                error = "Value of " + col.name + " contains a comma or line break" + where + ": " + v;
+                return false;
+            }
+            if (v.empty()) {
+                if (!col.notNull && !col.isPrimaryKey) continue;
+                error = "Column " + col.name + " cannot be null" + where + ".";
+                return false;
+            }
+            int64_t i;
+            double d;
+            if ((col.type == DataType::INT && !parseInt(v, i)) || (col.type == DataType::FLOAT && !parseFloat(v, d))) {
+                error = "Invalid " + toString(col.type) + " value for " + col.name + where + ": " + v;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool checkPrimaryKey(const TableDef& table, const Catalog& catalog, const std::vector<std::vector<std::string>>& rows,
+                     std::string& error) {
+    std::vector<int> cols;
+    std::vector<DataType> types;
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+        if (!table.columns[c].isPrimaryKey) continue;
+        cols.push_back(static_cast<int>(c));
+        types.push_back(table.columns[c].type);
+    }
+    if (cols.empty()) return true;
+
+    std::vector<std::vector<std::string>> keys;
+    std::unordered_set<std::string> seen;
+    for (const auto& row : rows) {
+        std::vector<std::string> key;
+        for (int c : cols) key.push_back(row[c]);
+        if (!seen.insert(keyOf(key, types)).second) {
+            error = "Duplicate primary key among the rows: " + describe(key);
+            return false;
+        }
+        keys.push_back(std::move(key));
+    }
+    auto existing = findKeys(catalog.root(), table, cols, keys);
+    for (const auto& key : keys) {
+        if (existing.count(keyOf(key, types))) {
+            error = "Primary key already exists: " + describe(key);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkForeignKeys(const TableDef& table, const Catalog& catalog, const std::vector<std::vector<std::string>>& rows,
+                      std::string& error) {
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+        const ColumnDef& col = table.columns[c];
+        if (!col.hasForeignKey) continue;
+        auto parent = catalog.getTable(col.fkTable);
+        int ref = -1;
+        for (size_t i = 0; parent && i < parent->columns.size(); ++i) {
+            if (parent->columns[i].name == col.fkColumn) ref = static_cast<int>(i);
+        }
+        if (ref < 0) {
+            error = "Referenced column not found: " + col.fkTable + "." + col.fkColumn;
+            return false;
+        }
+        const std::vector<DataType> types{parent->columns[ref].type};
+
+        // A table referring to itself may refer to the rows being inserted.
+        std::unordered_set<std::string> own;
+        if (parent->name == table.name) {
+            for (const auto& row : rows) own.insert(keyOf({row[ref]}, types));
+        }
+        std::vector<std::vector<std::string>> probes;
+        for (const auto& row : rows) {
+            if (row[c].empty() || own.count(keyOf({row[c]}, types))) continue;
+            int64_t i;
+            double d;
+            if ((types[0] == DataType::INT && !parseInt(row[c], i)) ||
+                (types[0] == DataType::FLOAT && !parseFloat(row[c], d))) {
+                error = "Foreign key " + col.name + "=" + row[c] + " is not a valid " + toString(types[0]) + ".";
+                return false;
+            }
+            probes.push_back({row[c]});
+        }
+        auto existing = findKeys(catalog.root(), *parent, {ref}, probes);
+        for (const auto& probe : probes) {
+            if (!existing.count(keyOf(probe, types))) {
+                error = "Foreign key " + col.name + "=" + probe[0] + " not found in " + col.fkTable + "." +
+                        col.fkColumn + ".";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool insertRows(const TableDef& table, const Catalog& catalog, std::vector<std::vector<std::string>>& rows,
+                bool& stillClustered, std::string& error) {
+    if (!checkValues(table, rows, error) || !checkPrimaryKey(table, catalog, rows, error) ||
+        !checkForeignKeys(table, catalog, rows, error)) {
+        return false;
+    }
+
+    const std::string path = dataPath(catalog.root(), table.name);
+    std::error_code ec;
+    uint64_t size = std::filesystem::exists(path, ec) ? std::filesystem::file_size(path, ec) : 0;
+    bool endsWithNewline = true;
+    std::string last = size > 0 ? lastLine(path, size, endsWithNewline) : "";
+
+    // Rows appended in order, none below the last one, keep the file clustered.
+    stillClustered = false;
+    for (size_t idx = 0; idx < table.columns.size() && !table.clusteredBy.empty(); ++idx) {
+        if (table.columns[idx].name != table.clusteredBy) continue;
+        const DataType type = table.columns[idx].type;
+        std::string previous, key;
+        RowView view;
+        view.reset(last);
+        if (!last.empty()) {
+            if (view.fieldCount() != table.columns.size()) break;
+            appendSortKey(previous, view.field(idx), type, false);
+        }
+        stillClustered = true;
+        for (const auto& row : rows) {
+            key.clear();
+            appendSortKey(key, row[idx], type, false);
+            if (key < previous) {
+                stillClustered = false;
+                break;
+            }
+            previous.swap(key);
+        }
+    }
+
+    std::string text;
+    if (!endsWithNewline) text += '\n';
+    for (const auto& row : rows) {
+        for (size_t c = 0; c < row.size(); ++c) {
+            if (c > 0) text += ',';
+            text += row[c];
+        }
+        text += '\n';
+    }
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        out.flush();
+        if (out) return true;
+    }
+    // Cut off whatever part of the rows made it.
+    std::filesystem::resize_file(path, size, ec);
+    error = "Failed to append to " + path;
+    return false;
+}
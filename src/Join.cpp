@@ -0,0 +1,555 @@
+#include "Join.hpp"
+#include "Bloom.hpp"
+#include "ExternalSort.hpp"
+#include "Hash.hpp"
+#include "Utility.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+namespace {
+
+// Splits "table.col" into its parts; table is empty for a bare name.
+void splitQualified(const std::string& name, std::string& table, std::string& column) {
+    size_t dot = name.find('.');
+    if (dot == std::string::npos) {
+        table.clear();
+        column = name;
+    } else {
+        table = name.substr(0, dot);
+        column = name.substr(dot + 1);
+    }
+}
+
+int findColumn(const std::vector<Column>& columns, const std::string& name) {
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (columns[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// Rewrites a bare column name to table.col when exactly one side has it.
+bool qualify(std::string& name, const JoinQuery& q, const std::vector<Column>& leftColumns,
+             const std::vector<Column>& rightColumns, std::string& error) {
+    if (name.find('.') != std::string::npos) return true;
+    bool inLeft = findColumn(leftColumns, name) != -1;
+    bool inRight = findColumn(rightColumns, name) != -1;
+    if (inLeft && inRight) {
+        error = "Ambiguous column: " + name + " (use " + q.left + "." + name + " or " + q.right + "." + name + ")";
+        return false;
+    }
+    if (inLeft) name = q.left + "." + name;
+    else if (inRight) name = q.right + "." + name;
+    return true;
+}
+
+// The key of a join row as every join algorithm compares it: the text, or
+// for numbers their typed encoding. False when the key never joins.
+bool joinKey(std::string_view value, DataType type, std::string& buffer, std::string_view& key) {
+    if (value.empty()) return false;
+    if (type == DataType::STRING) {
+        key = value;
+        return true;
+    }
+    buffer.clear();
+    appendSortKey(buffer, value, type, false);
+    key = buffer;
+    return buffer[0] != '\0';
+}
+
+constexpr uint32_t kNone = UINT32_MAX;
+// Grace join fan-out per pass, and how often one partition may be split again
+// before falling back to joining it in memory-sized chunks.
+constexpr size_t kPartitionBits = 5;
+constexpr int kMaxGraceDepth = 3;
+// Accounted per build row on top of its line and key: offsets, hash, chain link, bucket.
+constexpr size_t kRowOverhead = 48;
+
+// In-memory build side: raw lines with their keys copied beside them, so
+// probing compares keys without re-splitting the stored line.
+class BuildTable {
+public:
+    explicit BuildTable(MemoryBudget& budget) : reservation(budget) {}
+
+    // False when the budget refuses the memory for this row. An empty table
+    // always takes one row so that progress is guaranteed.
+    bool add(std::string_view line, std::string_view key, uint64_t hash) {
+        size_t need = lines.size() + line.size() + keys.size() + key.size() + (hashes.size() + 1) * kRowOverhead;
+        if (!reservation.ensure(need) && !hashes.empty()) return false;
+        lines.append(line);
+        lineEnds.push_back(lines.size());
+        keys.append(key);
+        keyEnds.push_back(keys.size());
+        hashes.push_back(hash);
+        return true;
+    }
+
+    bool empty() const { return hashes.empty(); }
+    size_t rows() const { return hashes.size(); }
+    size_t lineBytes() const { return lines.size(); }
+    const std::vector<uint64_t>& keyHashes() const { return hashes; }
+
+    void index() {
+        size_t rows = hashes.size();
+        buckets = 16;
+        while (buckets < rows * 2) buckets *= 2;
+        heads.assign(buckets, kNone);
+        next.assign(rows, kNone);
+        // Link in reverse so each chain lists build rows in file order.
+        for (uint32_t r = static_cast<uint32_t>(rows); r-- > 0;) {
+            size_t b = hashes[r] & (buckets - 1);
+            next[r] = heads[b];
+            heads[b] = r;
+        }
+    }
+
+    // Calls fn with every stored line whose key equals key; stops when fn returns false.
+    template <typename Fn>
+    bool probe(std::string_view key, uint64_t hash, Fn&& fn) const {
+        std::string_view lineData(lines), keyData(keys);
+        for (uint32_t r = heads[hash & (buckets - 1)]; r != kNone; r = next[r]) {
+            if (hashes[r] != hash || keyData.substr(keyEnds[r], keyEnds[r + 1] - keyEnds[r]) != key) continue;
+            if (!fn(lineData.substr(lineEnds[r], lineEnds[r + 1] - lineEnds[r]))) return false;
+        }
+        return true;
+    }
+
+    template <typename Fn>
+    void forEachLine(Fn&& fn) const {
+        std::string_view lineData(lines), keyData(keys);
+        for (size_t r = 0; r < hashes.size(); ++r) {
+            fn(lineData.substr(lineEnds[r], lineEnds[r + 1] - lineEnds[r]),
+               keyData.substr(keyEnds[r], keyEnds[r + 1] - keyEnds[r]));
+        }
+    }
+
+    // clear(), handing back the key hashes instead of dropping them.
+    std::vector<uint64_t> takeKeyHashes() {
+        std::vector<uint64_t> taken = std::move(hashes);
+        clear();
+        return taken;
+    }
+
+    void clear() {
+        lines = std::string();
+        keys = std::string();
+        lineEnds.assign(1, 0);
+        keyEnds.assign(1, 0);
+        hashes = std::vector<uint64_t>();
+        heads = std::vector<uint32_t>();
+        next = std::vector<uint32_t>();
+        reservation.reset();
+    }
+
+private:
+    MemoryReservation reservation;
+    std::string lines, keys;
+    std::vector<size_t> lineEnds{0}, keyEnds{0};
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> heads, next;
+    size_t buckets = 0;
+};
+
+// Scatters rows into 2^kPartitionBits temp files by a hash of their key. Each
+// grace level seeds the hash differently so an oversized partition splits
+// again instead of landing in one file. The files hold plain table lines and
+// are removed with the partitioner.
+class Partitioner {
+public:
+    Partitioner(const std::string& root, int depth) : seed(static_cast<uint64_t>(depth) + 1) {
+        for (size_t p = 0; p < (size_t(1) << kPartitionBits); ++p) {
+            paths.push_back(makeTempPath(root, "join"));
+            files.push_back(std::make_unique<std::ofstream>(paths.back(), std::ios::binary));
+            rows.push_back(0);
+        }
+    }
+
+    ~Partitioner() {
+        files.clear();
+        for (const auto& p : paths) std::remove(p.c_str());
+    }
+
+    Partitioner(const Partitioner&) = delete;
+    Partitioner& operator=(const Partitioner&) = delete;
+
+    void write(std::string_view line, std::string_view key) {
+        size_t p = hashBytes(key, seed) >> (64 - kPartitionBits);
+        files[p]->write(line.data(), static_cast<std::streamsize>(line.size()));
+        files[p]->put('\n');
+        ++rows[p];
+    }
+
+    void close() {
+        for (auto& f : files) f->close();
+    }
+
+    size_t count() const { return paths.size(); }
+    const std::string& path(size_t p) const { return paths[p]; }
+    size_t rowCount(size_t p) const { return rows[p]; }
+
+private:
+    uint64_t seed;
+    std::vector<std::string> paths;
+    std::vector<std::unique_ptr<std::ofstream>> files;
+    std::vector<size_t> rows;
+};
+
+// Streams the probe input past a finished build table. False if emit stopped the join.
+// A probe row whose key misses the Bloom filter is dropped after decoding only that key.
+bool probeTable(const BuildTable& table, const BloomFilter* bloom, const JoinInput& probe, bool buildIsLeft,
+                const JoinEmit& emit, const MalformedFn& onMalformed) {
+    bool more = true;
+    RowView buildRow;
+    std::string keyBuffer;
+    uint64_t read = 0, passed = 0;
+    std::ifstream probeFile(probe.path);
+    forEachRow(probeFile, probe.columnCount,
+        [&](RowView& row) {
+            ++read;
+            std::string_view key;
+            if (!joinKey(row.field(probe.keyIdx), probe.keyType, keyBuffer, key)) return true;
+            uint64_t h = hashBytes(key);
+            if (bloom && !bloom->mayContain(h)) return true;
+            if (probe.filter && !matches(*probe.filter, row.field(probe.filter->columnIdx))) return true;
+            ++passed;
+            more = table.probe(key, h, [&](std::string_view line) {
+                buildRow.reset(line);
+                return buildIsLeft ? emit(buildRow, row) : emit(row, buildRow);
+            });
+            return more;
+        },
+        onMalformed);
+    if (probe.counters) probe.counters->add(read, passed);
+    return more;
+}
+
+// One level of the join. The build input is loaded until the budget refuses a
+// row; if it all fits this is a plain in-memory hash join. Otherwise what was
+// loaded and the rest of the build input are partitioned, the probe input is
+// partitioned the same way, and each pair is joined one level down. Past
+// kMaxGraceDepth (e.g. one key with more rows than fit) the build input is
+// instead taken in memory-sized chunks, each probed with the whole probe input.
+//
+// When the build input is filtered, the top level also fills a Bloom filter
+// with its keys and drops probe rows that cannot match before they are probed
+// or written to a partition.
+bool joinLevel(const JoinInput& build, const JoinInput& probe, bool buildIsLeft, const JoinEmit& emit,
+               const MalformedFn& onMalformed, MemoryBudget& budget, const std::string& root, int depth) {
+    BuildTable table(budget);
+    std::unique_ptr<Partitioner> buildParts;
+    bool more = true;
+    const bool wantBloom = depth == 0 && build.filter.has_value();
+    std::unique_ptr<BloomFilter> bloom;
+    MemoryReservation bloomReservation(budget);
+    auto makeBloom = [&](size_t expectedKeys, const std::vector<uint64_t>& hashes) {
+        if (!bloomReservation.ensure(BloomFilter::bytesFor(expectedKeys))) return;
+        bloom = std::make_unique<BloomFilter>(expectedKeys);
+        for (uint64_t h : hashes) bloom->insert(h);
+    };
+
+    std::string keyBuffer;
+    uint64_t read = 0, passed = 0;
+    std::ifstream buildFile(build.path);
+    forEachRow(buildFile, build.columnCount,
+        [&](RowView& row) {
+            ++read;
+            if (build.filter && !matches(*build.filter, row.field(build.filter->columnIdx))) return true;
+            std::string_view key;
+            if (!joinKey(row.field(build.keyIdx), build.keyType, keyBuffer, key)) return true;
+            ++passed;
+            if (buildParts) {
+                buildParts->write(row.raw(), key);
+                if (bloom) bloom->insert(hashBytes(key));
+                return true;
+            }
+            uint64_t h = hashBytes(key);
+            if (table.add(row.raw(), key, h)) return true;
+
+            if (depth >= kMaxGraceDepth) {
+                table.index();
+                more = probeTable(table, nullptr, probe, buildIsLeft, emit, onMalformed);
+                table.clear();
+                table.add(row.raw(), key, h);
+                return more;
+            }
+            buildParts = std::make_unique<Partitioner>(root, depth);
+            table.forEachLine([&](std::string_view line, std::string_view k) { buildParts->write(line, k); });
+            if (wantBloom) {
+                // The final key count is unknown here; size for every row of the
+                // file passing. The table gives its memory back first, or the
+                // budget it fills would refuse the filter.
+                std::error_code ec;
+                uint64_t fileBytes = std::filesystem::file_size(build.path, ec);
+                size_t rowBytes = table.lineBytes() / table.rows() + 1;
+                size_t expected = ec ? table.rows() : static_cast<size_t>(fileBytes / rowBytes);
+                makeBloom(expected, table.takeKeyHashes());
+                if (bloom) bloom->insert(h);
+            }
+            table.clear();
+            buildParts->write(row.raw(), key);
+            return true;
+        },
+        onMalformed);
+    buildFile.close();
+    if (build.counters) build.counters->add(read, passed);
+    if (!more) return false;
+
+    if (!buildParts) {
+        if (table.empty()) return true;
+        table.index();
+        if (wantBloom) makeBloom(table.rows(), table.keyHashes());
+        return probeTable(table, bloom.get(), probe, buildIsLeft, emit, onMalformed);
+    }
+    buildParts->close();
+
+    Partitioner probeParts(root, depth);
+    read = passed = 0;
+    std::ifstream probeFile(probe.path);
+    forEachRow(probeFile, probe.columnCount,
+        [&](RowView& row) {
+            ++read;
+            std::string_view key;
+            if (!joinKey(row.field(probe.keyIdx), probe.keyType, keyBuffer, key)) return true;
+            if (bloom && !bloom->mayContain(hashBytes(key))) return true;
+            if (probe.filter && !matches(*probe.filter, row.field(probe.filter->columnIdx))) return true;
+            ++passed;
+            probeParts.write(row.raw(), key);
+            return true;
+        },
+        onMalformed);
+    probeFile.close();
+    if (probe.counters) probe.counters->add(read, passed);
+    probeParts.close();
+
+    for (size_t p = 0; p < buildParts->count(); ++p) {
+        if (buildParts->rowCount(p) == 0 || probeParts.rowCount(p) == 0) continue;
+        JoinInput b{buildParts->path(p), build.columnCount, build.keyIdx, std::nullopt, nullptr, build.keyType};
+        JoinInput r{probeParts.path(p), probe.columnCount, probe.keyIdx, std::nullopt, nullptr, probe.keyType};
+        if (!joinLevel(b, r, buildIsLeft, emit, onMalformed, budget, root, depth + 1)) return false;
+    }
+    return true;
+}
+
+// Pull-style reader over a sorted input for the merge join. Keys are kept in
+// the normalized sort encoding so comparing them is a memcmp.
+class SortedCursor {
+public:
+    SortedCursor(const JoinInput& in, DataType keyType, const MalformedFn& onMalformed)
+        : in(in), keyType(keyType), onMalformed(onMalformed), file(in.path) {}
+    ~SortedCursor() {
+        if (in.counters) in.counters->add(read, passed);
+    }
+
+    // Moves to the next row that passes the filter and has a key. False at the
+    // end of the input or when the keys go backwards.
+    bool next() {
+        while (std::getline(file, line)) {
+            if (line.empty()) continue;
+            current.reset(line);
+            if (current.fieldCount() != in.columnCount) {
+                onMalformed(line);
+                continue;
+            }
+            ++read;
+            if (in.filter && !matches(*in.filter, current.field(in.filter->columnIdx))) continue;
+            std::string_view value = current.field(in.keyIdx);
+            if (value.empty()) continue;    // empty never joins
+
+            candidate.clear();
+            appendSortKey(candidate, value, keyType, false);
+            if (keyType != DataType::STRING && candidate[0] == '\0') continue;    // not a number
+            if (started && compareKeys(candidate, encoded) < 0) {
+                unsorted = true;
+                return false;
+            }
+            encoded.swap(candidate);
+            started = true;
+            ++passed;
+            return true;
+        }
+        return false;
+    }
+
+    RowView& row() { return current; }
+    const std::string& key() const { return encoded; }
+    std::string_view raw() const { return line; }
+    bool outOfOrder() const { return unsorted; }
+
+    static int compareKeys(const std::string& a, const std::string& b) {
+        int c = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+        if (c != 0) return c;
+        return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+    }
+
+private:
+    const JoinInput& in;
+    DataType keyType;
+    const MalformedFn& onMalformed;
+    std::ifstream file;
+    std::string line;
+    RowView current;
+    std::string encoded, candidate;
+    bool started = false;
+    bool unsorted = false;
+    uint64_t read = 0, passed = 0;
+};
+
+} // namespace
+
+bool parseJoin(const std::vector<std::string>& args, JoinQuery& q, std::string& error) {
+    if (args.size() < 2) {
+        error = "Missing table names.";
+        return false;
+    }
+    q.left = args[0];
+    q.right = args[1];
+    if (q.left == q.right) {
+        error = "Self joins are not supported.";
+        return false;
+    }
+
+    size_t i = 2;
+    if (i < args.size() && args[i] == "on") {
+        auto parts = i + 1 < args.size() ? split(args[i + 1], '=') : std::vector<std::string>{};
+        if (parts.size() != 2) {
+            error = "Invalid ON clause syntax (use on <lcol>=<rcol>).";
+            return false;
+        }
+        std::string lt, lc, rt, rc;
+        splitQualified(parts[0], lt, lc);
+        splitQualified(parts[1], rt, rc);
+        if (lt == q.right && rt == q.left) {
+            std::swap(lt, rt);
+            std::swap(lc, rc);
+        }
+        if ((!lt.empty() && lt != q.left) || (!rt.empty() && rt != q.right)) {
+            error = "ON clause must compare a column of " + q.left + " with a column of " + q.right + ".";
+            return false;
+        }
+        q.leftKey = lc;
+        q.rightKey = rc;
+        i += 2;
+    }
+
+    q.select.table = q.left;
+    if (!parseSelectClauses(std::vector<std::string>(args.begin() + i, args.end()), q.select, error)) return false;
+    if (!q.select.aggregates.empty()) {
+        error = "jodo does not support group by/agg.";
+        return false;
+    }
+    return true;
+}
+
+bool resolveJoin(JoinQuery& q, const std::vector<Column>& leftColumns, const std::vector<Column>& rightColumns,
+                 const Catalog& catalog, std::string& error) {
+    if (q.leftKey.empty()) {
+        auto leftDef = catalog.getTable(q.left);
+        auto rightDef = catalog.getTable(q.right);
+        if (leftDef) {
+            for (const auto& c : leftDef->columns) {
+                if (c.hasForeignKey && c.fkTable == q.right) {
+                    q.leftKey = c.name;
+                    q.rightKey = c.fkColumn;
+                    break;
+                }
+            }
+        }
+        if (q.leftKey.empty() && rightDef) {
+            for (const auto& c : rightDef->columns) {
+                if (c.hasForeignKey && c.fkTable == q.left) {
+                    q.leftKey = c.fkColumn;
+                    q.rightKey = c.name;
+                    break;
+                }
+            }
+        }
+        if (q.leftKey.empty()) {
+            error = "No foreign key between " + q.left + " and " + q.right + "; use on <lcol>=<rcol>.";
+            return false;
+        }
+    }
+
+    q.leftKeyIdx = findColumn(leftColumns, q.leftKey);
+    q.rightKeyIdx = findColumn(rightColumns, q.rightKey);
+    if (q.leftKeyIdx == -1) {
+        error = "Column not found in schema: " + q.left + "." + q.leftKey;
+        return false;
+    }
+    if (q.rightKeyIdx == -1) {
+        error = "Column not found in schema: " + q.right + "." + q.rightKey;
+        return false;
+    }
+
+    SelectQuery& s = q.select;
+    for (auto& name : s.projection) {
+        if (!qualify(name, q, leftColumns, rightColumns, error)) return false;
+    }
+    if (s.filter && !qualify(s.filter->column, q, leftColumns, rightColumns, error)) return false;
+    for (auto& k : s.orderBy) {
+        if (!qualify(k.column, q, leftColumns, rightColumns, error)) return false;
+    }
+
+    std::vector<Column> combined;
+    for (const auto& c : leftColumns) combined.push_back({q.left + "." + c.name, c.type});
+    for (const auto& c : rightColumns) combined.push_back({q.right + "." + c.name, c.type});
+    q.leftColumnCount = leftColumns.size();
+    return resolveSelect(s, combined, error);
+}
+
+DataType joinKeyType(DataType left, DataType right) {
+    if (left == DataType::INT && right == DataType::INT) return DataType::INT;
+    if (left != DataType::STRING && right != DataType::STRING) return DataType::FLOAT;
+    return DataType::STRING;
+}
+
+void hashJoin(const JoinInput& build, const JoinInput& probe, bool buildIsLeft, const JoinEmit& emit,
+              const MalformedFn& onMalformed, MemoryBudget& budget, const std::string& root) {
+    joinLevel(build, probe, buildIsLeft, emit, onMalformed, budget, root, 0);
+}
+
+bool mergeJoin(const JoinInput& left, const JoinInput& right, DataType keyType, const JoinEmit& emit,
+               const MalformedFn& onMalformed) {
+    SortedCursor l(left, keyType, onMalformed), r(right, keyType, onMalformed);
+    bool hasLeft = l.next(), hasRight = r.next();
+
+    // Right rows with the current key, replayed for every left row that has it.
+    std::string groupKey, groupLines;
+    std::vector<size_t> groupEnds;
+    RowView rightRow;
+
+    while (hasLeft && hasRight) {
+        int c = SortedCursor::compareKeys(l.key(), r.key());
+        if (c < 0) {
+            hasLeft = l.next();
+            continue;
+        }
+        if (c > 0) {
+            hasRight = r.next();
+            continue;
+        }
+
+        groupKey = r.key();
+        groupLines.clear();
+        groupEnds.assign(1, 0);
+        while (hasRight && r.key() == groupKey) {
+            groupLines.append(r.raw());
+            groupEnds.push_back(groupLines.size());
+            hasRight = r.next();
+        }
+        std::string_view lines(groupLines);
+        while (hasLeft && l.key() == groupKey) {
+            for (size_t i = 0; i + 1 < groupEnds.size(); ++i) {
+                rightRow.reset(lines.substr(groupEnds[i], groupEnds[i + 1] - groupEnds[i]));
+                if (!emit(l.row(), rightRow)) return true;
+            }
+            hasLeft = l.next();
+        }
+    }
+    // What is left of the longer side joins nothing, but is read to the end
+    // so that a row out of order there is not missed.
+    while (hasLeft) hasLeft = l.next();
+    while (hasRight) hasRight = r.next();
+    return !l.outOfOrder() && !r.outOfOrder();
+}
@@ -2,6 +2,5 @@
 
 int main(int argc, char* argv[]) {
     CommandHandler handler;
-    handler.execute(argc, argv);
-    return 0;
+    return handler.execute(argc, argv) ? 0 : 1;
 }
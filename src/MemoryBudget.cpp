@@ -0,0 +1,6 @@
+#include "MemoryBudget.hpp"
+#include "Utility.hpp"
+
+size_t queryMemoryLimit() {
+    return envSize("CDB_QUERY_MEMORY", size_t(1) << 30);
+}
@@ -0,0 +1,82 @@
+#include "Mutation.hpp"
+#include "ParallelScan.hpp"
+#include "Utility.hpp"
+#include <cstdio>
+#include <filesystem>
+
+namespace {
+
+struct MorselBatch {
+    std::string bytes;      // the morsel's rows as they are to be written
+    size_t affected = 0;
+};
+
+} // namespace
+
+bool applyMutation(const std::string& root, const std::string& table, size_t columnCount, const Mutation& m,
+                   size_t& affected, const std::function<void(const std::string&)>& onMalformed, std::string& error) {
+    const std::string path = dataPath(root, table);
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        error = "Failed to open data file.";
+        return false;
+    }
+    size_t threads = size < kParallelScanMinBytes ? 1 : workerThreads();
+
+    std::string staged = makeTempPath(root, m.remove ? "delete" : "update");
+    std::ofstream out(staged, std::ios::binary);
+    if (!out.is_open()) {
+        error = "Failed to create " + staged;
+        return false;
+    }
+
+    std::mutex reportMutex;
+    auto report = [&](const std::string& line) {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        onMalformed(line);
+    };
+
+    affected = 0;
+    forEachMorselInOrder<MorselBatch>(path, ByteRange{0, size}, threads,
+        [&](std::istream& in, ByteRange range, MorselBatch& batch, const std::atomic<bool>&) {
+            forEachRowInRange(in, range, columnCount,
+                [&](RowView& row) {
+                    bool hit = !m.filter || matches(*m.filter, row.field(m.filter->columnIdx));
+                    if (!hit) {
+                        batch.bytes.append(row.raw());
+                        batch.bytes.push_back('\n');
+                        return true;
+                    }
+                    ++batch.affected;
+                    if (m.remove) return true;
+                    for (size_t i = 0; i < columnCount; ++i) {
+                        if (i > 0) batch.bytes.push_back(',');
+                        if (static_cast<int>(i) == m.setIdx) batch.bytes.append(m.setValue);
+                        else batch.bytes.append(row.field(i));
+                    }
+                    batch.bytes.push_back('\n');
+                    return true;
+                },
+                report);
+        },
+        [&](const MorselBatch& batch) {
+            out.write(batch.bytes.data(), static_cast<std::streamsize>(batch.bytes.size()));
+            affected += batch.affected;
+            return static_cast<bool>(out);
+        });
+
+    out.close();
+    if (!out) {
+        std::remove(staged.c_str());
+        error = "Failed to write " + staged;
+        return false;
+    }
+    std::filesystem::rename(staged, path, ec);
+    if (ec) {
+        std::remove(staged.c_str());
+        error = "Failed to replace " + path + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
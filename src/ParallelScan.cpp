@@ -0,0 +1,54 @@
+#include "ParallelScan.hpp"
+
+namespace {
+
+// Cells of the rows one morsel produced, back to back.
+struct MorselRows {
+    std::string cells;
+    std::vector<uint32_t> ends;     // end offset of every cell, row after row
+};
+
+} // namespace
+
+void parallelScan(const std::string& path, ByteRange range, size_t columnCount, const std::optional<Predicate>& filter,
+                  const std::vector<int>& scanIdx, size_t threads, ResultWriter& writer,
+                  const std::function<bool()>& done, const std::function<void(const std::string&)>& onMalformed,
+                  ScanCounters* counters) {
+    std::mutex reportMutex;
+    auto report = [&](const std::string& line) {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        onMalformed(line);
+    };
+
+    std::vector<std::string_view> values(scanIdx.size());
+    forEachMorselInOrder<MorselRows>(path, range, threads,
+        [&](std::istream& in, ByteRange morsel, MorselRows& out, const std::atomic<bool>& stop) {
+            uint64_t read = 0, passed = 0;
+            forEachRowInRange(in, morsel, columnCount,
+                [&](RowView& row) {
+                    ++read;
+                    if (filter && !matches(*filter, row.field(filter->columnIdx))) return true;
+                    ++passed;
+                    for (int idx : scanIdx) {
+                        out.cells.append(row.field(idx));
+                        out.ends.push_back(static_cast<uint32_t>(out.cells.size()));
+                    }
+                    return !stop.load(std::memory_order_relaxed);
+                },
+                report);
+            if (counters) counters->add(read, passed);
+        },
+        [&](const MorselRows& rows) {
+            std::string_view cells(rows.cells);
+            uint32_t begin = 0;
+            for (size_t c = 0; c < rows.ends.size();) {
+                for (size_t i = 0; i < values.size(); ++i, ++c) {
+                    values[i] = cells.substr(begin, rows.ends[c] - begin);
+                    begin = rows.ends[c];
+                }
+                writer.row(values);
+                if (done()) return false;
+            }
+            return true;
+        });
+}
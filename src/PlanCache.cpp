@@ -0,0 +1,114 @@
+#include "PlanCache.hpp"
+#include <algorithm>
+
+namespace {
+
+// Schema files of the tables args name: one for dikhao, two for jodo.
+std::vector<std::string> schemaPaths(const std::string& root, const std::vector<std::string>& args) {
+    std::vector<std::string> paths;
+    size_t tables = args.front() == "jodo" ? 2 : 1;
+    for (size_t i = 1; i <= tables && i < args.size(); ++i) paths.push_back(metaPath(root, args[i]));
+    return paths;
+}
+
+void setParameter(std::optional<Predicate>& filter, const std::string& value) {
+    if (filter && filter->parameter) {
+        filter->value = value;
+        filter->parameter = false;
+    }
+}
+
+void bindPlan(PlanNode& node, const std::string& value) {
+    setParameter(node.filter, value);
+    for (auto& child : node.children) bindPlan(*child, value);
+}
+
+} // namespace
+
+PlanCache::PlanCache() : capacity(envSize("CDB_PLAN_CACHE", 1024)) {}
+
+PlanCache& PlanCache::instance() {
+    static PlanCache cache;
+    return cache;
+}
+
+bool PlanCache::current(const Entry& e, uint64_t catalogVersion) {
+    if (e.catalogVersion != catalogVersion) return false;
+    for (const auto& [path, stamp] : e.schemas) {
+        if (!(fileStamp(path) == stamp)) return false;
+    }
+    return true;
+}
+
+bool PlanCache::prepare(const std::string& root, const std::vector<std::string>& args, PreparedQuery& prepared,
+                        std::string& error) {
+    std::string key = root + '\x1e';
+    for (const auto& a : args) {
+        key += a;
+        key += '\x1f';
+    }
+    const uint64_t version = Catalog::currentVersion(root);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end() && current(*it->second, version)) {
+            entries.splice(entries.begin(), entries, it->second);
+            prepared = it->second->prepared;
+            ++hitCount;
+            return true;
+        }
+        ++missCount;
+    }
+
+    // Stamped before reading, so a change made meanwhile is seen next time.
+    Entry entry;
+    entry.key = key;
+    entry.catalogVersion = version;
+    for (const auto& path : schemaPaths(root, args)) entry.schemas.emplace_back(path, fileStamp(path));
+
+    auto q = std::make_shared<BoundQuery>();
+    if (!bindQuery(root, args.front(), std::vector<std::string>(args.begin() + 1, args.end()), *q, error)) return false;
+    const auto& filter = q->output().filter;
+    bool parameter = filter && filter->parameter;
+    if (static_cast<size_t>(std::count(args.begin(), args.end(), "?")) > (parameter ? 1u : 0u)) {
+        error = "Only the where value can be a parameter (?).";
+        return false;
+    }
+    entry.prepared.parameter = parameter;
+    entry.prepared.plan = planQuery(*q, Catalog::load(root));
+    entry.prepared.query = std::move(q);
+    prepared = entry.prepared;
+
+    if (capacity == 0) return true;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        entries.erase(it->second);
+        index.erase(it);
+    }
+    entries.push_front(std::move(entry));
+    index[key] = entries.begin();
+    if (entries.size() > capacity) {
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+    return true;
+}
+
+uint64_t PlanCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hitCount;
+}
+
+uint64_t PlanCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return missCount;
+}
+
+PreparedQuery bindParameter(const PreparedQuery& prepared, const std::string& value) {
+    auto q = std::make_shared<BoundQuery>(*prepared.query);
+    setParameter(q->join ? q->joinQuery.select.filter : q->select.filter, value);
+    std::shared_ptr<PlanNode> plan = clonePlan(*prepared.plan);
+    bindPlan(*plan, value);
+    return {std::move(q), std::move(plan), false};
+}
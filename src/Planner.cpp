@@ -0,0 +1,331 @@
+#include "Planner.hpp"
+#include "ExternalSort.hpp"
+#include "MemoryBudget.hpp"
+#include "TableScan.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+// Costs are in units of one data file byte read and split into fields.
+constexpr double kRowCost = 16;                 // handing a row to the next operator
+constexpr double kParallelStartup = 2 << 20;    // fanning an operator out to the pool
+constexpr double kSeekStepBytes = 8192;         // read per binary search step
+constexpr double kHashBuildRow = 48;
+constexpr double kHashProbeRow = 24;
+constexpr double kCacheMissFactor = 3;          // probe cost once the hash table outgrows the cache
+constexpr double kCacheBytes = 1 << 20;
+constexpr double kHashRowBytes = 48;            // hash table memory per row beyond the row itself
+constexpr double kSpillByteCost = 2;            // writing a byte to a spill file and reading it back
+constexpr double kBloomCheckCost = 4;           // probe row tested against a build side Bloom filter
+constexpr double kRadixTupleCost = 32;          // loading and partitioning a tuple
+constexpr double kRadixBuildCost = 16;          // inserting a tuple into a partition's hash table
+constexpr double kRadixTupleBytes = 32;         // a tuple and its partitioned copy
+constexpr double kMergeRowCost = 8;
+constexpr double kSortCompareCost = 4;          // per row and level of comparisons
+constexpr double kGroupFraction = 0.1;          // distinct values per row of a column without statistics
+
+constexpr size_t kSampleBytes = 64 << 10;
+
+std::unique_ptr<PlanNode> makeNode(PlanOp op, std::unique_ptr<PlanNode> child = nullptr) {
+    auto node = std::make_unique<PlanNode>();
+    node->op = op;
+    if (child) node->children.push_back(std::move(child));
+    return node;
+}
+
+// Distinct values of a column, as far as the statistics tell.
+double distinctValues(const TableEstimate& t, const std::string& column, double fallback) {
+    const ColumnStats* c = t.stats ? t.stats->column(column) : nullptr;
+    return c && c->distinct > 0 ? c->distinct : fallback;
+}
+
+std::string describeFilter(const Predicate& p) {
+    return "where " + p.column + " " + p.op + " " + p.value;
+}
+
+// Splits work across the pool when that is cheaper than running it on the
+// calling thread; returns the cost and sets threads.
+double parallelCost(double work, bool allowParallel, size_t& threads) {
+    size_t workers = allowParallel ? workerThreads() : 1;
+    threads = 1;
+    if (workers > 1 && work / workers + kParallelStartup < work) {
+        threads = workers;
+        return work / workers + kParallelStartup;
+    }
+    return work;
+}
+
+// Scan of one table. Below a join the scan is driven by the join operator,
+// which reads the whole file itself, so neither a seek nor morsels apply.
+std::unique_ptr<PlanNode> planScan(const std::string& table, const std::vector<Column>& columns,
+                                   const std::optional<Predicate>& filter, const TableEstimate& t,
+                                   const Catalog& catalog, bool belowJoin) {
+    auto node = makeNode(PlanOp::SeqScan);
+    node->table = table;
+    node->path = dataPath(catalog.root(), table);
+    node->columnCount = columns.size();
+    node->filter = filter;
+    node->detail = table;
+    if (filter) node->detail += " " + describeFilter(*filter);
+
+    double sel = filter ? selectivity(*filter, columns, t) : 1;
+    node->rows = t.rows * sel;
+    node->bytes = t.bytes * sel;
+    node->cost = parallelCost(t.bytes + node->rows * kRowCost, !belowJoin, node->threads);
+    if (belowJoin) return node;
+
+    // Equality on the cluster column: binary search the sorted file for the
+    // matching rows instead of reading all of it.
+    auto def = catalog.getTable(table);
+    if (filter && filter->op == "=" && def && def->clusteredBy == columns[filter->columnIdx].name) {
+        size_t threads = 1;
+        double search = 2 * std::log2(std::max(t.rows, 2.0)) * kSeekStepBytes;
+        double seek = search + parallelCost(node->bytes + node->rows * kRowCost, true, threads);
+        if (seek < node->cost) {
+            node->op = PlanOp::ClusteredSeek;
+            node->threads = threads;
+            node->cost = seek;
+        }
+    }
+    return node;
+}
+
+// Sort or TopN, then Limit, on top of input as the query asks.
+std::unique_ptr<PlanNode> planOutput(std::unique_ptr<PlanNode> input, const SelectQuery& q) {
+    if (!q.orderBy.empty()) {
+        // Saturates, so a huge limit plus offset cannot wrap to a small one.
+        size_t keep = q.limit && *q.limit <= SIZE_MAX - q.offset ? q.offset + *q.limit : SIZE_MAX;
+        double n = input->rows;
+        bool topN = keep <= kTopNMaxRows;
+        auto sort = makeNode(topN ? PlanOp::TopN : PlanOp::Sort);
+        sort->limit = keep;
+        sort->detail = "by ";
+        for (size_t i = 0; i < q.orderBy.size(); ++i) {
+            if (i > 0) sort->detail += ",";
+            sort->detail += q.orderBy[i].column + (q.orderBy[i].desc ? ":desc" : "");
+        }
+        if (topN) sort->detail += " keep " + std::to_string(keep);
+        sort->rows = std::min(n, static_cast<double>(keep));
+        sort->bytes = n > 0 ? input->bytes * sort->rows / n : 0;
+        double levels = std::log2(std::max(topN ? static_cast<double>(keep) : n, 2.0));
+        sort->cost = input->cost + n * levels * kSortCompareCost;
+        if (!topN && input->bytes + n * kRowCost > queryMemoryLimit()) sort->cost += kSpillByteCost * input->bytes;
+        sort->children.push_back(std::move(input));
+        input = std::move(sort);
+    }
+
+    if (q.limit || q.offset > 0) {
+        auto limit = makeNode(PlanOp::Limit);
+        limit->offset = q.offset;
+        limit->limit = q.limit.value_or(SIZE_MAX);
+        if (q.limit) limit->detail = std::to_string(*q.limit);
+        if (q.offset > 0) limit->detail += (q.limit ? " " : "") + std::string("offset ") + std::to_string(q.offset);
+        double n = input->rows;
+        limit->rows = std::min(std::max(n - q.offset, 0.0), static_cast<double>(limit->limit));
+        limit->bytes = n > 0 ? input->bytes * limit->rows / n : 0;
+        limit->cost = input->cost;
+        // Without a sort below, the input stops as soon as the limit is met.
+        bool streaming = input->op != PlanOp::Sort && input->op != PlanOp::TopN && input->op != PlanOp::HashAggregate;
+        if (streaming && n > 0) limit->cost *= std::min(1.0, (q.offset + limit->rows) / n);
+        limit->children.push_back(std::move(input));
+        input = std::move(limit);
+    }
+    return input;
+}
+
+} // namespace
+
+const char* planOpName(PlanOp op) {
+    switch (op) {
+        case PlanOp::SeqScan: return "SeqScan";
+        case PlanOp::ClusteredSeek: return "ClusteredSeek";
+        case PlanOp::HashAggregate: return "HashAggregate";
+        case PlanOp::Sort: return "Sort";
+        case PlanOp::TopN: return "TopN";
+        case PlanOp::Limit: return "Limit";
+        case PlanOp::HashJoin: return "HashJoin";
+        case PlanOp::RadixJoin: return "RadixJoin";
+        case PlanOp::MergeJoin: return "MergeJoin";
+    }
+    return "?";
+}
+
+TableEstimate estimateTable(const std::string& path, const std::optional<TableStats>& stats) {
+    TableEstimate t;
+    t.stats = stats;
+    std::error_code ec;
+    t.bytes = std::filesystem::file_size(path, ec);
+    if (ec) {
+        t.bytes = 0;
+        return t;
+    }
+    t.sized = true;
+    if (t.bytes == 0) return t;
+    if (stats && stats->bytes > 0) {
+        t.rows = stats->estimateRows(t.bytes);
+        return t;
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    std::string sample(static_cast<size_t>(std::min<uint64_t>(t.bytes, kSampleBytes)), '\0');
+    in.read(&sample[0], static_cast<std::streamsize>(sample.size()));
+    size_t lines = static_cast<size_t>(std::count(sample.begin(), sample.end(), '\n'));
+    t.rows = lines == 0 ? 1 : static_cast<double>(t.bytes) * lines / sample.size();
+    return t;
+}
+
+double selectivity(const Predicate& p, const std::vector<Column>& columns, const TableEstimate& t) {
+    const Column& column = columns[p.columnIdx];
+    const ColumnStats* c = t.stats ? t.stats->column(column.name) : nullptr;
+    if (!c) return p.op == "=" ? 0.1 : 0.5;
+    // A parameter's value is not known yet: plan for an average one.
+    if (p.parameter) {
+        if (p.op != "=" || t.stats->rows == 0) return 0.5;
+        return (1 - static_cast<double>(c->nulls) / t.stats->rows) / std::max(1.0, c->distinct);
+    }
+    if (p.op == "=") return equalSelectivity(*t.stats, *c, column.type, p.value);
+    return likeSelectivity(*t.stats, *c, p.value);
+}
+
+std::unique_ptr<PlanNode> clonePlan(const PlanNode& plan) {
+    auto copy = std::make_unique<PlanNode>();
+    copy->op = plan.op;
+    copy->table = plan.table;
+    copy->path = plan.path;
+    copy->columnCount = plan.columnCount;
+    copy->filter = plan.filter;
+    copy->keyIdx = plan.keyIdx;
+    copy->threads = plan.threads;
+    copy->buildLeft = plan.buildLeft;
+    copy->limit = plan.limit;
+    copy->offset = plan.offset;
+    copy->rows = plan.rows;
+    copy->bytes = plan.bytes;
+    copy->cost = plan.cost;
+    copy->detail = plan.detail;
+    for (const auto& child : plan.children) copy->children.push_back(clonePlan(*child));
+    return copy;
+}
+
+std::unique_ptr<PlanNode> planSelect(const SelectQuery& q, const std::vector<Column>& columns, const Catalog& catalog) {
+    auto def = catalog.getTable(q.table);
+    TableEstimate t = estimateTable(dataPath(catalog.root(), q.table), def ? def->stats : std::nullopt);
+    auto plan = planScan(q.table, columns, q.filter, t, catalog, false);
+
+    if (!q.aggregates.empty()) {
+        auto agg = makeNode(PlanOp::HashAggregate);
+        const PlanNode& scan = *plan;
+        agg->threads = scan.threads;
+        if (!q.groupBy.empty()) {
+            agg->detail = "group by ";
+            for (size_t i = 0; i < q.groupBy.size(); ++i) agg->detail += (i > 0 ? "," : "") + q.groupBy[i];
+            agg->detail += " ";
+        }
+        agg->detail += "agg ";
+        for (size_t i = 0; i < q.aggregates.size(); ++i) agg->detail += (i > 0 ? "," : "") + aggName(q.aggregates[i]);
+        double groups = 1;
+        for (int idx : q.groupByIdx) groups *= distinctValues(t, columns[idx].name, t.rows * kGroupFraction);
+        agg->rows = std::max(1.0, std::min(groups, scan.rows));
+        agg->bytes = agg->rows * kRowCost;
+        agg->cost = scan.cost + scan.rows * kRowCost / agg->threads;
+        agg->children.push_back(std::move(plan));
+        plan = std::move(agg);
+    }
+    return planOutput(std::move(plan), q);
+}
+
+std::unique_ptr<PlanNode> planJoin(const JoinQuery& q, const std::vector<Column>& leftColumns,
+                                   const std::vector<Column>& rightColumns, const Catalog& catalog) {
+    const SelectQuery& sel = q.select;
+    const int leftCount = static_cast<int>(q.leftColumnCount);
+    std::optional<Predicate> leftFilter, rightFilter;
+    if (sel.filter) {
+        Predicate p = *sel.filter;
+        if (p.columnIdx < leftCount) {
+            leftFilter = p;
+        } else {
+            p.columnIdx -= leftCount;
+            rightFilter = p;
+        }
+    }
+
+    auto leftDef = catalog.getTable(q.left);
+    auto rightDef = catalog.getTable(q.right);
+    TableEstimate lt = estimateTable(dataPath(catalog.root(), q.left), leftDef ? leftDef->stats : std::nullopt);
+    TableEstimate rt = estimateTable(dataPath(catalog.root(), q.right), rightDef ? rightDef->stats : std::nullopt);
+    auto left = planScan(q.left, leftColumns, leftFilter, lt, catalog, true);
+    auto right = planScan(q.right, rightColumns, rightFilter, rt, catalog, true);
+    left->keyIdx = q.leftKeyIdx;
+    right->keyIdx = q.rightKeyIdx;
+
+    const double memory = static_cast<double>(queryMemoryLimit());
+    const double scans = left->cost + right->cost;
+    DataType leftType = leftColumns[q.leftKeyIdx].type;
+    DataType rightType = rightColumns[q.rightKeyIdx].type;
+
+    auto join = makeNode(PlanOp::HashJoin);
+    join->cost = -1;
+    auto consider = [&](PlanOp op, bool buildLeft, double cost, size_t threads) {
+        if (join->cost >= 0 && cost >= join->cost) return;
+        join->op = op;
+        join->buildLeft = buildLeft;
+        join->cost = cost;
+        join->threads = threads;
+    };
+
+    for (bool buildLeft : {true, false}) {
+        const PlanNode& b = buildLeft ? *left : *right;
+        const PlanNode& p = buildLeft ? *right : *left;
+
+        // A filtered build side becomes a Bloom filter that drops probe rows
+        // whose key it cannot hold; assume those are the rows the filter removed.
+        double bloomCheck = b.filter ? p.rows * kBloomCheckCost : 0;
+        double buildTableRows = buildLeft ? lt.rows : rt.rows;
+        double probeRows = b.filter ? p.rows * std::min(1.0, b.rows / std::max(buildTableRows, 1.0)) : p.rows;
+
+        double table = b.bytes + b.rows * kHashRowBytes;
+        double probe = kHashProbeRow * (table > kCacheBytes ? kCacheMissFactor : 1);
+        double hash = scans + b.rows * kHashBuildRow + bloomCheck + probeRows * probe;
+        if (table > memory) hash += kSpillByteCost * (b.bytes + p.bytes * probeRows / std::max(p.rows, 1.0));
+        consider(PlanOp::HashJoin, buildLeft, hash, 1);
+
+        // Both sides are held as tuples plus their rows; past the budget the
+        // radix join gives up and the hash join runs after all. A table whose
+        // size could not be read is not assumed to fit.
+        double tuples = b.rows + probeRows;
+        double held = b.bytes + p.bytes * probeRows / std::max(p.rows, 1.0) + tuples * kRadixTupleBytes;
+        if (leftType == DataType::INT && rightType == DataType::INT && lt.sized && rt.sized && held <= memory) {
+            size_t threads = 1;
+            double work = scans + bloomCheck + tuples * kRadixTupleCost + b.rows * kRadixBuildCost;
+            consider(PlanOp::RadixJoin, buildLeft, parallelCost(work, true, threads), threads);
+        }
+    }
+
+    // Both tables clustered on their join keys: merge them as they stream in.
+    if (leftDef && rightDef && leftDef->clusteredBy == q.leftKey && rightDef->clusteredBy == q.rightKey &&
+        leftType == rightType) {
+        consider(PlanOp::MergeJoin, true, scans + (left->rows + right->rows) * kMergeRowCost, 1);
+    }
+
+    // Every key is assumed to find its partners on the side with more
+    // distinct keys. Without statistics each row's key counts as distinct, as
+    // for a foreign key into a primary key.
+    double leftKeys = distinctValues(lt, q.leftKey, lt.rows);
+    double rightKeys = distinctValues(rt, q.rightKey, rt.rows);
+    join->rows = left->rows * right->rows / std::max({leftKeys, rightKeys, 1.0});
+    double width = (left->rows > 0 ? left->bytes / left->rows : 0) + (right->rows > 0 ? right->bytes / right->rows : 0);
+    join->bytes = join->rows * width;
+    join->detail = q.left + "." + q.leftKey + " = " + q.right + "." + q.rightKey;
+    if (join->op != PlanOp::MergeJoin) {
+        const PlanNode& b = join->buildLeft ? *left : *right;
+        join->detail += ", build " + b.table;
+        if (b.filter) join->detail += " with Bloom filter";
+    }
+    join->children.push_back(std::move(left));
+    join->children.push_back(std::move(right));
+    return planOutput(std::move(join), sel);
+}
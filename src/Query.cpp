@@ -0,0 +1,263 @@
+#include "Query.hpp"
+#include "Utility.hpp"
+#include "ResultWriter.hpp"
+#include <cstdint>
+
+static int findColumn(const std::vector<Column>& columns, const std::string& name) {
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (columns[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool parseSelectClauses(const std::vector<std::string>& args, SelectQuery& q, std::string& error) {
+    size_t i = 0;
+    while (i < args.size()) {
+        const std::string& kw = args[i];
+        if (kw == "cols") {
+            if (i + 1 >= args.size() || !q.projection.empty()) {
+                error = "Invalid cols clause syntax.";
+                return false;
+            }
+            q.projection = split(args[i + 1], ',');
+            if (q.projection.empty()) {
+                error = "Invalid cols clause syntax.";
+                return false;
+            }
+            i += 2;
+        } else if (kw == "where") {
+            if (i + 3 >= args.size() || q.filter) {
+                error = "Invalid WHERE clause syntax.";
+                return false;
+            }
+            Predicate p;
+            p.column = args[i + 1];
+            p.op = args[i + 2];
+            p.value = args[i + 3];
+            p.parameter = p.value == "?";
+            if (p.op != "=" && p.op != "like") {
+                error = "Unsupported operator: " + p.op;
+                return false;
+            }
+            q.filter = p;
+            i += 4;
+        } else if (kw == "group") {
+            if (i + 2 >= args.size() || args[i + 1] != "by" || !q.groupBy.empty()) {
+                error = "Invalid GROUP BY clause syntax.";
+                return false;
+            }
+            q.groupBy = split(args[i + 2], ',');
+            if (q.groupBy.empty()) {
+                error = "Invalid GROUP BY clause syntax.";
+                return false;
+            }
+            i += 3;
+        } else if (kw == "agg") {
+            if (i + 1 >= args.size() || !q.aggregates.empty()) {
+                error = "Invalid agg clause syntax.";
+                return false;
+            }
+            for (const auto& item : split(args[i + 1], ',')) {
+                AggSpec a;
+                auto parts = split(item, ':');
+                if (parts.empty() || parts.size() > 2) {
+                    error = "Invalid aggregate: " + item;
+                    return false;
+                }
+                if (parts[0] == "count") a.func = AggFunc::COUNT;
+                else if (parts[0] == "sum") a.func = AggFunc::SUM;
+                else if (parts[0] == "avg") a.func = AggFunc::AVG;
+                else if (parts[0] == "min") a.func = AggFunc::MIN;
+                else if (parts[0] == "max") a.func = AggFunc::MAX;
+                else {
+                    error = "Unknown aggregate function: " + parts[0];
+                    return false;
+                }
+                if (parts.size() == 2) a.column = parts[1];
+                if (a.column.empty() && a.func != AggFunc::COUNT) {
+                    error = "Aggregate needs a column: " + item;
+                    return false;
+                }
+                q.aggregates.push_back(a);
+            }
+            if (q.aggregates.empty()) {
+                error = "Invalid agg clause syntax.";
+                return false;
+            }
+            i += 2;
+        } else if (kw == "order") {
+            if (i + 2 >= args.size() || args[i + 1] != "by" || !q.orderBy.empty()) {
+                error = "Invalid ORDER BY clause syntax.";
+                return false;
+            }
+            for (const auto& item : split(args[i + 2], ',')) {
+                auto parts = split(item, ':');
+                SortKey k;
+                if (parts.empty() || parts[0].empty() || parts.size() > 2) {
+                    error = "Invalid ORDER BY column: " + item;
+                    return false;
+                }
+                k.column = parts[0];
+                if (parts.size() == 2) {
+                    if (parts[1] == "desc") k.desc = true;
+                    else if (parts[1] != "asc") {
+                        error = "Invalid sort direction in: " + item + " (use asc/desc)";
+                        return false;
+                    }
+                }
+                q.orderBy.push_back(k);
+            }
+            if (q.orderBy.empty()) {
+                error = "Invalid ORDER BY clause syntax.";
+                return false;
+            }
+            i += 3;
+        } else if (kw == "limit" || kw == "offset") {
+            size_t n = 0;
+            bool ok = i + 1 < args.size() && !args[i + 1].empty();
+            for (size_t c = 0; ok && c < args[i + 1].size(); ++c) {
+                char ch = args[i + 1][c];
+                ok = ch >= '0' && ch <= '9' && n <= (SIZE_MAX - static_cast<size_t>(ch - '0')) / 10;
+                if (ok) n = n * 10 + static_cast<size_t>(ch - '0');
+            }
+            if (!ok) {
+                error = "Invalid " + kw + " clause syntax.";
+                return false;
+            }
+            if (kw == "limit") q.limit = n;
+            else q.offset = n;
+            i += 2;
+        } else if (kw == "format") {
+            if (i + 1 >= args.size() || !isResultFormat(args[i + 1])) {
+                error = "Invalid format (use box, csv, jsonl, bin or columns).";
+                return false;
+            }
+            q.format = args[i + 1];
+            i += 2;
+        } else {
+            error = "Unknown clause: " + kw;
+            return false;
+        }
+    }
+    if (!q.groupBy.empty() && q.aggregates.empty()) {
+        error = "GROUP BY needs an agg clause.";
+        return false;
+    }
+    if (!q.aggregates.empty() && !q.projection.empty()) {
+        error = "cols cannot be combined with agg; use group by.";
+        return false;
+    }
+    return true;
+}
+
+bool resolveSelect(SelectQuery& q, const std::vector<Column>& columns, std::string& error) {
+    q.projectionIdx.clear();
+    if (q.projection.empty()) {
+        for (size_t i = 0; i < columns.size(); ++i) q.projectionIdx.push_back(static_cast<int>(i));
+    } else {
+        for (const auto& name : q.projection) {
+            int idx = findColumn(columns, name);
+            if (idx == -1) {
+                error = "Column not found in schema: " + name;
+                return false;
+            }
+            q.projectionIdx.push_back(idx);
+        }
+    }
+
+    q.groupByIdx.clear();
+    for (const auto& name : q.groupBy) {
+        int idx = findColumn(columns, name);
+        if (idx == -1) {
+            error = "Column not found in schema: " + name;
+            return false;
+        }
+        q.groupByIdx.push_back(idx);
+    }
+
+    for (auto& a : q.aggregates) {
+        if (a.column.empty()) continue;
+        a.columnIdx = findColumn(columns, a.column);
+        if (a.columnIdx == -1) {
+            error = "Column not found in schema: " + a.column;
+            return false;
+        }
+        a.inputType = columns[a.columnIdx].type;
+        if ((a.func == AggFunc::SUM || a.func == AggFunc::AVG) && a.inputType == DataType::STRING) {
+            error = "Cannot compute " + aggName(a) + " over a string column.";
+            return false;
+        }
+    }
+
+    q.hiddenIdx.clear();
+    for (auto& k : q.orderBy) {
+        k.outputIdx = -1;
+        if (q.aggregates.empty()) {
+            int idx = findColumn(columns, k.column);
+            if (idx == -1) {
+                error = "Column not found in schema: " + k.column;
+                return false;
+            }
+            k.type = columns[idx].type;
+            for (size_t p = 0; p < q.projectionIdx.size(); ++p) {
+                if (q.projectionIdx[p] == idx) k.outputIdx = static_cast<int>(p);
+            }
+            for (size_t h = 0; h < q.hiddenIdx.size() && k.outputIdx == -1; ++h) {
+                if (q.hiddenIdx[h] == idx) k.outputIdx = static_cast<int>(q.projectionIdx.size() + h);
+            }
+            if (k.outputIdx == -1) {
+                k.outputIdx = static_cast<int>(q.projectionIdx.size() + q.hiddenIdx.size());
+                q.hiddenIdx.push_back(idx);
+            }
+        } else {
+            for (size_t g = 0; g < q.groupBy.size(); ++g) {
+                if (q.groupBy[g] == k.column) {
+                    k.outputIdx = static_cast<int>(g);
+                    k.type = columns[q.groupByIdx[g]].type;
+                }
+            }
+            for (size_t a = 0; a < q.aggregates.size() && k.outputIdx == -1; ++a) {
+                if (aggName(q.aggregates[a]) == k.column) {
+                    k.outputIdx = static_cast<int>(q.groupBy.size() + a);
+                    k.type = aggResultType(q.aggregates[a]);
+                }
+            }
+            if (k.outputIdx == -1) {
+                error = "ORDER BY must name a group by column or an aggregate: " + k.column;
+                return false;
+            }
+        }
+    }
+
+    if (q.filter) {
+        q.filter->columnIdx = findColumn(columns, q.filter->column);
+        if (q.filter->columnIdx == -1) {
+            error = "Column not found in schema: " + q.filter->column;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string aggName(const AggSpec& a) {
+    std::string fn;
+    switch (a.func) {
+        case AggFunc::COUNT: fn = "count"; break;
+        case AggFunc::SUM: fn = "sum"; break;
+        case AggFunc::AVG: fn = "avg"; break;
+        case AggFunc::MIN: fn = "min"; break;
+        case AggFunc::MAX: fn = "max"; break;
+    }
+    return a.column.empty() ? fn : fn + "(" + a.column + ")";
+}
+
+DataType aggResultType(const AggSpec& a) {
+    if (a.func == AggFunc::COUNT) return DataType::INT;
+    if (a.func == AggFunc::AVG) return DataType::FLOAT;
+    return a.inputType;
+}
+
+bool matches(const Predicate& p, std::string_view cell) {
+    if (p.op == "=") return cell == p.value;
+    return cell.find(p.value) != std::string_view::npos;
+}
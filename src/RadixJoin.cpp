@@ -0,0 +1,284 @@
+#include "RadixJoin.hpp"
+#include "Bloom.hpp"
+#include "DataType.hpp"
+#include "Hash.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+struct Tuple {
+    int64_t key;
+    uint64_t ref;   // chunk << kRefShift | row within the chunk
+};
+
+constexpr unsigned kRefShift = 40;
+constexpr uint64_t kRowMask = (uint64_t(1) << kRefShift) - 1;
+// Accounted per loaded row on top of its line: line offset, tuple and its partitioned copy.
+constexpr size_t kRowOverhead = sizeof(size_t) + 2 * sizeof(Tuple);
+// Build tuples per partition; with its bucket and chain arrays this keeps a
+// partition's hash table at a few hundred KiB.
+constexpr size_t kPartitionTuples = 8192;
+constexpr unsigned kMaxRadixBits = 12;
+// Partitions each worker may finish ahead of the one being emitted.
+constexpr size_t kEmitWindowPerThread = 4;
+
+constexpr uint32_t kNone = UINT32_MAX;
+constexpr size_t kTuplesPerLine = 64 / sizeof(Tuple);
+
+// Write-combining buffer: one cache line of tuples per partition, copied out
+// whole so scattering touches each destination line once instead of once per tuple.
+struct alignas(64) CacheLine {
+    Tuple tuples[kTuplesPerLine];
+};
+
+// Rows of one scan range: raw lines plus a (key, ref) tuple per row.
+struct Chunk {
+    std::string lines;
+    std::vector<size_t> lineEnds{0};
+    std::vector<Tuple> tuples;
+
+    std::string_view line(size_t r) const {
+        return std::string_view(lines).substr(lineEnds[r], lineEnds[r + 1] - lineEnds[r]);
+    }
+};
+
+// One side of the join after loading and partitioning.
+struct Side {
+    std::vector<Chunk> chunks;
+    std::vector<std::unique_ptr<MemoryReservation>> reservations;
+    std::vector<Tuple> partitioned;
+    std::vector<size_t> starts;     // partition p is partitioned[starts[p], starts[p + 1])
+
+    size_t tupleCount() const {
+        size_t n = 0;
+        for (const auto& c : chunks) n += c.tuples.size();
+        return n;
+    }
+
+    std::string_view line(uint64_t ref) const { return chunks[ref >> kRefShift].line(ref & kRowMask); }
+};
+
+inline size_t radixOf(int64_t key, unsigned bits) {
+    return bits == 0 ? 0 : static_cast<size_t>(mixHash(static_cast<uint64_t>(key)) >> (64 - bits));
+}
+
+// Scans an input in parallel ranges into side.chunks. Rows whose key misses
+// bloom are skipped before anything else is decoded. False if the budget ran out.
+bool loadSide(const JoinInput& in, const BloomFilter* bloom, size_t threads, Side& side, MemoryBudget& budget,
+              const MalformedFn& onMalformed) {
+    auto ranges = splitFile(in.path, threads);
+    side.chunks.resize(ranges.size());
+    for (size_t i = 0; i < ranges.size(); ++i) side.reservations.push_back(std::make_unique<MemoryReservation>(budget));
+
+    std::atomic<bool> exhausted{false};
+    std::mutex reportMutex;
+    auto report = [&](const std::string& line) {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        onMalformed(line);
+    };
+    parallelFor(ranges.size(), [&](size_t i) {
+        Chunk& chunk = side.chunks[i];
+        MemoryReservation& reservation = *side.reservations[i];
+        uint64_t read = 0;
+        forEachRowInRange(in.path, ranges[i], in.columnCount,
+            [&](RowView& row) {
+                ++read;
+                int64_t key;
+                if (!parseInt(row.field(in.keyIdx), key)) return true;
+                if (bloom && !bloom->mayContain(mixHash(static_cast<uint64_t>(key)))) return true;
+                if (in.filter && !matches(*in.filter, row.field(in.filter->columnIdx))) return true;
+                size_t rows = chunk.tuples.size() + 1;
+                if (!reservation.ensure(chunk.lines.size() + row.raw().size() + rows * kRowOverhead) ||
+                    exhausted.load(std::memory_order_relaxed)) {
+                    exhausted = true;
+                    return false;
+                }
+                chunk.tuples.push_back({key, (static_cast<uint64_t>(i) << kRefShift) | (chunk.lineEnds.size() - 1)});
+                chunk.lines.append(row.raw());
+                chunk.lineEnds.push_back(chunk.lines.size());
+                return true;
+            },
+            report);
+        if (in.counters) in.counters->add(read, chunk.tuples.size());
+    });
+    return !exhausted;
+}
+
+// Scatters every chunk's tuples into side.partitioned grouped by radix. Each
+// worker takes one chunk: a histogram pass, a prefix sum across workers that
+// gives each worker a private slice of every partition, then the scatter
+// through write-combining buffers.
+void partitionSide(Side& side, unsigned bits) {
+    const size_t parts = size_t(1) << bits;
+    const size_t workers = side.chunks.size();
+    std::vector<std::vector<size_t>> histograms(workers, std::vector<size_t>(parts, 0));
+
+    parallelFor(workers, [&](size_t w) {
+        for (const auto& t : side.chunks[w].tuples) ++histograms[w][radixOf(t.key, bits)];
+    });
+
+    side.starts.assign(parts + 1, 0);
+    std::vector<std::vector<size_t>> offsets(workers, std::vector<size_t>(parts));
+    size_t pos = 0;
+    for (size_t p = 0; p < parts; ++p) {
+        side.starts[p] = pos;
+        for (size_t w = 0; w < workers; ++w) {
+            offsets[w][p] = pos;
+            pos += histograms[w][p];
+        }
+    }
+    side.starts[parts] = pos;
+    side.partitioned.resize(pos);
+
+    parallelFor(workers, [&](size_t w) {
+        std::vector<CacheLine> buffers(parts);
+        std::vector<uint8_t> fill(parts, 0);
+        std::vector<size_t>& dest = offsets[w];
+        Tuple* out = side.partitioned.data();
+
+        for (const auto& t : side.chunks[w].tuples) {
+            size_t p = radixOf(t.key, bits);
+            buffers[p].tuples[fill[p]++] = t;
+            if (fill[p] == kTuplesPerLine) {
+                std::memcpy(out + dest[p], buffers[p].tuples, sizeof(CacheLine));
+                dest[p] += kTuplesPerLine;
+                fill[p] = 0;
+            }
+        }
+        for (size_t p = 0; p < parts; ++p) {
+            std::memcpy(out + dest[p], buffers[p].tuples, fill[p] * sizeof(Tuple));
+        }
+    });
+
+    for (auto& c : side.chunks) c.tuples = std::vector<Tuple>();
+}
+
+// Joins one partition pair into (build ref, probe ref) matches, in probe order.
+void joinPartition(const Side& build, const Side& probe, size_t p, std::vector<std::pair<uint64_t, uint64_t>>& out,
+                   std::vector<uint32_t>& heads, std::vector<uint32_t>& next) {
+    const Tuple* b = build.partitioned.data() + build.starts[p];
+    const size_t nb = build.starts[p + 1] - build.starts[p];
+    const Tuple* r = probe.partitioned.data() + probe.starts[p];
+    const size_t nr = probe.starts[p + 1] - probe.starts[p];
+    out.clear();
+    if (nb == 0 || nr == 0) return;
+
+    size_t buckets = 16;
+    while (buckets < nb * 2) buckets *= 2;
+    heads.assign(buckets, kNone);
+    next.resize(nb);
+    // Low hash bits pick the bucket; the top ones already picked the partition.
+    for (uint32_t i = static_cast<uint32_t>(nb); i-- > 0;) {
+        size_t h = mixHash(static_cast<uint64_t>(b[i].key)) & (buckets - 1);
+        next[i] = heads[h];
+        heads[h] = i;
+    }
+    for (size_t j = 0; j < nr; ++j) {
+        size_t h = mixHash(static_cast<uint64_t>(r[j].key)) & (buckets - 1);
+        for (uint32_t i = heads[h]; i != kNone; i = next[i]) {
+            if (b[i].key == r[j].key) out.emplace_back(b[i].ref, r[j].ref);
+        }
+    }
+}
+
+} // namespace
+
+bool radixJoin(const JoinInput& build, const JoinInput& probe, bool buildIsLeft, size_t threads,
+               const JoinEmit& emit, const MalformedFn& onMalformed, MemoryBudget& budget) {
+    threads = std::max<size_t>(threads, 1);
+
+    Side b, r;
+    if (!loadSide(build, nullptr, threads, b, budget, onMalformed)) return false;
+
+    // A filtered build side usually keeps few keys; a Bloom filter of them
+    // keeps most probe rows from being loaded and partitioned at all.
+    std::unique_ptr<BloomFilter> bloom;
+    MemoryReservation bloomReservation(budget);
+    if (build.filter && bloomReservation.ensure(BloomFilter::bytesFor(b.tupleCount()))) {
+        bloom = std::make_unique<BloomFilter>(b.tupleCount());
+        for (const auto& c : b.chunks) {
+            for (const auto& t : c.tuples) bloom->insert(mixHash(static_cast<uint64_t>(t.key)));
+        }
+    }
+    if (!loadSide(probe, bloom.get(), threads, r, budget, onMalformed)) return false;
+
+    unsigned bits = 0;
+    size_t buildTuples = b.tupleCount();
+    while ((buildTuples >> bits) > kPartitionTuples && bits < kMaxRadixBits) ++bits;
+    partitionSide(b, bits);
+    partitionSide(r, bits);
+
+    const size_t parts = size_t(1) << bits;
+    RowView buildRow, probeRow;
+    auto emitMatches = [&](const std::vector<std::pair<uint64_t, uint64_t>>& matches) {
+        for (const auto& m : matches) {
+            buildRow.reset(b.line(m.first));
+            probeRow.reset(r.line(m.second));
+            if (!(buildIsLeft ? emit(buildRow, probeRow) : emit(probeRow, buildRow))) return false;
+        }
+        return true;
+    };
+
+    if (threads == 1) {
+        std::vector<std::pair<uint64_t, uint64_t>> matches;
+        std::vector<uint32_t> heads, next;
+        for (size_t p = 0; p < parts; ++p) {
+            joinPartition(b, r, p, matches, heads, next);
+            if (!emitMatches(matches)) break;
+        }
+        return true;
+    }
+
+    // Workers claim partitions in order and may run at most a window ahead of
+    // the partition the calling thread is emitting, which bounds buffered matches.
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> results(parts);
+    std::vector<char> ready(parts, 0);
+    size_t claimed = 0, emitted = 0;
+    bool stop = false;
+    const size_t window = threads * kEmitWindowPerThread;
+
+    auto work = [&]() {
+        std::vector<uint32_t> heads, next;
+        std::vector<std::pair<uint64_t, uint64_t>> matches;
+        for (;;) {
+            size_t p;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return stop || claimed >= parts || claimed < emitted + window; });
+                if (stop || claimed >= parts) return;
+                p = claimed++;
+            }
+            joinPartition(b, r, p, matches, heads, next);
+            std::lock_guard<std::mutex> lock(mutex);
+            results[p].swap(matches);
+            ready[p] = 1;
+            changed.notify_all();
+        }
+    };
+    TaskGroup group;
+    for (size_t i = 0; i < threads; ++i) group.run(work);
+
+    for (size_t p = 0; p < parts; ++p) {
+        std::vector<std::pair<uint64_t, uint64_t>> matches;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return ready[p] != 0; });
+            matches.swap(results[p]);
+        }
+        bool more = emitMatches(matches);
+        std::lock_guard<std::mutex> lock(mutex);
+        emitted = p + 1;
+        if (!more) stop = true;
+        changed.notify_all();
+        if (!more) break;
+    }
+    group.wait();
+    return true;
+}
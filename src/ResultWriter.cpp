@@ -0,0 +1,330 @@
+#include "ResultWriter.hpp"
+#include <cmath>
+#include <cstring>
+
+BoxWriter::BoxWriter(std::ostream& out, size_t sampleRows) : buf(out), sampleRows(sampleRows) {}
+
+void BoxWriter::begin(const std::vector<ResultColumn>& columns) {
+    header.clear();
+    colWidths.clear();
+    for (const auto& col : columns) {
+        header.push_back(col.name);
+        colWidths.push_back(col.name.size());
+    }
+    sample.clear();
+    streaming = false;
+}
+
+void BoxWriter::row(const std::vector<std::string_view>& values) {
+    if (streaming) {
+        printRow(values);
+        return;
+    }
+
+    for (size_t i = 0; i < values.size() && i < colWidths.size(); ++i) {
+        if (values[i].size() > colWidths[i]) colWidths[i] = values[i].size();
+    }
+    sample.emplace_back(values.begin(), values.end());
+    if (sample.size() >= sampleRows) flushSample();
+}
+
+void BoxWriter::end() {
+    if (!streaming) flushSample();
+    printSeparator();
+    buf.flush();
+}
+
+void BoxWriter::flushSample() {
+    printSeparator();
+    std::vector<std::string_view> names(header.begin(), header.end());
+    printRow(names);
+    printSeparator();
+
+    std::vector<std::string_view> values;
+    for (const auto& r : sample) {
+        values.assign(r.begin(), r.end());
+        printRow(values);
+    }
+    sample.clear();
+    sample.shrink_to_fit();
+    streaming = true;
+}
+
+void BoxWriter::printSeparator() {
+    for (auto w : colWidths) {
+        buf.put('+');
+        buf.appendFill('-', w + 2);
+    }
+    buf.append("+\n");
+}
+
+void BoxWriter::printRow(const std::vector<std::string_view>& values) {
+    for (size_t i = 0; i < values.size(); ++i) {
+        buf.append("| ");
+        buf.append(values[i]);
+        if (values[i].size() < colWidths[i]) buf.appendFill(' ', colWidths[i] - values[i].size());
+        buf.put(' ');
+    }
+    buf.append("|\n");
+}
+
+void CsvWriter::begin(const std::vector<ResultColumn>& columns) {
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (i > 0) buf.put(',');
+        field(columns[i].name);
+    }
+    buf.put('\n');
+}
+
+void CsvWriter::row(const std::vector<std::string_view>& values) {
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) buf.put(',');
+        field(values[i]);
+    }
+    buf.put('\n');
+}
+
+void CsvWriter::end() {
+    buf.flush();
+}
+
+void CsvWriter::field(std::string_view v) {
+    if (v.find_first_of(",\"\r\n") == std::string_view::npos) {
+        buf.append(v);
+        return;
+    }
+    buf.put('"');
+    for (char c : v) {
+        if (c == '"') buf.put('"');
+        buf.put(c);
+    }
+    buf.put('"');
+}
+
+void JsonLinesWriter::begin(const std::vector<ResultColumn>& cols) {
+    columns = cols;
+}
+
+void JsonLinesWriter::row(const std::vector<std::string_view>& values) {
+    buf.put('{');
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) buf.put(',');
+        string(columns[i].name);
+        buf.put(':');
+
+        switch (columns[i].type) {
+            case DataType::INT: {
+                int64_t v;
+                if (parseInt(values[i], v)) buf.appendInt(v);
+                else buf.append("null");
+                break;
+            }
+            case DataType::FLOAT: {
+                double v;
+                if (parseFloat(values[i], v) && std::isfinite(v)) buf.appendFloat(v);
+                else buf.append("null");
+                break;
+            }
+            default:
+                string(values[i]);
+                break;
+        }
+    }
+    buf.append("}\n");
+}
+
+void JsonLinesWriter::end() {
+    buf.flush();
+}
+
+void JsonLinesWriter::string(std::string_view v) {
+    static const char hex[] = "0123456789abcdef";
+    buf.put('"');
+    size_t runStart = 0;
+    for (size_t i = 0; i < v.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(v[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        buf.append(v.substr(runStart, i - runStart));
+        runStart = i + 1;
+        switch (c) {
+            case '"': buf.append("\\\""); break;
+            case '\\': buf.append("\\\\"); break;
+            case '\n': buf.append("\\n"); break;
+            case '\r': buf.append("\\r"); break;
+            case '\t': buf.append("\\t"); break;
+            default:
+                buf.append("\\u00");
+                buf.put(hex[c >> 4]);
+                buf.put(hex[c & 0xF]);
+                break;
+        }
+    }
+    buf.append(v.substr(runStart));
+    buf.put('"');
+}
+
+static uint8_t binaryTypeCode(DataType t) {
+    switch (t) {
+        case DataType::INT: return 0;
+        case DataType::STRING: return 1;
+        case DataType::FLOAT: return 2;
+        default: return 1;
+    }
+}
+
+void BinaryWriter::begin(const std::vector<ResultColumn>& cols) {
+    columns = cols;
+    rowCount = 0;
+    buf.append("CDB1");
+    buf.appendU16(static_cast<uint16_t>(columns.size()));
+    for (const auto& col : columns) {
+        buf.appendU8(binaryTypeCode(col.type));
+        buf.appendU16(static_cast<uint16_t>(col.name.size()));
+        buf.append(col.name);
+    }
+}
+
+void BinaryWriter::row(const std::vector<std::string_view>& values) {
+    buf.appendU8(1);
+    for (size_t i = 0; i < values.size(); ++i) {
+        switch (columns[i].type) {
+            case DataType::INT: {
+                int64_t v;
+                if (parseInt(values[i], v)) {
+                    buf.appendU32(8);
+                    buf.appendU64(static_cast<uint64_t>(v));
+                } else {
+                    buf.appendU32(0);
+                }
+                break;
+            }
+            case DataType::FLOAT: {
+                double v;
+                if (parseFloat(values[i], v)) {
+                    uint64_t bits;
+                    std::memcpy(&bits, &v, sizeof bits);
+                    buf.appendU32(8);
+                    buf.appendU64(bits);
+                } else {
+                    buf.appendU32(0);
+                }
+                break;
+            }
+            default:
+                buf.appendU32(static_cast<uint32_t>(values[i].size()));
+                buf.append(values[i]);
+                break;
+        }
+    }
+    ++rowCount;
+}
+
+void BinaryWriter::end() {
+    buf.appendU8(0);
+    buf.appendU64(rowCount);
+    buf.flush();
+}
+
+void ColumnarWriter::begin(const std::vector<ResultColumn>& cols) {
+    columns = cols;
+    data.assign(columns.size(), ColumnData{});
+    rows = 0;
+    rowCount = 0;
+    buf.append("CDBC");
+    buf.appendU16(static_cast<uint16_t>(columns.size()));
+    for (const auto& col : columns) {
+        buf.appendU8(binaryTypeCode(col.type));
+        buf.appendU16(static_cast<uint16_t>(col.name.size()));
+        buf.append(col.name);
+    }
+}
+
+void ColumnarWriter::row(const std::vector<std::string_view>& values) {
+    if (rows % 8 == 0) {
+        for (auto& d : data) d.valid.push_back(0);
+    }
+    const uint8_t bit = static_cast<uint8_t>(1u << (rows % 8));
+    for (size_t i = 0; i < values.size(); ++i) {
+        ColumnData& d = data[i];
+        bool present = false;
+        uint64_t bits = 0;
+        switch (columns[i].type) {
+            case DataType::INT: {
+                int64_t v;
+                present = parseInt(values[i], v);
+                if (present) bits = static_cast<uint64_t>(v);
+                d.fixed.push_back(bits);
+                break;
+            }
+            case DataType::FLOAT: {
+                double v;
+                present = parseFloat(values[i], v);
+                if (present) std::memcpy(&bits, &v, sizeof bits);
+                d.fixed.push_back(bits);
+                break;
+            }
+            default:
+                present = !values[i].empty();
+                d.bytes.append(values[i]);
+                d.ends.push_back(static_cast<uint32_t>(d.bytes.size()));
+                break;
+        }
+        if (present) d.valid.back() |= bit;
+    }
+    if (++rows == kBatchRows) flushBatch();
+}
+
+void ColumnarWriter::flushBatch() {
+    if (rows == 0) return;
+    buf.appendU8(1);
+    buf.appendU32(static_cast<uint32_t>(rows));
+    for (size_t i = 0; i < columns.size(); ++i) {
+        ColumnData& d = data[i];
+        buf.appendRaw(d.valid.data(), d.valid.size());
+        if (columns[i].type == DataType::INT || columns[i].type == DataType::FLOAT) {
+            for (uint64_t v : d.fixed) buf.appendU64(v);
+        } else {
+            for (uint32_t e : d.ends) buf.appendU32(e);
+            buf.append(d.bytes);
+        }
+        d.valid.clear();
+        d.fixed.clear();
+        d.ends.clear();
+        d.bytes.clear();
+    }
+    rowCount += rows;
+    rows = 0;
+    buf.flush();
+}
+
+void ColumnarWriter::end() {
+    flushBatch();
+    buf.appendU8(0);
+    buf.appendU64(rowCount);
+    buf.flush();
+}
+
+void LimitWriter::row(const std::vector<std::string_view>& values) {
+    if (skipped < offset) {
+        ++skipped;
+        return;
+    }
+    if (emitted < limit) {
+        downstream->row(values);
+        ++emitted;
+    }
+}
+
+bool isResultFormat(const std::string& format) {
+    return format == "box" || format == "csv" || format == "jsonl" || format == "bin" || format == "columns";
+}
+
+std::unique_ptr<ResultWriter> makeResultWriter(const std::string& format, std::ostream& out) {
+    if (format == "box") return std::make_unique<BoxWriter>(out);
+    if (format == "csv") return std::make_unique<CsvWriter>(out);
+    if (format == "jsonl") return std::make_unique<JsonLinesWriter>(out);
+    if (format == "bin") return std::make_unique<BinaryWriter>(out);
+    if (format == "columns") return std::make_unique<ColumnarWriter>(out);
+    return nullptr;
+}
@@ -1,10 +1,28 @@
 #include "Schema.hpp"
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include "Utility.hpp"  
 
 using json = nlohmann::json;
 
+namespace {
+
+// Schemas already parsed by this process, by file path, reused while their
+// file is unchanged.
+struct SchemaCache {
+    std::mutex mutex;
+    std::map<std::string, std::pair<FileStamp, Schema>> tables;
+};
+
+SchemaCache& schemaCache() {
+    static SchemaCache cache;
+    return cache;
+}
+
+} // namespace
+
 Schema::Schema(const std::vector<Column>& cols) : columns(cols) {}
 
 void Schema::addColumn(const Column& col) {
@@ -15,8 +33,14 @@ const std::vector<Column>& Schema::getColumns() const {
     return columns;
 }
 
-bool Schema::saveToFile(const std::string& tableName) const {
-    std::ofstream out("metadata/" + tableName + ".meta");
+bool Schema::saveToFile(const std::string& root, const std::string& tableName) const {
+    const std::string path = metaPath(root, tableName);
+    {
+        SchemaCache& cache = schemaCache();
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.tables.erase(path);
+    }
+    std::ofstream out(path);
     if (!out.is_open()) return false;
 
     json j;
@@ -32,8 +56,17 @@ bool Schema::saveToFile(const std::string& tableName) const {
     return true;
 }
 
-Schema Schema::loadFromFile(const std::string& tableName) {
-    std::ifstream in("metadata/" + tableName + ".meta");
+Schema Schema::loadFromFile(const std::string& root, const std::string& tableName) {
+    const std::string path = metaPath(root, tableName);
+    SchemaCache& cache = schemaCache();
+    auto stamp = fileStamp(path);
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto it = cache.tables.find(path);
+        if (stamp && it != cache.tables.end() && it->second.first == *stamp) return it->second.second;
+    }
+
+    std::ifstream in(path);
     if (!in.is_open()) throw std::runtime_error("Schema file not found");
 
     json j;
@@ -47,5 +80,10 @@ Schema Schema::loadFromFile(const std::string& tableName) {
         cols.push_back(col);
     }
 
-    return Schema(cols);
+    Schema schema(cols);
+    if (stamp) {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.tables[path] = {*stamp, schema};
+    }
+    return schema;
 }
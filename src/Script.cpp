@@ -0,0 +1,163 @@
+#include "Script.hpp"
+#include "CommandHandler.hpp"
+#include "Utility.hpp"
+#include <filesystem>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// The files of the tables a script changed, as they were before its first
+// change to each. Most commands replace a data file by renaming a new file
+// over it, so a hard link keeps the old contents without copying them;
+// insert_karo appends in place, so for it the length is kept and the file cut
+// back to it. Metadata files are rewritten in place and are copied.
+class Transaction {
+public:
+    explicit Transaction(const std::string& root) : root(root), dataDir(databasePath(root, "data/")) {}
+
+    ~Transaction() {
+        std::error_code ec;
+        if (!dir.empty()) std::filesystem::remove_all(dir, ec);
+    }
+
+    // Saves what the command in args may change: its table's data and
+    // schema files and the catalog.
+    bool saveFor(const std::vector<std::string>& args, std::string& error) {
+        if (!save(databasePath(root, "metadata/catalog.meta"), false, error)) return false;
+        if (args.size() < 2) return true;
+        return save(dataPath(root, args[1]), args[0] == "insert_karo", error) &&
+               save(metaPath(root, args[1]), false, error);
+    }
+
+    // Puts every saved file back, and removes those that did not exist.
+    // Undone in reverse, so a file both appended to and replaced comes back
+    // through each of its states in turn.
+    bool rollback(std::string& error) {
+        bool ok = true;
+        for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+            std::error_code ec;
+            if (it->length) {
+                std::filesystem::resize_file(it->path, *it->length, ec);
+            } else if (it->copy) {
+                std::filesystem::rename(*it->copy, it->path, ec);
+                if (ec) {
+                    std::filesystem::copy_file(*it->copy, it->path,
+                                               std::filesystem::copy_options::overwrite_existing, ec);
+                }
+            } else {
+                std::filesystem::remove(it->path, ec);
+            }
+            if (ec) {
+                error = "Failed to restore " + it->path + ": " + ec.message();
+                ok = false;
+            }
+        }
+        saved.clear();
+        return ok;
+    }
+
+private:
+    struct Saved {
+        std::string path;
+        std::optional<std::string> copy;    // restored by renaming it back
+        std::optional<uintmax_t> length;    // restored by cutting the file to it
+    };                                      // neither: the file did not exist
+
+    // A file needs saving again only when the way it changes does: a copy
+    // or link does not survive appends to the same file, and a length does
+    // not survive the file being replaced.
+    bool save(const std::string& path, bool append, std::string& error) {
+        auto last = latest.find(path);
+        if (last != latest.end()) {
+            const Saved& s = saved[last->second];
+            if (!s.copy && !s.length) return true;
+            if (append ? s.length.has_value() : s.copy.has_value()) return true;
+        }
+        std::error_code ec;
+        Saved entry{path, std::nullopt, std::nullopt};
+        const bool exists = std::filesystem::exists(path, ec);
+        if (exists && append) {
+            entry.length = std::filesystem::file_size(path, ec);
+        } else if (exists) {
+            if (dir.empty()) {
+                dir = makeTempPath(root, "txn");
+                std::filesystem::create_directories(dir, ec);
+            }
+            std::string copy = dir + "/" + std::to_string(saved.size());
+            const bool data = path.rfind(dataDir, 0) == 0;
+            if (data) std::filesystem::create_hard_link(path, copy, ec);
+            if (ec || !data) {
+                ec.clear();
+                std::filesystem::copy_file(path, copy, ec);
+            }
+            entry.copy = copy;
+        }
+        if (ec) {
+            error = "Failed to save " + path + " for the transaction: " + ec.message();
+            return false;
+        }
+        latest[path] = saved.size();
+        saved.push_back(std::move(entry));
+        return true;
+    }
+
+    std::string root;
+    std::string dataDir;                    // files under it are linked, the rest copied
+    std::string dir;
+    std::vector<Saved> saved;
+    std::unordered_map<std::string, size_t> latest;   // path -> its last entry in saved
+};
+
+} // namespace
+
+bool runScript(const std::string& root, std::istream& script, const ScriptOptions& options, std::ostream& out,
+               std::ostream& err) {
+    Transaction transaction(root);
+    size_t lineNo = 0, applied = 0, failed = 0;
+    std::string line, error;
+    std::vector<std::string> args;
+    while (std::getline(script, line)) {
+        ++lineNo;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        bool ok = splitCommandLine(line, args, error);
+        if (ok && (args.empty() || args[0].rfind("#", 0) == 0)) continue;
+
+        if (!ok) {
+            out << "Line " << lineNo << ": " << error << "\n";
+        } else if (args[0] == "run" || args[0] == "serve" || args[0] == "client") {
+            out << "Line " << lineNo << ": " << args[0] << " is not available in a script.\n";
+            ok = false;
+        } else if (options.transaction && !CommandHandler::readOnly(args[0]) && !transaction.saveFor(args, error)) {
+            out << "Line " << lineNo << ": " << error << "\n";
+            ok = false;
+        } else {
+            args.insert(args.begin(), "cdb");
+            std::vector<char*> argv;
+            for (auto& a : args) argv.push_back(&a[0]);
+            argv.push_back(nullptr);
+            std::istringstream answers(options.yes ? "yes\n" : "");
+            ok = CommandHandler(root).execute(static_cast<int>(args.size()), argv.data(), out, err, answers);
+            if (!ok) out << "Line " << lineNo << " failed.\n";
+        }
+        if (ok) {
+            ++applied;
+            continue;
+        }
+
+        ++failed;
+        if (options.transaction) {
+            if (!transaction.rollback(error)) {
+                out << error << "\n";
+            } else {
+                out << "Rolled back " << applied << " command(s) before line " << lineNo << ".\n";
+            }
+            return false;
+        }
+    }
+    out.flush();
+    return failed == 0;
+}
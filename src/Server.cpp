@@ -0,0 +1,796 @@
+#include "Server.hpp"
+#include "CommandHandler.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#ifndef _WIN32
+  #include <arpa/inet.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+#ifdef __linux__
+  #include <csignal>
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+  #include <sys/signalfd.h>
+#endif
+
+namespace {
+
+// A request line longer than this closes the connection.
+constexpr size_t kMaxRequestBytes = 1 << 20;
+
+// Splits a request line on tabs; empty arguments are kept.
+std::vector<std::string> splitRequest(const std::string& line) {
+    std::vector<std::string> args;
+    size_t start = 0;
+    for (;;) {
+        size_t tab = line.find('\t', start);
+        args.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        if (tab == std::string::npos) return args;
+        start = tab + 1;
+    }
+}
+
+void appendU32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void appendU16(std::string& out, uint16_t v) {
+    out.push_back(static_cast<char>(v & 0xFF));
+    out.push_back(static_cast<char>(v >> 8));
+}
+
+uint32_t readU32(const char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+    return v;
+}
+
+std::string frameHeader(FrameType type, uint32_t requestId, size_t payloadBytes) {
+    std::string h;
+    appendU32(h, static_cast<uint32_t>(payloadBytes));
+    h.push_back(static_cast<char>(type));
+    appendU32(h, requestId);
+    return h;
+}
+
+void appendCommand(std::string& out, const std::vector<std::string>& args) {
+    appendU16(out, static_cast<uint16_t>(args.size()));
+    for (const auto& a : args) {
+        appendU32(out, static_cast<uint32_t>(a.size()));
+        out += a;
+    }
+}
+
+// Reads one Command payload off the front of payload.
+bool parseCommand(std::string_view& payload, std::vector<std::string>& args) {
+    if (payload.size() < 2) return false;
+    size_t argc = static_cast<uint8_t>(payload[0]) | (static_cast<size_t>(static_cast<uint8_t>(payload[1])) << 8);
+    payload.remove_prefix(2);
+    for (size_t i = 0; i < argc; ++i) {
+        if (payload.size() < 4) return false;
+        uint32_t len = readU32(payload.data());
+        payload.remove_prefix(4);
+        if (payload.size() < len) return false;
+        args.emplace_back(payload.substr(0, len));
+        payload.remove_prefix(len);
+    }
+    return argc > 0;
+}
+
+#ifndef _WIN32
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readExact(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+int connectTo(const ServerAddress& address, std::string& error) {
+    int fd = -1;
+    if (address.port != 0) {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(address.port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return fd;
+        }
+        error = "Cannot connect to 127.0.0.1:" + std::to_string(address.port) + ": " + std::strerror(errno);
+    } else {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (address.socketPath.size() >= sizeof(addr.sun_path)) {
+            error = "Socket path is too long: " + address.socketPath;
+            return -1;
+        }
+        std::memcpy(addr.sun_path, address.socketPath.c_str(), address.socketPath.size() + 1);
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return fd;
+        error = "Cannot connect to " + address.socketPath + ": " + std::strerror(errno);
+    }
+    if (fd >= 0) ::close(fd);
+    return -1;
+}
+
+#endif
+
+#ifdef __linux__
+
+// Reply bytes a worker produced for one connection, waiting for the event
+// loop to send them. A worker blocks while kMaxPendingBytes are queued, and
+// it does so holding its command's lock on the tables, so a client that
+// stops reading holds up every command that needs that lock. One that takes
+// nothing for CDB_SERVER_STALL_SECONDS (default 30) is disconnected; its
+// command runs on with the output dropped and lets go of the lock.
+constexpr size_t kMaxPendingBytes = 4 << 20;
+
+struct Outbox {
+    std::mutex mutex;
+    std::condition_variable drained;
+    std::string pending;
+    bool finished = false;    // the request being run is complete
+    bool closed = false;      // the connection is gone; further output is dropped
+    bool stalled = false;     // closed by a worker because the client stopped reading
+};
+
+// One request for the workers: a text command line, or the commands of a
+// binary Command or Batch frame.
+struct Job {
+    uint64_t connection;
+    std::shared_ptr<Outbox> outbox;
+    bool binary = false;
+    uint32_t requestId = 0;
+    std::vector<std::vector<std::string>> commands;
+};
+
+struct Connection {
+    enum class Mode { Unknown, Text, Binary };
+
+    int fd = -1;
+    Mode mode = Mode::Unknown;
+    std::string in;           // received, not yet taken as a request
+    std::string out;          // reply bytes being sent
+    size_t sent = 0;
+    bool busy = false;        // a request is with the workers
+    bool closing = false;     // the peer stopped sending; close once its requests are answered
+    bool watchingOut = false; // EPOLLOUT registered
+    bool watched = true;      // in the epoll set
+    std::shared_ptr<Outbox> outbox = std::make_shared<Outbox>();
+};
+
+// epoll tags below kFirstConnection are the server's own descriptors.
+enum : uint64_t { kUnixListener, kTcpListener, kWakeup, kSignals, kFirstConnection = 16 };
+
+// Output of one request as frames of a single type, cut whenever the buffer
+// reaches kChunk bytes or the stream is flushed.
+class FrameStream : public std::streambuf {
+public:
+    static constexpr size_t kChunk = 64 << 10;
+
+    FrameStream(FrameType type, uint32_t requestId, std::function<void(std::string)> sink)
+        : type(type), requestId(requestId), sink(std::move(sink)) {}
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (ch != traits_type::eof()) buffer.push_back(static_cast<char>(ch));
+        if (buffer.size() >= kChunk) emit();
+        return traits_type::not_eof(ch);
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        buffer.append(s, static_cast<size_t>(n));
+        if (buffer.size() >= kChunk) emit();
+        return n;
+    }
+    int sync() override {
+        emit();
+        return 0;
+    }
+
+private:
+    void emit() {
+        if (buffer.empty()) return;
+        sink(frameHeader(type, requestId, buffer.size()) + buffer);
+        buffer.clear();
+    }
+
+    FrameType type;
+    uint32_t requestId;
+    std::function<void(std::string)> sink;
+    std::string buffer;
+};
+
+class Server {
+public:
+    explicit Server(std::string root) : root(std::move(root)), stallTimeout(envSize("CDB_SERVER_STALL_SECONDS", 30)) {}
+    ~Server() {
+        for (int fd : {unixFd, tcpFd, wakeFd, signalFd, epollFd}) {
+            if (fd >= 0) ::close(fd);
+        }
+        if (unixFd >= 0) ::unlink(socketPath.c_str());
+    }
+
+    bool listenOn(const ServerAddress& address, std::string& error);
+    void run(size_t workers);
+
+private:
+    bool watch(int fd, uint64_t tag, uint32_t events, int op = EPOLL_CTL_ADD) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = tag;
+        return ::epoll_ctl(epollFd, op, fd, &ev) == 0;
+    }
+
+    // Event loop side.
+    void accept(int listener, bool tcp);
+    void receive(uint64_t id);
+    void flush(uint64_t id);
+    bool takePending(Connection& c);
+    void dispatch(uint64_t id);
+    bool nextRequest(uint64_t id, Connection& c, Job& job);
+    void settle(uint64_t id);
+    void close(uint64_t id);
+
+    // Worker side.
+    void work();
+    void run(const Job& job);
+    void post(const Job& job, std::string bytes, bool finished);
+    void execute(const std::vector<std::string>& command, std::ostream& out, std::ostream& err);
+
+    std::string root;               // the database served
+    std::string socketPath;
+    int unixFd = -1, tcpFd = -1, wakeFd = -1, signalFd = -1, epollFd = -1;
+    uint64_t nextId = kFirstConnection;
+    std::unordered_map<uint64_t, Connection> connections;
+
+    std::mutex queueMutex;
+    std::condition_variable queued;
+    std::deque<Job> jobs;
+    bool stopping = false;
+    std::mutex readyMutex;
+    std::vector<uint64_t> ready;    // connections whose outbox changed
+
+    // Held shared by read-only commands and exclusively by the rest.
+    std::shared_mutex tables;
+    std::chrono::seconds stallTimeout;
+};
+
+bool Server::listenOn(const ServerAddress& address, std::string& error) {
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        error = std::string("Cannot create the event loop: ") + std::strerror(errno);
+        return false;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (address.socketPath.size() >= sizeof(addr.sun_path)) {
+        error = "Socket path is too long: " + address.socketPath;
+        return false;
+    }
+    std::memcpy(addr.sun_path, address.socketPath.c_str(), address.socketPath.size() + 1);
+    // A socket file nobody accepts on is left over from a server that died.
+    struct stat st;
+    if (::stat(address.socketPath.c_str(), &st) == 0) {
+        std::string probeError;
+        int probe = S_ISSOCK(st.st_mode) ? connectTo({address.socketPath, 0}, probeError) : -1;
+        if (probe >= 0) ::close(probe);
+        if (!S_ISSOCK(st.st_mode) || probe >= 0) {
+            error = S_ISSOCK(st.st_mode) ? "A server is already listening on " + address.socketPath
+                                         : address.socketPath + " exists and is not a socket.";
+            return false;
+        }
+        ::unlink(address.socketPath.c_str());
+    }
+
+    unixFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (unixFd < 0 || ::bind(unixFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(unixFd, SOMAXCONN) != 0) {
+        error = "Cannot listen on " + address.socketPath + ": " + std::strerror(errno);
+        return false;
+    }
+    socketPath = address.socketPath;
+
+    if (address.port != 0) {
+        tcpFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (tcpFd >= 0) ::setsockopt(tcpFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in in{};
+        in.sin_family = AF_INET;
+        in.sin_port = htons(address.port);
+        in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (tcpFd < 0 || ::bind(tcpFd, reinterpret_cast<sockaddr*>(&in), sizeof(in)) != 0 ||
+            ::listen(tcpFd, SOMAXCONN) != 0) {
+            error = "Cannot listen on 127.0.0.1:" + std::to_string(address.port) + ": " + std::strerror(errno);
+            return false;
+        }
+    }
+
+    // SIGINT and SIGTERM arrive through the loop; threads started from here
+    // on inherit the blocked mask, so none of them is interrupted instead.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    ::pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    signalFd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    bool ok = watch(unixFd, kUnixListener, EPOLLIN) && watch(wakeFd, kWakeup, EPOLLIN) &&
+              (signalFd < 0 || watch(signalFd, kSignals, EPOLLIN)) && (tcpFd < 0 || watch(tcpFd, kTcpListener, EPOLLIN));
+    if (!ok) error = std::string("Cannot watch the listening sockets: ") + std::strerror(errno);
+    return ok;
+}
+
+void Server::run(size_t workers) {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); ++i) threads.emplace_back([this] { work(); });
+
+    constexpr int kMaxEvents = 64;
+    epoll_event events[kMaxEvents];
+    bool running = true;
+    while (running) {
+        int n = ::epoll_wait(epollFd, events, kMaxEvents, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            uint64_t tag = events[i].data.u64;
+            uint32_t ev = events[i].events;
+            if (tag == kUnixListener) {
+                accept(unixFd, false);
+            } else if (tag == kTcpListener) {
+                accept(tcpFd, true);
+            } else if (tag == kWakeup) {
+                uint64_t count;
+                while (::read(wakeFd, &count, sizeof(count)) > 0) {}
+                std::vector<uint64_t> changed;
+                {
+                    std::lock_guard<std::mutex> lock(readyMutex);
+                    changed.swap(ready);
+                }
+                for (uint64_t id : changed) flush(id);
+            } else if (tag == kSignals) {
+                running = false;
+            } else {
+                if (ev & EPOLLOUT) flush(tag);
+                if (ev & (EPOLLIN | EPOLLHUP | EPOLLERR)) receive(tag);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+        jobs.clear();
+    }
+    queued.notify_all();
+    while (!connections.empty()) close(connections.begin()->first);    // unblocks workers waiting to post
+    for (auto& t : threads) t.join();
+}
+
+void Server::accept(int listener, bool tcp) {
+    for (;;) {
+        int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;    // EAGAIN, or out of descriptors until a connection closes
+        }
+        if (tcp) {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        uint64_t id = nextId++;
+        if (!watch(fd, id, EPOLLIN | EPOLLRDHUP)) {
+            ::close(fd);
+            continue;
+        }
+        connections[id].fd = fd;
+    }
+}
+
+void Server::receive(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) return;
+    Connection& c = it->second;
+    char buf[64 << 10];
+    for (;;) {
+        ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            c.in.append(buf, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        c.closing = true;    // orderly shutdown or a reset
+        break;
+    }
+    // A peer that only shut down its sending side still gets its replies.
+    dispatch(id);
+    settle(id);
+}
+
+// Sends the reply bytes the workers have posted for a connection, for as
+// long as the socket takes them. When the running request is complete the
+// next one, if it already arrived, goes to the workers.
+void Server::flush(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) return;
+    Connection& c = it->second;
+    {
+        std::unique_lock<std::mutex> lock(c.outbox->mutex);
+        if (c.outbox->stalled) {
+            lock.unlock();
+            close(id);
+            return;
+        }
+    }
+    do {
+        while (c.sent < c.out.size()) {
+            ssize_t n = ::send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                c.sent += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                c.watchingOut = true;
+                settle(id);
+                return;
+            }
+            close(id);
+            return;
+        }
+        c.out.clear();
+        c.sent = 0;
+    } while (takePending(c));
+    c.watchingOut = false;
+    dispatch(id);
+    settle(id);
+}
+
+// Moves what the worker posted into c.out; false if there was nothing.
+bool Server::takePending(Connection& c) {
+    Outbox& box = *c.outbox;
+    std::lock_guard<std::mutex> lock(box.mutex);
+    c.out.swap(box.pending);
+    if (box.finished) {
+        box.finished = false;
+        c.busy = false;
+    }
+    box.drained.notify_all();
+    return !c.out.empty();
+}
+
+void Server::dispatch(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) return;
+    Connection& c = it->second;
+    Job job;
+    while (!c.busy && nextRequest(id, c, job)) {
+        c.busy = true;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            jobs.push_back(std::move(job));
+        }
+        queued.notify_one();
+        job = Job{};
+    }
+}
+
+// Takes the next complete request off c.in. A malformed frame ends the
+// connection.
+bool Server::nextRequest(uint64_t id, Connection& c, Job& job) {
+    if (c.mode == Connection::Mode::Unknown) {
+        size_t n = std::min(c.in.size(), sizeof(kProtocolMagic));
+        bool magic = std::memcmp(c.in.data(), kProtocolMagic, n) == 0;
+        if (magic && n < sizeof(kProtocolMagic)) return false;
+        c.mode = magic ? Connection::Mode::Binary : Connection::Mode::Text;
+        if (magic) c.in.erase(0, sizeof(kProtocolMagic));
+    }
+    job.connection = id;
+    job.outbox = c.outbox;
+
+    if (c.mode == Connection::Mode::Text) {
+        for (;;) {
+            size_t newline = c.in.find('\n');
+            if (newline == std::string::npos) {
+                if (c.in.size() > kMaxRequestBytes) {
+                    c.in.clear();
+                    c.closing = true;
+                }
+                return false;
+            }
+            std::string line = c.in.substr(0, newline);
+            c.in.erase(0, newline + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            job.commands.push_back(splitRequest(line));
+            return true;
+        }
+    }
+
+    const size_t header = 9;
+    if (c.in.size() < header) return false;
+    uint32_t length = readU32(c.in.data());
+    if (length > kMaxFrameBytes) {
+        c.in.clear();
+        c.closing = true;
+        return false;
+    }
+    if (c.in.size() < header + length) return false;
+    auto type = static_cast<FrameType>(static_cast<uint8_t>(c.in[4]));
+    job.binary = true;
+    job.requestId = readU32(c.in.data() + 5);
+    std::string_view payload(c.in.data() + header, length);
+    bool ok = false;
+    if (type == FrameType::Command) {
+        job.commands.emplace_back();
+        ok = parseCommand(payload, job.commands.back()) && payload.empty();
+    } else if (type == FrameType::Batch && payload.size() >= 4) {
+        uint32_t count = readU32(payload.data());
+        payload.remove_prefix(4);
+        ok = true;
+        for (uint32_t i = 0; ok && i < count; ++i) {
+            job.commands.emplace_back();
+            ok = parseCommand(payload, job.commands.back());
+        }
+        ok = ok && payload.empty();
+    }
+    c.in.erase(0, header + length);
+    if (!ok) {
+        c.in.clear();
+        c.closing = true;
+    }
+    return ok;
+}
+
+// Closes a connection that hung up and has nothing left in flight, otherwise
+// watches it for what it waits on: more requests unless the peer stopped
+// sending, and room to write while a reply is pending.
+void Server::settle(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) return;
+    Connection& c = it->second;
+    if (c.closing && !c.busy && c.out.empty()) {
+        close(id);
+        return;
+    }
+    uint32_t events = (c.closing ? 0u : static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP)) |
+                      (c.watchingOut ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    if (events == 0) {
+        // Only the worker's post can move it on, and that wakes the loop. A
+        // peer that hung up is reported (EPOLLHUP) whatever the mask, so the
+        // fd leaves the set rather than waking the loop until the worker is done.
+        if (c.watched) ::epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+        c.watched = false;
+        return;
+    }
+    watch(c.fd, id, events, c.watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD);
+    c.watched = true;
+}
+
+void Server::close(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) return;
+    {
+        Outbox& box = *it->second.outbox;
+        std::lock_guard<std::mutex> lock(box.mutex);
+        box.closed = true;
+        box.pending.clear();
+        box.drained.notify_all();
+    }
+    if (it->second.watched) ::epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    ::close(it->second.fd);
+    connections.erase(it);
+}
+
+void Server::work() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queued.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        run(job);
+    }
+}
+
+void Server::run(const Job& job) {
+    if (!job.binary) {
+        std::ostringstream out, err;
+        execute(job.commands.front(), out, err);
+        std::string o = out.str(), e = err.str();
+        post(job, std::to_string(o.size()) + " " + std::to_string(e.size()) + "\n" + o + e, true);
+        return;
+    }
+
+    auto sink = [&](std::string frame) { post(job, std::move(frame), false); };
+    FrameStream outFrames(FrameType::Data, job.requestId, sink);
+    FrameStream errFrames(FrameType::Warning, job.requestId, sink);
+    std::ostream out(&outFrames), err(&errFrames);
+    for (const auto& command : job.commands) {
+        execute(command, out, err);
+        out.flush();
+        err.flush();
+    }
+    std::string done = frameHeader(FrameType::Done, job.requestId, 4);
+    appendU32(done, static_cast<uint32_t>(job.commands.size()));
+    post(job, std::move(done), true);
+}
+
+void Server::post(const Job& job, std::string bytes, bool finished) {
+    Outbox& box = *job.outbox;
+    {
+        std::unique_lock<std::mutex> lock(box.mutex);
+        if (!box.drained.wait_for(lock, stallTimeout, [&] { return box.closed || box.pending.size() < kMaxPendingBytes; })) {
+            // Tell the event loop to drop the connection.
+            box.closed = box.stalled = true;
+            box.pending.clear();
+        } else if (box.closed) {
+            return;
+        } else {
+            box.pending += bytes;
+            if (finished) box.finished = true;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        ready.push_back(job.connection);
+    }
+    uint64_t one = 1;
+    ssize_t written = ::write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+void Server::execute(const std::vector<std::string>& command, std::ostream& out, std::ostream& err) {
+    if (command.empty() || command.front() == "serve" || command.front() == "client" || command.front() == "run") {
+        out << (command.empty() ? "" : command.front()) << " is not available through the server.\n";
+        return;
+    }
+    std::vector<std::string> args = command;
+    args.insert(args.begin(), "cdb");
+    std::vector<char*> argv;
+    for (auto& a : args) argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+    // Nobody is there to answer delete_karo or drop_kro_table; an empty stream cancels them.
+    std::istringstream noAnswers;
+    try {
+        if (CommandHandler::readOnly(command.front())) {
+            std::shared_lock<std::shared_mutex> lock(tables);
+            CommandHandler(root).execute(static_cast<int>(args.size()), argv.data(), out, err, noAnswers);
+        } else {
+            std::unique_lock<std::shared_mutex> lock(tables);
+            CommandHandler(root).execute(static_cast<int>(args.size()), argv.data(), out, err, noAnswers);
+        }
+    } catch (const std::exception& e) {
+        err << "Command failed: " << e.what() << "\n";
+    }
+}
+
+#endif
+
+} // namespace
+
+bool runServer(const std::string& root, const ServerAddress& address, size_t workers, std::string& error) {
+#ifdef __linux__
+    Server server(root);
+    if (!server.listenOn(address, error)) return false;
+    std::cout << "Serving on " << address.socketPath;
+    if (address.port != 0) std::cout << " and 127.0.0.1:" << address.port;
+    std::cout << " with " << workers << " worker(s)." << std::endl;
+    server.run(workers);
+    return true;
+#else
+    (void)root;
+    (void)address;
+    (void)workers;
+    error = "cdb serve needs Linux (epoll).";
+    return false;
+#endif
+}
+
+bool runClient(const ServerAddress& address, const std::vector<std::vector<std::string>>& commands, bool batch,
+               std::ostream& out, std::ostream& err, std::string& error) {
+#ifndef _WIN32
+    if (commands.empty()) return true;
+    std::vector<std::string> requests;
+    if (batch) {
+        std::string payload;
+        appendU32(payload, static_cast<uint32_t>(commands.size()));
+        for (const auto& c : commands) appendCommand(payload, c);
+        requests.push_back(frameHeader(FrameType::Batch, 1, payload.size()) + payload);
+    } else {
+        for (size_t i = 0; i < commands.size(); ++i) {
+            std::string payload;
+            appendCommand(payload, commands[i]);
+            requests.push_back(frameHeader(FrameType::Command, static_cast<uint32_t>(i + 1), payload.size()) + payload);
+        }
+    }
+
+    int fd = connectTo(address, error);
+    if (fd < 0) return false;
+    // Requests go out from a second thread while replies are read here, so
+    // neither side waits for the other.
+    std::thread sender([&] {
+        bool ok = writeAll(fd, kProtocolMagic, sizeof(kProtocolMagic));
+        for (size_t i = 0; ok && i < requests.size(); ++i) ok = writeAll(fd, requests[i].data(), requests[i].size());
+        ::shutdown(fd, SHUT_WR);
+    });
+
+    size_t done = 0;
+    char header[9];
+    std::string payload;
+    bool ok = true;
+    while (done < requests.size() && (ok = readExact(fd, header, sizeof(header)))) {
+        uint32_t length = readU32(header);
+        if (length > kMaxFrameBytes) {
+            ok = false;
+            break;
+        }
+        payload.resize(length);
+        if (!(ok = readExact(fd, &payload[0], length))) break;
+        switch (static_cast<FrameType>(static_cast<uint8_t>(header[4]))) {
+            case FrameType::Data: out.write(payload.data(), static_cast<std::streamsize>(length)); break;
+            case FrameType::Warning: err.write(payload.data(), static_cast<std::streamsize>(length)); break;
+            case FrameType::Done: ++done; break;
+            default: break;
+        }
+    }
+    ::shutdown(fd, SHUT_RDWR);
+    sender.join();
+    ::close(fd);
+    if (!ok) error = "The server closed the connection before every reply arrived.";
+    return ok;
+#else
+    (void)address;
+    (void)commands;
+    (void)batch;
+    (void)out;
+    (void)err;
+    error = "cdb client needs Unix domain sockets.";
+    return false;
+#endif
+}
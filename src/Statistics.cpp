@@ -0,0 +1,359 @@
+#include "Statistics.hpp"
+#include "ExternalSort.hpp"
+#include "Hash.hpp"
+#include "Planner.hpp"
+#include "TableScan.hpp"
+#include "ThreadPool.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
+namespace {
+
+constexpr double kSampleRows = 30000;
+constexpr size_t kHistogramBuckets = 32;
+constexpr size_t kCommonValues = 10;
+// A sampled value is common when it shows up this much more often than the average value.
+constexpr double kCommonFactor = 1.25;
+// Analyze again once this many rows plus this fraction of the table changed.
+constexpr uint64_t kStaleRows = 50;
+constexpr double kStaleFraction = 0.1;
+
+struct ColumnScan {
+    uint64_t nulls = 0;
+    std::string min, max;
+    std::string minKey, maxKey;
+    bool any = false;
+    HyperLogLog sketch;
+    std::vector<std::string> sample;    // non-empty cells of the sampled rows
+};
+
+// What one worker saw of the morsels it pulled.
+struct PartialStats {
+    uint64_t rows = 0;
+    uint64_t sampled = 0;
+    std::vector<ColumnScan> columns;
+};
+
+std::string keyOf(std::string_view value, DataType type) {
+    std::string key;
+    appendSortKey(key, value, type, false);
+    return key;
+}
+
+void finishColumn(ColumnScan& scan, const Column& column, uint64_t rows, uint64_t sampled, ColumnStats& out) {
+    out.column = column.name;
+    out.nulls = scan.nulls;
+    out.min = scan.min;
+    out.max = scan.max;
+    out.sketch = scan.sketch;
+    out.distinct = scan.any ? std::max(1.0, scan.sketch.estimate()) : 0;
+
+    auto& values = scan.sample;
+    if (values.empty()) return;
+
+    std::vector<std::pair<std::string, size_t>> keyed;
+    keyed.reserve(values.size());
+    for (size_t i = 0; i < values.size(); ++i) keyed.emplace_back(keyOf(values[i], column.type), i);
+    std::sort(keyed.begin(), keyed.end());
+
+    size_t n = keyed.size();
+    size_t buckets = std::min(kHistogramBuckets, n);
+    for (size_t b = 0; b <= buckets; ++b) {
+        out.histogram.push_back(values[keyed[b * (n - 1) / buckets].second]);
+    }
+
+    std::unordered_map<std::string_view, size_t> counts;
+    for (const auto& v : values) ++counts[v];
+    std::vector<std::pair<size_t, std::string_view>> ranked;
+    for (const auto& c : counts) ranked.emplace_back(c.second, c.first);
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    // With few distinct values all of them are kept; otherwise only the ones
+    // clearly more frequent than average, and seen often enough that their
+    // sampled frequency has a relative error below about 20%.
+    double average = static_cast<double>(n) / ranked.size();
+    double N = static_cast<double>(rows), m = static_cast<double>(sampled);
+    double minCount = N > m ? m * (N - m) / (N - m + 0.04 * m * (N - 1)) : 0;
+    for (const auto& r : ranked) {
+        if (out.common.size() == kCommonValues || r.first < 2 || r.first < minCount) break;
+        if (ranked.size() > kCommonValues && r.first < kCommonFactor * average) break;
+        out.common.emplace_back(std::string(r.second), static_cast<double>(r.first) / sampled);
+    }
+}
+
+} // namespace
+
+void HyperLogLog::add(uint64_t hash) {
+    size_t index = static_cast<size_t>(hash >> (64 - kBits));
+    uint64_t rest = (hash << kBits) | (uint64_t(1) << (kBits - 1));
+    uint8_t rank = 1;
+    while ((rest & (uint64_t(1) << 63)) == 0) {
+        rest <<= 1;
+        ++rank;
+    }
+    registers[index] = std::max(registers[index], rank);
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    for (size_t i = 0; i < registers.size(); ++i) registers[i] = std::max(registers[i], other.registers[i]);
+}
+
+double HyperLogLog::estimate() const {
+    const double m = static_cast<double>(registers.size());
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t r : registers) {
+        sum += std::ldexp(1.0, -r);
+        if (r == 0) ++zeros;
+    }
+    double raw = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // Small cardinalities: linear counting over the empty registers is more accurate.
+    if (raw <= 2.5 * m && zeros > 0) return m * std::log(m / zeros);
+    return raw;
+}
+
+std::string HyperLogLog::encode() const {
+    static const char* digits = "0123456789abcdef";
+    std::string out;
+    out.reserve(registers.size() * 2);
+    for (uint8_t r : registers) {
+        out.push_back(digits[r >> 4]);
+        out.push_back(digits[r & 15]);
+    }
+    return out;
+}
+
+bool HyperLogLog::decode(const std::string& hex) {
+    if (hex.size() != registers.size() * 2) return false;
+    auto nibble = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    };
+    for (size_t i = 0; i < registers.size(); ++i) {
+        int hi = nibble(hex[2 * i]), lo = nibble(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        registers[i] = static_cast<uint8_t>(hi * 16 + lo);
+    }
+    return true;
+}
+
+const ColumnStats* TableStats::column(const std::string& name) const {
+    for (const auto& c : columns) {
+        if (c.column == name) return &c;
+    }
+    return nullptr;
+}
+
+double TableStats::estimateRows(uint64_t bytesNow) const {
+    if (bytes == 0) return static_cast<double>(rows);
+    return static_cast<double>(rows) * bytesNow / bytes;
+}
+
+bool analyzeTable(const std::string& path, const std::vector<Column>& columns, TableStats& stats,
+                  const std::function<void(const std::string&)>& onMalformed, std::string& error) {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        error = "Failed to open data file: " + path;
+        return false;
+    }
+    size_t threads = size < kParallelScanMinBytes ? 1 : workerThreads();
+    double rate = std::min(1.0, kSampleRows / std::max(estimateTable(path).rows, 1.0));
+
+    std::vector<PartialStats> partials(threads);
+    for (auto& p : partials) p.columns.resize(columns.size());
+    MorselDispenser dispenser(ByteRange{0, size}, kMorselBytes);
+    std::mutex reportMutex;
+    auto report = [&](const std::string& line) {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        onMalformed(line);
+    };
+
+    parallelFor(threads, [&](size_t w) {
+        PartialStats& part = partials[w];
+        std::ifstream in(path, std::ios::binary);
+        std::string key;
+        size_t index;
+        ByteRange morsel;
+        while (dispenser.next(index, morsel)) {
+            // Seeded by morsel, so the sample does not depend on which worker read it.
+            std::mt19937_64 rng(mixHash(index + 1));
+            std::uniform_real_distribution<double> coin(0, 1);
+            forEachRowInRange(in, morsel, columns.size(),
+                [&](RowView& row) {
+                    ++part.rows;
+                    bool sampled = rate >= 1 || coin(rng) < rate;
+                    if (sampled) ++part.sampled;
+                    for (size_t c = 0; c < columns.size(); ++c) {
+                        ColumnScan& col = part.columns[c];
+                        std::string_view cell = row.field(c);
+                        if (cell.empty()) {
+                            ++col.nulls;
+                            continue;
+                        }
+                        col.sketch.add(hashBytes(cell));
+                        if (sampled) col.sample.emplace_back(cell);
+                        key.clear();
+                        appendSortKey(key, cell, columns[c].type, false);
+                        if (!col.any || key < col.minKey) {
+                            col.minKey = key;
+                            col.min = cell;
+                        }
+                        if (!col.any || key > col.maxKey) {
+                            col.maxKey = key;
+                            col.max = cell;
+                        }
+                        col.any = true;
+                    }
+                    return true;
+                },
+                report);
+        }
+    });
+
+    PartialStats& total = partials[0];
+    for (size_t w = 1; w < partials.size(); ++w) {
+        total.rows += partials[w].rows;
+        total.sampled += partials[w].sampled;
+        for (size_t c = 0; c < columns.size(); ++c) {
+            ColumnScan& into = total.columns[c];
+            ColumnScan& from = partials[w].columns[c];
+            into.nulls += from.nulls;
+            into.sketch.merge(from.sketch);
+            into.sample.insert(into.sample.end(), std::make_move_iterator(from.sample.begin()),
+                               std::make_move_iterator(from.sample.end()));
+            if (!from.any) continue;
+            if (!into.any || from.minKey < into.minKey) {
+                into.minKey = from.minKey;
+                into.min = from.min;
+            }
+            if (!into.any || from.maxKey > into.maxKey) {
+                into.maxKey = from.maxKey;
+                into.max = from.max;
+            }
+            into.any = true;
+        }
+    }
+
+    stats = TableStats{};
+    stats.rows = total.rows;
+    stats.bytes = size;
+    stats.columns.resize(columns.size());
+    for (size_t c = 0; c < columns.size(); ++c) {
+        finishColumn(total.columns[c], columns[c], total.rows, total.sampled, stats.columns[c]);
+    }
+    return true;
+}
+
+void noteDeleted(TableStats& stats, uint64_t rows, uint64_t bytesNow) {
+    stats.rows -= std::min(rows, stats.rows);
+    stats.bytes = bytesNow;
+    stats.modified += rows;
+    // Sketches cannot forget values; at least keep the counts possible.
+    for (auto& c : stats.columns) {
+        c.nulls = std::min(c.nulls, stats.rows);
+        c.distinct = std::min(c.distinct, static_cast<double>(stats.rows));
+    }
+}
+
+void noteInserted(TableStats& stats, const std::vector<Column>& columns,
+                  const std::vector<std::vector<std::string>>& rows, uint64_t bytesNow) {
+    stats.rows += rows.size();
+    stats.bytes = bytesNow;
+    stats.modified += rows.size();
+    for (auto& c : stats.columns) {
+        size_t idx = 0;
+        while (idx < columns.size() && columns[idx].name != c.column) ++idx;
+        if (idx == columns.size()) continue;
+        const DataType type = columns[idx].type;
+        std::string lo = c.min.empty() ? "" : keyOf(c.min, type);
+        std::string hi = c.max.empty() ? "" : keyOf(c.max, type);
+        for (const auto& row : rows) {
+            const std::string& value = row[idx];
+            if (value.empty()) {
+                ++c.nulls;
+                continue;
+            }
+            c.sketch.add(hashBytes(value));
+            std::string key = keyOf(value, type);
+            if (c.min.empty() || key < lo) {
+                c.min = value;
+                lo = key;
+            }
+            if (c.max.empty() || key > hi) {
+                c.max = value;
+                hi = key;
+            }
+        }
+        c.distinct = std::min(std::max(1.0, c.sketch.estimate()), static_cast<double>(stats.rows));
+    }
+}
+
+void noteUpdated(TableStats& stats, const Column& column, std::string_view value, uint64_t rows, uint64_t bytesNow) {
+    stats.bytes = bytesNow;
+    stats.modified += rows;
+    for (auto& c : stats.columns) {
+        if (c.column != column.name || rows == 0 || value.empty()) continue;
+        c.sketch.add(hashBytes(value));
+        c.distinct = std::min(std::max(1.0, c.sketch.estimate()), static_cast<double>(stats.rows));
+        std::string key = keyOf(value, column.type);
+        if (c.min.empty() || key < keyOf(c.min, column.type)) c.min = std::string(value);
+        if (c.max.empty() || key > keyOf(c.max, column.type)) c.max = std::string(value);
+    }
+}
+
+bool statsStale(const TableStats& stats) {
+    return stats.modified > kStaleRows + kStaleFraction * stats.rows;
+}
+
+double equalSelectivity(const TableStats& table, const ColumnStats& c, DataType type, std::string_view value) {
+    if (table.rows == 0) return 0;
+    double rows = static_cast<double>(table.rows);
+    double nullFraction = c.nulls / rows;
+    if (value.empty()) return nullFraction;
+    if (c.min.empty()) return 0;
+
+    std::string key = keyOf(value, type);
+    if (key < keyOf(c.min, type) || key > keyOf(c.max, type)) return 0;
+
+    double commonFraction = 0;
+    for (const auto& mc : c.common) {
+        if (mc.first == value) return mc.second;
+        commonFraction += mc.second;
+    }
+    // The remaining values share the remaining rows evenly.
+    double rest = std::max(0.0, 1 - nullFraction - commonFraction);
+    double others = std::max(1.0, c.distinct - c.common.size());
+    return rest / others;
+}
+
+double likeSelectivity(const TableStats& table, const ColumnStats& c, std::string_view pattern) {
+    if (pattern.empty()) return 1;
+    if (table.rows == 0) return 0;
+    double nullFraction = static_cast<double>(c.nulls) / table.rows;
+
+    double matched = 0, commonFraction = 0;
+    for (const auto& mc : c.common) {
+        if (mc.first.find(pattern) != std::string::npos) matched += mc.second;
+        commonFraction += mc.second;
+    }
+    // The histogram bounds are a small sample of the other values; the share
+    // of them that match stands in for the rest of the column.
+    double rest = std::max(0.0, 1 - nullFraction - commonFraction);
+    if (c.histogram.empty()) return matched;
+    size_t hits = 0;
+    for (const auto& b : c.histogram) {
+        if (b.find(pattern) != std::string::npos) ++hits;
+    }
+    double share = static_cast<double>(hits) / c.histogram.size();
+    // Few bounds: never let the estimate collapse to exactly none or all.
+    double floor = 1.0 / (c.histogram.size() + 1);
+    return matched + rest * std::min(1 - floor, std::max(floor, share));
+}
@@ -0,0 +1,15 @@
+#include "TableScan.hpp"
+#include <filesystem>
+
+std::vector<ByteRange> splitFile(const std::string& path, size_t parts) {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec || size == 0 || parts == 0) return {ByteRange{0, ec ? 0 : size}};
+
+    std::vector<ByteRange> ranges;
+    uint64_t step = (size + parts - 1) / parts;
+    for (uint64_t begin = 0; begin < size; begin += step) {
+        ranges.push_back({begin, std::min(begin + step, size)});
+    }
+    return ranges;
+}
@@ -0,0 +1,317 @@
+#include "ThreadPool.hpp"
+#include "Utility.hpp"
+#include <optional>
+#include <random>
+#include <utility>
+
+#ifdef _WIN32
+  #define NOMINMAX
+  #include <windows.h>
+#else
+  #include <time.h>
+  #if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+  #endif
+#endif
+
+namespace {
+
+constexpr int64_t kInitialDequeCapacity = 256;
+
+// Set on pool threads so submit() and runOne() can find their own deque.
+thread_local ThreadPool* currentPool = nullptr;
+thread_local size_t currentWorker = SIZE_MAX;
+
+// Innermost CpuMeter::Scope open on this thread.
+thread_local CpuMeter::Scope* activeScope = nullptr;
+
+std::atomic<ThreadPool*> globalPool{nullptr};
+std::mutex globalPoolMutex;
+
+void pinCurrentThread(int cpu) {
+#ifdef _WIN32
+    SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+// CPU time the calling thread has used, in nanoseconds.
+uint64_t threadCpuNanos() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+    auto ticks = [](const FILETIME& t) { return (uint64_t(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+    return (ticks(kernel) + ticks(user)) * 100;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+#endif
+}
+
+} // namespace
+
+CpuMeter::Scope::Scope(CpuMeter* meter) : meter(meter), outer(activeScope), mark(threadCpuNanos()) {
+    if (outer) outer->charge(mark);
+    activeScope = this;
+}
+
+CpuMeter::Scope::~Scope() {
+    uint64_t now = threadCpuNanos();
+    charge(now);
+    activeScope = outer;
+    if (outer) outer->mark = now;
+}
+
+void CpuMeter::Scope::charge(uint64_t now) {
+    if (meter) meter->nanos.fetch_add(now - mark, std::memory_order_relaxed);
+    mark = now;
+}
+
+CpuMeter* CpuMeter::current() {
+    return activeScope ? activeScope->meter : nullptr;
+}
+
+WorkDeque::WorkDeque() {
+    rings.push_back(std::make_unique<Ring>(kInitialDequeCapacity));
+    ring.store(rings.back().get(), std::memory_order_relaxed);
+}
+
+WorkDeque::Ring* WorkDeque::grow(Ring* old, int64_t b, int64_t t) {
+    rings.push_back(std::make_unique<Ring>(old->capacity * 2));
+    Ring* bigger = rings.back().get();
+    for (int64_t i = t; i < b; ++i) bigger->put(i, old->get(i));
+    ring.store(bigger, std::memory_order_release);
+    return bigger;
+}
+
+void WorkDeque::push(Task* task) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    Ring* r = ring.load(std::memory_order_relaxed);
+    if (b - t > r->capacity - 1) r = grow(r, b, t);
+    r->put(b, task);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+Task* WorkDeque::pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Ring* r = ring.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Task* task = r->get(b);
+    if (t == b) {
+        // Last element: race thieves for it.
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) task = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+Task* WorkDeque::steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    Ring* r = ring.load(std::memory_order_acquire);
+    Task* task = r->get(t);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+    return task;
+}
+
+bool WorkDeque::empty() const {
+    return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+}
+
+ThreadPool::ThreadPool(size_t count, bool pin) : started(std::chrono::steady_clock::now()) {
+    size_t cpus = std::thread::hardware_concurrency();
+    for (size_t i = 0; i < count; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+        if (pin && cpus > 0) workers.back()->cpu = static_cast<int>(i % cpus);
+    }
+    for (size_t i = 0; i < count; ++i) workers[i]->thread = std::thread(&ThreadPool::loop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers) w->thread.join();
+    for (Task* t : injected) delete t;
+}
+
+ThreadPool& ThreadPool::instance() {
+    ThreadPool* pool = globalPool.load(std::memory_order_acquire);
+    if (pool) return *pool;
+    std::lock_guard<std::mutex> lock(globalPoolMutex);
+    pool = globalPool.load(std::memory_order_relaxed);
+    if (!pool) {
+        // Lives until exit; workers are joined by the static's destructor.
+        static ThreadPool shared(workerThreads(), envSize("CDB_PIN_THREADS", 0) != 0);
+        pool = &shared;
+        globalPool.store(pool, std::memory_order_release);
+    }
+    return *pool;
+}
+
+ThreadPool* ThreadPool::existing() {
+    return globalPool.load(std::memory_order_acquire);
+}
+
+void ThreadPool::submit(Task task) {
+    Task* t = new Task(std::move(task));
+    if (currentPool == this) {
+        workers[currentWorker]->deque.push(t);
+    } else {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        injected.push_back(t);
+    }
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+Task* ThreadPool::findTask(size_t self) {
+    if (self != SIZE_MAX) {
+        if (Task* t = workers[self]->deque.pop()) return t;
+    }
+    {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        if (!injected.empty()) {
+            Task* t = injected.front();
+            injected.pop_front();
+            return t;
+        }
+    }
+    // One pass over the other workers from a random start.
+    thread_local std::minstd_rand rng(static_cast<unsigned>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+    size_t n = workers.size();
+    size_t start = rng() % n;
+    for (size_t k = 0; k < n; ++k) {
+        size_t victim = (start + k) % n;
+        if (victim == self) continue;
+        if (Task* t = workers[victim]->deque.steal()) {
+            if (self != SIZE_MAX) workers[self]->steals.fetch_add(1, std::memory_order_relaxed);
+            return t;
+        }
+    }
+    return nullptr;
+}
+
+void ThreadPool::run(Task* task, Worker* worker) {
+    pending.fetch_sub(1);
+    auto begin = std::chrono::steady_clock::now();
+    {
+        // A task run while waiting inside a metered scope is not that scope's work.
+        std::optional<CpuMeter::Scope> pause;
+        if (activeScope) pause.emplace(nullptr);
+        (*task)();
+        delete task;
+    }
+    if (worker) {
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+        worker->busyNanos.fetch_add(static_cast<uint64_t>(nanos.count()), std::memory_order_relaxed);
+        worker->tasks.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool ThreadPool::runOne() {
+    size_t self = currentPool == this ? currentWorker : SIZE_MAX;
+    Task* t = findTask(self);
+    if (!t) return false;
+    run(t, self == SIZE_MAX ? nullptr : workers[self].get());
+    return true;
+}
+
+void ThreadPool::loop(size_t self) {
+    currentPool = this;
+    currentWorker = self;
+    Worker& me = *workers[self];
+    if (me.cpu >= 0) pinCurrentThread(me.cpu);
+
+    for (;;) {
+        if (Task* t = findTask(self)) {
+            run(t, &me);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&] { return stopping.load() || pending.load() > 0; });
+        if (stopping && pending.load() == 0) return;
+    }
+}
+
+std::vector<ThreadPool::WorkerStats> ThreadPool::stats() const {
+    double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::vector<WorkerStats> out;
+    for (const auto& w : workers) {
+        out.push_back({w->cpu, w->tasks.load(), w->steals.load(), w->busyNanos.load() / 1e9, uptime});
+    }
+    return out;
+}
+
+void TaskGroup::run(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++outstanding;
+    }
+    pool.submit([this, meter = CpuMeter::current(), task = std::move(task)] {
+        std::exception_ptr thrown;
+        {
+            // Closed before the count drops: the meter may go with the waiter.
+            std::optional<CpuMeter::Scope> scope;
+            if (meter) scope.emplace(meter);
+            try {
+                task();
+            } catch (...) {
+                thrown = std::current_exception();
+            }
+        }
+        // Decrement under the lock: once wait() sees zero the group may be destroyed.
+        std::lock_guard<std::mutex> lock(mutex);
+        if (thrown && !error) error = thrown;
+        if (--outstanding == 0) finished.notify_all();
+    });
+}
+
+void TaskGroup::wait() {
+    drain();
+    std::exception_ptr thrown;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        thrown = std::exchange(error, nullptr);
+    }
+    if (thrown) std::rethrow_exception(thrown);
+}
+
+void TaskGroup::drain() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (outstanding == 0) return;
+        }
+        if (pool.runOne()) continue;
+        // Nothing is queued that this thread could take, so the group's
+        // remaining tasks are running on other threads.
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return outstanding == 0; });
+    }
+}
@@ -2,6 +2,18 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+
+#ifdef _WIN32
+  #include <process.h>
+  #define getpid _getpid
+#else
+  #include <unistd.h>
+#endif
 
 std::vector<std::string> split(const std::string& str, char delimiter) {
     std::stringstream ss(str);
@@ -18,3 +30,81 @@ std::string trim(const std::string& s) {
     size_t end = s.find_last_not_of(" \t\n\r");
     return (start == std::string::npos) ? "" : s.substr(start, end - start + 1);
 }
+
+bool splitCommandLine(const std::string& line, std::vector<std::string>& args, std::string& error) {
+    args.clear();
+    std::string current;
+    bool inArg = false;
+    char quote = 0;
+    for (char c : line) {
+        if (quote != 0) {
+            if (c == quote) quote = 0;
+            else current += c;
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            inArg = true;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            if (inArg) args.push_back(current);
+            current.clear();
+            inArg = false;
+        } else {
+            current += c;
+            inArg = true;
+        }
+    }
+    if (quote != 0) {
+        error = "Unclosed quote in: " + line;
+        return false;
+    }
+    if (inArg) args.push_back(current);
+    return true;
+}
+
+size_t envSize(const char* name, size_t fallback) {
+    const char* v = std::getenv(name);
+    if (v == nullptr || *v == '\0') return fallback;
+    char* end = nullptr;
+    unsigned long long n = std::strtoull(v, &end, 10);
+    return (end != nullptr && *end == '\0') ? static_cast<size_t>(n) : fallback;
+}
+
+size_t workerThreads() {
+    size_t hw = std::thread::hardware_concurrency();
+    size_t n = envSize("CDB_THREADS", hw == 0 ? 1 : hw);
+    return n == 0 ? 1 : n;
+}
+
+std::string databasePath(const std::string& root, const std::string& relative) {
+    return root.empty() ? relative : root + "/" + relative;
+}
+
+std::string dataPath(const std::string& root, const std::string& table) {
+    return databasePath(root, "data/" + table + ".dat");
+}
+
+std::string metaPath(const std::string& root, const std::string& table) {
+    return databasePath(root, "metadata/" + table + ".meta");
+}
+
+std::string makeTempPath(const std::string& root, const std::string& prefix) {
+    static std::atomic<unsigned long long> counter{0};
+    const std::string dir = databasePath(root, "data/tmp");
+    // Not thrown: a missing directory shows up as a file that cannot be written.
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    // cdb serve and CLI runs share data/tmp, so the process id keeps their names apart.
+    auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    return dir + "/" + prefix + "-" + std::to_string(getpid()) + "-" + std::to_string(stamp) + "-" +
+           std::to_string(counter++) + ".tmp";
+}
+
+std::optional<FileStamp> fileStamp(const std::string& path) {
+    std::error_code ec;
+    FileStamp stamp;
+    stamp.size = std::filesystem::file_size(path, ec);
+    if (ec) return std::nullopt;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return std::nullopt;
+    stamp.modified = static_cast<int64_t>(time.time_since_epoch().count());
+    return stamp;
+}
@@ -1,8 +1,12 @@
-#include "Catalog.hpp"
+#include "catalog.hpp"
 #include "Utility.hpp"   // for trim/split if you have them; else add small helpers here
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <cstdio>
+#include <cmath>
+#include <map>
+#include <mutex>
 
 #ifdef _WIN32
   #include <direct.h>
@@ -37,11 +41,11 @@ static std::vector<std::string> splitBy(const std::string& s, char delim) {
 }
 // ---------------------------------------------
 
-std::string Catalog::catalogPath() {
-    return "metadata/catalog.meta";
+std::string Catalog::catalogPath(const std::string& root) {
+    return databasePath(root, "metadata/catalog.meta");
 }
-void Catalog::ensureMetadataDir() {
-    makeDir("metadata");
+void Catalog::ensureMetadataDir(const std::string& root) {
+    makeDir(databasePath(root, "metadata"));
 }
 
 static std::string dataTypeToString(DataType t) {
@@ -53,6 +57,43 @@ static std::string dataTypeToString(DataType t) {
     }
 }
 
+// Statistics values are written as single tokens: space, tab, '%' and '|' are
+// percent-escaped so a value never splits a line or a histogram.
+static std::string escapeValue(const std::string& v) {
+    static const char* digits = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char ch : v) {
+        if (ch == ' ' || ch == '\t' || ch == '%' || ch == '|' || ch == '\r') {
+            out.push_back('%');
+            out.push_back(digits[ch >> 4]);
+            out.push_back(digits[ch & 15]);
+        } else {
+            out.push_back(static_cast<char>(ch));
+        }
+    }
+    return out;
+}
+
+static std::string unescapeValue(const std::string& v) {
+    std::string out;
+    for (size_t i = 0; i < v.size(); ++i) {
+        if (v[i] == '%' && i + 2 < v.size()) {
+            out.push_back(static_cast<char>(std::stoi(v.substr(i + 1, 2), nullptr, 16)));
+            i += 2;
+        } else {
+            out.push_back(v[i]);
+        }
+    }
+    return out;
+}
+
+// Value of a key=value token; false when the token has another key.
+static bool tokenValue(const std::string& token, const std::string& key, std::string& value) {
+    if (token.compare(0, key.size() + 1, key + "=") != 0) return false;
+    value = token.substr(key.size() + 1);
+    return true;
+}
+
 // Serialize a simple human-readable format.
 // Example:
 //
@@ -65,10 +106,17 @@ static std::string dataTypeToString(DataType t) {
 // [table orders]
 // col order_id INT pk
 // col user_id INT fk=users.id
+// cluster order_id
+// stats rows=3 bytes=42 modified=0
+// colstats order_id nulls=0 distinct=3 min=1 max=3
+// hist order_id 1|2|3
+// common order_id
+// sketch order_id 0000...
 // end
 //
 std::string Catalog::serialize(const Catalog& c) {
     std::ostringstream out;
+    out << "version " << c.versionNumber << "\n";
     for (const auto& t : c.tables) {
         out << "[table " << t.name << "]\n";
         for (const auto& col : t.columns) {
@@ -78,6 +126,24 @@ std::string Catalog::serialize(const Catalog& c) {
             if (col.hasForeignKey) out << " fk=" << col.fkTable << "." << col.fkColumn;
             out << "\n";
         }
+        if (!t.clusteredBy.empty()) out << "cluster " << t.clusteredBy << "\n";
+        if (t.stats) {
+            const TableStats& s = *t.stats;
+            out << "stats rows=" << s.rows << " bytes=" << s.bytes << " modified=" << s.modified << "\n";
+            for (const auto& c : s.columns) {
+                out << "colstats " << c.column << " nulls=" << c.nulls << " distinct=" << std::llround(c.distinct)
+                    << " min=" << escapeValue(c.min) << " max=" << escapeValue(c.max) << "\n";
+                out << "hist " << c.column;
+                for (size_t i = 0; i < c.histogram.size(); ++i) {
+                    out << (i == 0 ? " " : "|") << escapeValue(c.histogram[i]);
+                }
+                out << "\ncommon " << c.column;
+                for (size_t i = 0; i < c.common.size(); ++i) {
+                    out << (i == 0 ? " " : "|") << c.common[i].second << ":" << escapeValue(c.common[i].first);
+                }
+                out << "\nsketch " << c.column << " " << c.sketch.encode() << "\n";
+            }
+        }
         out << "end\n";
     }
     return out.str();
@@ -110,6 +176,10 @@ Catalog Catalog::parse(const std::string& text) {
             current.name = trimString(line.substr(7, line.size() - 8)); // inside [table ...]
             continue;
         }
+        if (!inTable && line.rfind("version ", 0) == 0) {
+            cat.versionNumber = std::stoull(line.substr(8));
+            continue;
+        }
         if (line == "end") {
             if (inTable) {
                 cat.tables.push_back(current);
@@ -142,33 +212,123 @@ Catalog Catalog::parse(const std::string& text) {
                     }
                     current.columns.push_back(cd);
                 }
+            } else if (line.rfind("cluster ", 0) == 0) {
+                current.clusteredBy = trimString(line.substr(8));
+            } else if (line.rfind("stats ", 0) == 0) {
+                // stats rows=<n> bytes=<n> modified=<n>
+                TableStats st;
+                std::string v;
+                for (const auto& tok : splitBy(trimString(line.substr(6)), ' ')) {
+                    if (tokenValue(tok, "rows", v)) st.rows = std::stoull(v);
+                    else if (tokenValue(tok, "bytes", v)) st.bytes = std::stoull(v);
+                    else if (tokenValue(tok, "modified", v)) st.modified = std::stoull(v);
+                }
+                current.stats = st;
+            } else if (current.stats && line.rfind("colstats ", 0) == 0) {
+                // colstats <col> nulls=<n> distinct=<x> min=<v> max=<v>
+                auto tokens = splitBy(trimString(line.substr(9)), ' ');
+                if (tokens.empty()) continue;
+                ColumnStats cs;
+                cs.column = tokens[0];
+                std::string v;
+                for (size_t i = 1; i < tokens.size(); ++i) {
+                    if (tokenValue(tokens[i], "nulls", v)) cs.nulls = std::stoull(v);
+                    else if (tokenValue(tokens[i], "distinct", v)) cs.distinct = std::stod(v);
+                    else if (tokenValue(tokens[i], "min", v)) cs.min = unescapeValue(v);
+                    else if (tokenValue(tokens[i], "max", v)) cs.max = unescapeValue(v);
+                }
+                current.stats->columns.push_back(cs);
+            } else if (current.stats && !current.stats->columns.empty() &&
+                       (line.rfind("hist ", 0) == 0 || line.rfind("common ", 0) == 0 || line.rfind("sketch ", 0) == 0)) {
+                // hist <col> [v|v|...], common <col> [f:v|...], sketch <col> <hex>
+                auto tokens = splitBy(line, ' ');
+                if (tokens.size() < 2) continue;
+                ColumnStats* cs = nullptr;
+                for (auto& c : current.stats->columns) {
+                    if (c.column == tokens[1]) cs = &c;
+                }
+                if (!cs || tokens.size() < 3) continue;
+                if (tokens[0] == "hist") {
+                    for (const auto& v : splitBy(tokens[2], '|')) cs->histogram.push_back(unescapeValue(v));
+                } else if (tokens[0] == "common") {
+                    for (const auto& entry : splitBy(tokens[2], '|')) {
+                        size_t colon = entry.find(':');
+                        if (colon == std::string::npos) continue;
+                        cs->common.emplace_back(unescapeValue(entry.substr(colon + 1)), std::stod(entry.substr(0, colon)));
+                    }
+                } else {
+                    cs->sketch.decode(tokens[2]);
+                }
             }
         }
     }
     return cat;
 }
 
-Catalog Catalog::load() {
-    ensureMetadataDir();
-    std::ifstream in(catalogPath());
+// The last catalog of each database directory read or written by this
+// process. Long-running modes (cdb serve) reuse it while the file's size and
+// modification time are unchanged instead of parsing it for every command.
+struct CatalogCache {
+    std::mutex mutex;
+    std::optional<FileStamp> stamp;
+    Catalog catalog;
+};
+
+static CatalogCache& catalogCache(const std::string& root) {
+    static std::mutex mutex;
+    static std::map<std::string, CatalogCache> caches;
+    std::lock_guard<std::mutex> lock(mutex);
+    return caches[root];
+}
+
+Catalog Catalog::load(const std::string& root) {
+    ensureMetadataDir(root);
+    CatalogCache& cache = catalogCache(root);
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto stamp = fileStamp(catalogPath(root));
+    if (stamp && cache.stamp == stamp) return cache.catalog;
+
+    std::ifstream in(catalogPath(root));
     if (!in.is_open()) {
         // create empty file
-        std::ofstream out(catalogPath());
+        std::ofstream out(catalogPath(root));
         out.close();
-        return Catalog{};
+        Catalog empty;
+        empty.directory = root;
+        return empty;
     }
     std::ostringstream buf;
     buf << in.rdbuf();
     in.close();
-    return parse(buf.str());
+    cache.catalog = parse(buf.str());
+    cache.catalog.directory = root;
+    cache.stamp = stamp;
+    return cache.catalog;
+}
+
+uint64_t Catalog::currentVersion(const std::string& root) {
+    CatalogCache& cache = catalogCache(root);
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto stamp = fileStamp(catalogPath(root));
+        if (stamp && cache.stamp == stamp) return cache.catalog.versionNumber;
+    }
+    return load(root).versionNumber;
 }
 
 bool Catalog::save() const {
-    ensureMetadataDir();
-    std::ofstream out(catalogPath(), std::ios::trunc);
+    ensureMetadataDir(directory);
+    CatalogCache& cache = catalogCache(directory);
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    // Past both this copy and the last one saved, in case this copy is older.
+    Catalog saved = *this;
+    saved.versionNumber = std::max(versionNumber, cache.catalog.versionNumber) + 1;
+    std::ofstream out(catalogPath(directory), std::ios::trunc);
     if (!out.is_open()) return false;
-    out << serialize(*this);
+    out << serialize(saved);
     out.close();
+    cache.catalog = saved;
+    cache.stamp = fileStamp(catalogPath(directory));
     return true;
 }
 
@@ -178,6 +338,16 @@ bool Catalog::addTable(const TableDef& tdef) {
     return true;
 }
 
+bool Catalog::updateTable(const TableDef& tdef) {
+    for (auto& t : tables) {
+        if (t.name == tdef.name) {
+            t = tdef;
+            return true;
+        }
+    }
+    return false;
+}
+
 std::optional<TableDef> Catalog::getTable(const std::string& name) const {
     for (const auto& t : tables) if (t.name == name) return t;
     return std::nullopt;
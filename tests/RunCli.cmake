@@ -0,0 +1,49 @@
+# Runs a golden-output test: every line of TEST holds the arguments of one
+# `cdb` command, quoted as for sh (blank lines and lines starting with # are
+# skipped), run as its own process in the empty database directory WORK.
+# `@TESTS@` in a line is replaced by the directory of TEST. The transcript of
+# the commands, their output and nonzero exit codes must equal EXPECTED, with
+# durations masked. The actual transcript is left in WORK/actual.out.
+#
+#   cmake -DCDB=<cdb> -DTEST=<x.test> -DEXPECTED=<x.out> -DWORK=<dir> -P RunCli.cmake
+
+cmake_minimum_required(VERSION 3.10)
+
+foreach(var CDB TEST EXPECTED WORK)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "RunCli.cmake needs -D${var}=...")
+    endif()
+endforeach()
+
+get_filename_component(tests "${TEST}" DIRECTORY)
+file(REMOVE_RECURSE "${WORK}")
+file(MAKE_DIRECTORY "${WORK}")
+# Nobody answers a confirmation prompt; an empty stdin cancels it.
+file(WRITE "${WORK}/stdin" "")
+
+file(STRINGS "${TEST}" lines)
+set(transcript "")
+foreach(line IN LISTS lines)
+    if(line STREQUAL "" OR line MATCHES "^#")
+        continue()
+    endif()
+    string(REPLACE "@TESTS@" "${tests}" command "${line}")
+    # Through sh, as a CMake list cannot pass an empty argument.
+    execute_process(COMMAND sh -c "exec \"${CDB}\" ${command}"
+                    WORKING_DIRECTORY "${WORK}"
+                    INPUT_FILE "${WORK}/stdin"
+                    OUTPUT_VARIABLE out
+                    ERROR_VARIABLE err
+                    RESULT_VARIABLE rc)
+    string(APPEND transcript "$ cdb ${line}\n${out}${err}")
+    if(NOT rc EQUAL 0)
+        string(APPEND transcript "[exit ${rc}]\n")
+    endif()
+endforeach()
+string(REGEX REPLACE "[0-9]+\\.[0-9]+ s" "#.### s" transcript "${transcript}")
+
+file(WRITE "${WORK}/actual.out" "${transcript}")
+file(READ "${EXPECTED}" expected)
+if(NOT transcript STREQUAL expected)
+    message(FATAL_ERROR "Output differs from ${EXPECTED}; see ${WORK}/actual.out")
+endif()
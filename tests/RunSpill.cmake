@@ -0,0 +1,107 @@
+# Runs queries that outgrow a small CDB_QUERY_MEMORY, so the external sort,
+# the TopNHeap hand-over to it and the Grace hash join spill to data/tmp, and
+# checks that each one prints exactly what it prints in memory. Tables of
+# ROWS rows are generated in the empty database directory WORK.
+#
+#   cmake -DCDB=<cdb> -DWORK=<dir> [-DROWS=<n>] [-DMEMORY=<bytes>] -P RunSpill.cmake
+
+cmake_minimum_required(VERSION 3.10)
+
+foreach(var CDB WORK)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "RunSpill.cmake needs -D${var}=...")
+    endif()
+endforeach()
+if(NOT DEFINED ROWS)
+    set(ROWS 20000)
+endif()
+if(NOT DEFINED MEMORY)
+    set(MEMORY 262144)
+endif()
+
+file(REMOVE_RECURSE "${WORK}")
+file(MAKE_DIRECTORY "${WORK}")
+
+# String join keys, so the planner cannot pick the radix join, and orders in
+# an order unrelated to users.
+set(script "table_banao users id:int:pk name:string city:string\n"
+           "table_banao orders oid:int:pk user:string amount:int\n")
+set(users "")
+set(orders "")
+foreach(i RANGE 1 ${ROWS})
+    math(EXPR city "${i} % 97")
+    math(EXPR user "(${i} * 7919) % ${ROWS} + 1")
+    math(EXPR amount "(${i} * 104729) % 1009")
+    string(APPEND users " ${i} user${i} city${city}")
+    string(APPEND orders " ${i} user${user} ${amount}")
+    math(EXPR batch "${i} % 500")
+    if(batch EQUAL 0 OR i EQUAL ROWS)
+        string(APPEND script "insert_karo users${users}\ninsert_karo orders${orders}\n")
+        set(users "")
+        set(orders "")
+    endif()
+endforeach()
+file(WRITE "${WORK}/load.cdb" ${script})
+execute_process(COMMAND "${CDB}" run "${WORK}/load.cdb"
+                WORKING_DIRECTORY "${WORK}"
+                OUTPUT_QUIET
+                RESULT_VARIABLE rc)
+if(NOT rc EQUAL 0)
+    message(FATAL_ERROR "Loading the tables failed")
+endif()
+
+# A spilled join emits its rows in partition order, so its output is compared
+# as a set of lines.
+set(ordered
+    "dikhao orders order by amount,oid format csv"
+    "dikhao orders cols user,oid order by user:desc limit 5000 format csv")
+set(unordered
+    "jodo orders users on user=name cols oid,name,city,amount format csv")
+
+set(failed FALSE)
+foreach(query IN LISTS ordered unordered)
+    separate_arguments(args UNIX_COMMAND "${query}")
+    set(outputs "")
+    foreach(memory "" "${MEMORY}")
+        file(REMOVE_RECURSE "${WORK}/data/tmp")
+        if(memory STREQUAL "")
+            unset(ENV{CDB_QUERY_MEMORY})
+        else()
+            set(ENV{CDB_QUERY_MEMORY} "${memory}")
+        endif()
+        execute_process(COMMAND "${CDB}" ${args}
+                        WORKING_DIRECTORY "${WORK}"
+                        OUTPUT_VARIABLE out
+                        ERROR_VARIABLE err
+                        RESULT_VARIABLE rc)
+        if(NOT rc EQUAL 0 OR NOT err STREQUAL "" OR out STREQUAL "")
+            message(SEND_ERROR "${query} (memory '${memory}') failed: ${err}")
+            set(failed TRUE)
+        endif()
+        # Only the run with the small budget may touch the disk.
+        if(memory STREQUAL "" AND EXISTS "${WORK}/data/tmp")
+            message(SEND_ERROR "${query} spilled with the default budget")
+            set(failed TRUE)
+        elseif(NOT memory STREQUAL "" AND NOT EXISTS "${WORK}/data/tmp")
+            message(SEND_ERROR "${query} did not spill with CDB_QUERY_MEMORY=${memory}")
+            set(failed TRUE)
+        endif()
+        if(query IN_LIST unordered)
+            string(REPLACE "\n" ";" lines "${out}")
+            list(SORT lines)
+            string(SHA256 digest "${lines}")
+        else()
+            string(SHA256 digest "${out}")
+        endif()
+        list(APPEND outputs "${digest}")
+    endforeach()
+    list(GET outputs 0 inMemory)
+    list(GET outputs 1 spilled)
+    if(NOT inMemory STREQUAL spilled)
+        message(SEND_ERROR "${query} prints other rows when it spills")
+        set(failed TRUE)
+    endif()
+endforeach()
+if(failed)
+    message(FATAL_ERROR "Spill checks failed")
+endif()
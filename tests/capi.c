@@ -0,0 +1,156 @@
+/* Exercises the C interface of cdb.h from C: commands, prepared statements
+ * with parameters, row and batch reads, and errors kept per database. Run
+ * with the directories of two empty databases. */
+
+#include "cdb.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,      \
+                    __LINE__, #cond);                                   \
+            ++failures;                                                 \
+        }                                                               \
+    } while (0)
+
+static int text_is(cdb_stmt* stmt, int col, const char* expected) {
+    size_t len = 0;
+    const char* text = cdb_column_text(stmt, col, &len);
+    return len == strlen(expected) && memcmp(text, expected, len) == 0;
+}
+
+static void commands(cdb_db* db) {
+    const char* output = NULL;
+    CHECK(cdb_exec(db, "table_banao users id:int:pk name:string score:float", &output) == CDB_OK);
+    CHECK(strstr(output, "created") != NULL);
+    CHECK(cdb_exec(db, "insert_karo users 1 Alice 2.5 2 Bob \"\" 3 \"Carol Ann\" -1", NULL) == CDB_OK);
+    CHECK(cdb_exec(db, "insert_karo users 1 Again 0", &output) == CDB_ERROR);
+    CHECK(strstr(output, "Primary key already exists") != NULL);
+    CHECK(cdb_exec(db, "serve", NULL) == CDB_ERROR);
+}
+
+static void rows(cdb_db* db) {
+    cdb_stmt* stmt = NULL;
+    CHECK(cdb_prepare(db, "dikhao users order by id", &stmt) == CDB_OK);
+    CHECK(cdb_column_count(stmt) == 3);
+    CHECK(strcmp(cdb_column_name(stmt, 1), "name") == 0);
+    CHECK(cdb_column_type(stmt, 0) == CDB_INT);
+    CHECK(cdb_column_type(stmt, 2) == CDB_FLOAT);
+    CHECK(cdb_column_type(stmt, 3) == -1);
+
+    CHECK(cdb_step(stmt) == CDB_ROW);
+    CHECK(cdb_column_int64(stmt, 0) == 1);
+    CHECK(text_is(stmt, 1, "Alice"));
+    CHECK(cdb_column_double(stmt, 2) == 2.5);
+    CHECK(cdb_step(stmt) == CDB_ROW);
+    CHECK(cdb_column_is_null(stmt, 2));
+    CHECK(!cdb_column_is_null(stmt, 1));
+    CHECK(cdb_step(stmt) == CDB_ROW);
+    CHECK(text_is(stmt, 1, "Carol Ann"));
+    CHECK(cdb_step(stmt) == CDB_DONE);
+
+    /* Run again, this time a batch at a time. */
+    CHECK(cdb_reset(stmt) == CDB_OK);
+    CHECK(cdb_step_batch(stmt) == CDB_ROW);
+    CHECK(cdb_batch_rows(stmt) == 3);
+    const int64_t* ids = cdb_batch_int64(stmt, 0);
+    const double* scores = cdb_batch_double(stmt, 2);
+    const uint8_t* valid = cdb_batch_validity(stmt, 2);
+    const uint32_t* ends = cdb_batch_text_ends(stmt, 1);
+    const char* names = cdb_batch_text_bytes(stmt, 1);
+    CHECK(ids && ids[0] == 1 && ids[1] == 2 && ids[2] == 3);
+    CHECK(scores && scores[2] == -1);
+    CHECK(valid && valid[0] == 5);
+    CHECK(cdb_batch_int64(stmt, 1) == NULL);
+    CHECK(ends && ends[0] == 5 && ends[1] == 8 && ends[2] == 17);
+    CHECK(names && memcmp(names, "AliceBobCarol Ann", 17) == 0);
+    CHECK(cdb_step_batch(stmt) == CDB_DONE);
+    CHECK(cdb_finalize(stmt) == CDB_OK);
+}
+
+static void parameters(cdb_db* db) {
+    cdb_stmt* stmt = NULL;
+    CHECK(cdb_prepare(db, "dikhao users cols name where id = ?", &stmt) == CDB_OK);
+    CHECK(cdb_bind_parameter_count(stmt) == 1);
+    CHECK(cdb_step(stmt) == CDB_ERROR);
+    CHECK(strstr(cdb_errmsg(db), "no value") != NULL);
+
+    CHECK(cdb_reset(stmt) == CDB_OK);
+    CHECK(cdb_bind_int64(stmt, 0, 2) == CDB_OK);
+    CHECK(cdb_step(stmt) == CDB_ROW);
+    CHECK(text_is(stmt, 0, "Bob"));
+    CHECK(cdb_step(stmt) == CDB_DONE);
+
+    /* The value stays bound across a reset until it is bound again. */
+    CHECK(cdb_reset(stmt) == CDB_OK);
+    CHECK(cdb_step(stmt) == CDB_ROW);
+    CHECK(text_is(stmt, 0, "Bob"));
+    CHECK(cdb_reset(stmt) == CDB_OK);
+    CHECK(cdb_bind_text(stmt, 0, "3") == CDB_OK);
+    CHECK(cdb_step(stmt) == CDB_ROW);
+    CHECK(text_is(stmt, 0, "Carol Ann"));
+    CHECK(cdb_bind_text(stmt, 1, "x") == CDB_MISUSE);
+    CHECK(cdb_finalize(stmt) == CDB_OK);
+
+    /* A command without rows runs on its first step. */
+    CHECK(cdb_prepare(db, "update_karo users change score=4.5 where id = ?", &stmt) == CDB_OK);
+    CHECK(cdb_bind_int64(stmt, 0, 2) == CDB_OK);
+    CHECK(cdb_step(stmt) == CDB_DONE);
+    CHECK(strstr(cdb_output(stmt), "Updated 1 row(s).") != NULL);
+    CHECK(cdb_finalize(stmt) == CDB_OK);
+}
+
+static void errors(cdb_db* db, cdb_db* other) {
+    cdb_stmt* stmt = NULL;
+    CHECK(cdb_prepare(db, "dikhao nosuch", &stmt) == CDB_ERROR);
+    CHECK(stmt == NULL);
+    CHECK(strstr(cdb_errmsg(db), "nosuch") != NULL);
+    CHECK(strcmp(cdb_errmsg(other), "") == 0);
+    CHECK(cdb_prepare(db, "", &stmt) == CDB_ERROR);
+    CHECK(cdb_step(NULL) == CDB_MISUSE);
+    CHECK(cdb_prepare(NULL, "dikhao users", &stmt) == CDB_MISUSE);
+    CHECK(strcmp(cdb_errmsg(NULL), "") == 0);
+}
+
+int main(int argc, char** argv) {
+    cdb_db* db = NULL;
+    cdb_db* other = NULL;
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <database> <database>\n", argv[0]);
+        return 2;
+    }
+    CHECK(cdb_open(argv[1], &db) == CDB_OK);
+    CHECK(cdb_open(argv[2], &other) == CDB_OK);
+    if (failures) return 1;
+
+    commands(db);
+    rows(db);
+    parameters(db);
+    errors(db, other);
+
+    /* The same statement text in the other database has its own plan. */
+    const char* output = NULL;
+    cdb_stmt* stmt = NULL;
+    CHECK(cdb_exec(other, "table_banao users id:int:pk name:string score:float", NULL) == CDB_OK);
+    CHECK(cdb_exec(other, "insert_karo users 9 Zed 0", NULL) == CDB_OK);
+    CHECK(cdb_prepare(other, "dikhao users order by id", &stmt) == CDB_OK);
+    CHECK(cdb_step(stmt) == CDB_ROW);
+    CHECK(cdb_column_int64(stmt, 0) == 9);
+    CHECK(cdb_step(stmt) == CDB_DONE);
+    CHECK(cdb_finalize(stmt) == CDB_OK);
+    CHECK(cdb_exec(db, "dikhao users agg count", &output) == CDB_OK);
+    CHECK(strstr(output, "| 3 ") != NULL);
+
+    CHECK(cdb_close(other) == CDB_OK);
+    CHECK(cdb_close(db) == CDB_OK);
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed.\n");
+    return 0;
+}
@@ -0,0 +1,50 @@
+#!/bin/sh
+# Golden-output check of serve and client: starts a server in the empty
+# database directory $2, sends it commands one at a time, pipelined from
+# stdin and as one batch, stops it with SIGTERM and compares what the
+# clients printed with $3.
+#
+#   server.sh <cdb> <work> <expected>
+
+cdb=$1
+work=$2
+expected=$3
+rm -rf "$work"
+mkdir -p "$work" || exit 1
+cd "$work" || exit 1
+
+"$cdb" serve --socket test.sock --workers 2 > serve.log 2>&1 &
+server=$!
+tries=0
+while [ ! -S test.sock ]; do
+    tries=$((tries + 1))
+    if [ $tries -gt 100 ] || ! kill -0 $server 2> /dev/null; then
+        echo "server did not start:"
+        cat serve.log
+        exit 1
+    fi
+    sleep 0.1
+done
+
+{
+    "$cdb" client --socket test.sock table_banao users id:int:pk name:string
+    "$cdb" client --socket test.sock insert_karo users 1 Alice 2 Bob 3 Carol
+    "$cdb" client --socket test.sock dikhao users cols name where id = 2
+    "$cdb" client --socket test.sock dikhao nosuch
+    "$cdb" client --socket test.sock serve
+    printf '%s\n' 'insert_karo users 4 "Dan Lee"' '# skipped' 'dikhao users agg count' \
+        'dikhao users order by id:desc limit 2 format csv' | "$cdb" client --socket test.sock
+    printf '%s\n' 'update_karo users change name=Al where id = 1' 'dikhao users format csv' |
+        "$cdb" client --socket test.sock --batch
+} > actual.out 2>&1
+
+kill -TERM $server
+wait $server
+if [ -e test.sock ]; then
+    echo "server left its socket behind"
+    exit 1
+fi
+if ! diff -u "$expected" actual.out; then
+    echo "output differs from $expected"
+    exit 1
+fi